@@ -0,0 +1,237 @@
+#include <CLI/CLI.hpp>
+
+#include "bench.h"
+#include "huge_pages.h"
+#include "json_writer.h"
+#include "system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr const std::array<double, 4> BENCH_LATENCY_PERCENTILES = {50, 99, 99.9, 99.99};
+
+u64 read_counter(int fd) {
+  u64 value = 0;
+  if (fd >= 0 && read(fd, &value, sizeof(value)) != sizeof(value)) {
+    value = 0;
+  }
+  return value;
+}
+
+void dump_results_to_json_file(const std::vector<bench_result_t> &results, const std::filesystem::path &file) {
+  FILE *out = fopen(file.c_str(), "w");
+  if (!out) {
+    perror("fopen");
+    panic("Failed to open %s for writing", file.c_str());
+  }
+
+  JsonWriter j(out);
+  j.begin_object();
+  j.key("benchmarks");
+  j.begin_array();
+  for (const bench_result_t &result : results) {
+    j.begin_object();
+    j.field("best_ns_per_op", result.best_ns_per_op);
+    if (result.has_dtlb_misses) {
+      j.field("dtlb_misses_per_op", result.dtlb_misses_per_op);
+    }
+    j.field("max_cycles", result.max_cycles);
+    j.field("name", result.name);
+    j.field("ns_per_op", result.ns_per_op);
+    j.field("ops", result.ops);
+    j.key("percentiles_cycles");
+    j.begin_object();
+    for (const auto &[percentile, cycles] : result.percentiles) {
+      char name[16];
+      snprintf(name, sizeof(name), "p%g", percentile);
+      j.field(name, cycles);
+    }
+    j.end_object();
+    j.field("repetitions", result.repetitions);
+    j.end_object();
+  }
+  j.end_array();
+  j.end_object();
+  j.finish();
+
+  fclose(out);
+}
+
+} // namespace
+
+std::vector<std::pair<std::string_view, benchmark_fn_t>> &get_benchmarks() {
+  static std::vector<std::pair<std::string_view, benchmark_fn_t>> benchmarks;
+  return benchmarks;
+}
+
+std::vector<flow_t> random_flows(u64 count, u64 seed) {
+  std::vector<flow_t> flows(count);
+  std::mt19937_64 rng(seed);
+  for (flow_t &flow : flows) {
+    const u64 r              = rng();
+    flow.type                = FlowType::FiveTuple;
+    flow.five_tuple.src_ip   = r;
+    flow.five_tuple.dst_ip   = r >> 32;
+    flow.five_tuple.src_port = rng();
+    flow.five_tuple.dst_port = rng();
+  }
+  return flows;
+}
+
+bench_t::~bench_t() {
+  if (dtlb_fd >= 0) {
+    close(dtlb_fd);
+  }
+}
+
+bool bench_t::enable_dtlb_counter() {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size           = sizeof(attr);
+  attr.type           = PERF_TYPE_HW_CACHE;
+  attr.config         = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+
+  dtlb_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if (dtlb_fd < 0) {
+    fprintf(stderr, "dTLB load miss counter unavailable: %s\n", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+void bench_t::run(const std::string &name, u64 ops, const std::function<void()> &setup, const std::function<void()> &body) {
+  if (!is_selected(name)) {
+    return;
+  }
+
+  // Time and dTLB misses of each repetition, per operation.
+  std::vector<std::pair<double, double>> per_op;
+  double total_s = 0;
+
+  while (per_op.size() < BENCH_MAX_REPETITIONS && (total_s < BENCH_MIN_TIME_S || per_op.size() < BENCH_MIN_REPETITIONS)) {
+    setup();
+
+    const u64 dtlb_start = read_counter(dtlb_fd);
+    const auto start     = std::chrono::steady_clock::now();
+    body();
+    const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const u64 dtlb_misses  = read_counter(dtlb_fd) - dtlb_start;
+
+    total_s += elapsed_s;
+    per_op.emplace_back(elapsed_s * BILLION / ops, dtlb_misses / static_cast<double>(ops));
+  }
+
+  std::sort(per_op.begin(), per_op.end());
+
+  const bench_result_t result = {
+      .name               = name,
+      .ops                = ops,
+      .repetitions        = per_op.size(),
+      .ns_per_op          = per_op[per_op.size() / 2].first,
+      .best_ns_per_op     = per_op.front().first,
+      .has_dtlb_misses    = dtlb_fd >= 0,
+      .dtlb_misses_per_op = per_op[per_op.size() / 2].second,
+      .percentiles        = {},
+      .max_cycles         = 0,
+  };
+
+  printf("%-56s %12.2f ns/op %10.2f Mops/s %6lu reps", name.c_str(), result.ns_per_op, THOUSAND / result.ns_per_op, result.repetitions);
+  if (result.has_dtlb_misses) {
+    printf(" %10.4f dTLB misses/op", result.dtlb_misses_per_op);
+  }
+  printf("\n");
+  fflush(stdout);
+
+  results.push_back(result);
+}
+
+void bench_t::latency(const std::string &name, const CyclesHistogram &cycles) {
+  if (!is_selected(name)) {
+    return;
+  }
+
+  bench_result_t result = {
+      .name           = name,
+      .ops            = cycles.get_total(),
+      .repetitions    = 1,
+      .ns_per_op          = 0,
+      .best_ns_per_op     = 0,
+      .has_dtlb_misses    = false,
+      .dtlb_misses_per_op = 0,
+      .percentiles        = {},
+      .max_cycles         = cycles.get_max(),
+  };
+
+  printf("%-56s", name.c_str());
+  for (const double percentile : BENCH_LATENCY_PERCENTILES) {
+    result.percentiles.emplace_back(percentile, cycles.get_percentile(percentile));
+    printf(" p%g=%lu", percentile, result.percentiles.back().second);
+  }
+  printf(" max=%lu cycles\n", result.max_cycles);
+  fflush(stdout);
+
+  results.push_back(result);
+}
+
+int main(int argc, char **argv) {
+  std::string filter;
+  std::filesystem::path output_json;
+  std::string huge_page_mode = "off";
+  bool dtlb                  = false;
+  bool list                  = false;
+
+  CLI::App app{"Pcap stats microbenchmarks"};
+  app.add_option("--filter", filter, "Only run measurements whose name contains this string.");
+  app.add_option("--json", output_json, "Also dump the results to this JSON file.");
+  app.add_option("--huge-pages", huge_page_mode, "Back the big tables with huge pages: off, thp, 2m or 1g (default: off).");
+  app.add_flag("--dtlb", dtlb, "Also count dTLB load misses per operation.");
+  app.add_flag("--list", list, "List the benchmark groups and exit.");
+
+  CLI11_PARSE(app, argc, argv);
+
+  if (list) {
+    for (const auto &[name, fn] : get_benchmarks()) {
+      printf("%s\n", name.data());
+    }
+    return 0;
+  }
+
+  const std::optional<HugePageMode> mode = parse_huge_page_mode(huge_page_mode);
+  if (!mode.has_value()) {
+    fprintf(stderr, "Invalid --huge-pages %s, expected off, thp, 2m or 1g\n", huge_page_mode.c_str());
+    return 1;
+  }
+  huge_pages.set_mode(mode.value());
+
+  bench_t bench(filter);
+  if (dtlb) {
+    bench.enable_dtlb_counter();
+  }
+
+  for (const auto &[name, fn] : get_benchmarks()) {
+    fn(bench);
+  }
+
+  if (mode.value() != HugePageMode::Off) {
+    huge_pages.dump_to_stderr();
+  }
+
+  if (!output_json.empty()) {
+    dump_results_to_json_file(bench.get_results(), output_json);
+  }
+
+  return 0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "profiler.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal benchmark harness behind pcap-stats-bench.
+//
+// Benchmarks register themselves with BENCHMARK(fn) and report measurements through the bench_t they are handed. A throughput
+// measurement runs body() (which must perform `ops` operations) repeatedly, calling setup() untimed before each repetition, until
+// BENCH_MIN_TIME_S has been spent in body() and at least BENCH_MIN_REPETITIONS were done. The median repetition is reported.
+//
+// With --dtlb, dTLB load misses (perf_event_open, userspace only) are also counted over body() and reported per operation, for the
+// median repetition as well. Together with --huge-pages this shows what huge page backing saves on the big tables.
+
+constexpr const double BENCH_MIN_TIME_S   = 0.5;
+constexpr const u64 BENCH_MIN_REPETITIONS = 3;
+constexpr const u64 BENCH_MAX_REPETITIONS = 1000;
+
+struct bench_result_t {
+  std::string name;
+  u64 ops;
+  u64 repetitions;
+  double ns_per_op;
+  double best_ns_per_op;
+
+  // Only with the dTLB counter enabled.
+  bool has_dtlb_misses;
+  double dtlb_misses_per_op;
+
+  // Only for latency measurements, in cycles.
+  std::vector<std::pair<double, u64>> percentiles;
+  u64 max_cycles;
+};
+
+class bench_t {
+private:
+  const std::string_view filter;
+  std::vector<bench_result_t> results;
+
+  // dTLB load miss counter, -1 if disabled.
+  int dtlb_fd;
+
+public:
+  bench_t(std::string_view _filter) : filter(_filter), dtlb_fd(-1) {}
+  ~bench_t();
+
+  bench_t(const bench_t &)            = delete;
+  bench_t &operator=(const bench_t &) = delete;
+
+  // Returns false (after explaining why) if the counter is not available.
+  bool enable_dtlb_counter();
+
+  bool is_selected(std::string_view name) const { return filter.empty() || name.find(filter) != std::string_view::npos; }
+
+  void run(const std::string &name, u64 ops, const std::function<void()> &setup, const std::function<void()> &body);
+  void run(const std::string &name, u64 ops, const std::function<void()> &body) { run(name, ops, [] {}, body); }
+
+  // Per operation latencies, collected by the benchmark itself.
+  void latency(const std::string &name, const CyclesHistogram &cycles);
+
+  const std::vector<bench_result_t> &get_results() const { return results; }
+};
+
+using benchmark_fn_t = void (*)(bench_t &);
+
+std::vector<std::pair<std::string_view, benchmark_fn_t>> &get_benchmarks();
+
+struct benchmark_registrar_t {
+  benchmark_registrar_t(std::string_view name, benchmark_fn_t fn) { get_benchmarks().emplace_back(name, fn); }
+};
+
+#define BENCHMARK(fn) static const benchmark_registrar_t PROFILE_CONCAT(benchmark_registrar_, fn)(#fn, fn)
+
+// Distinct (with overwhelming probability) random five-tuple flows, the same for the same seed.
+std::vector<flow_t> random_flows(u64 count, u64 seed);
+
+// Keeps the compiler from optimizing away computations whose result is otherwise unused.
+template <typename T> inline void do_not_optimize(const T &value) { asm volatile("" : : "r,m"(value) : "memory"); }
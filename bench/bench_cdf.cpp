@@ -0,0 +1,40 @@
+#include "bench.h"
+#include "cdf.h"
+
+#include <random>
+
+namespace {
+
+constexpr const u64 CDF_OPS = 1 << 20;
+
+void cdf(bench_t &bench) {
+  std::mt19937_64 rng(0);
+
+  // Packet sizes take a handful of distinct values, flow durations are all over the place.
+  std::vector<u64> pkt_sizes(CDF_OPS);
+  std::vector<u64> durations(CDF_OPS);
+  std::discrete_distribution<int> size_mix({50, 10, 40});
+  const std::array<u64, 3> sizes = {64, 576, 1500};
+  for (u64 i = 0; i < CDF_OPS; i++) {
+    pkt_sizes[i] = sizes[size_mix(rng)];
+    durations[i] = rng() % 10'000'000;
+  }
+
+  for (const auto &[name, values] : {std::make_pair("pkt_sizes", &pkt_sizes), std::make_pair("durations", &durations)}) {
+    CDF cdf;
+
+    bench.run(
+        std::string("cdf/add/") + name, CDF_OPS, [&] { cdf = CDF(); },
+        [&] {
+          for (const u64 value : *values) {
+            cdf.add(value);
+          }
+        });
+
+    bench.run(std::string("cdf/get_cdf/") + name, 1, [&] { do_not_optimize(cdf.get_cdf()); });
+  }
+}
+
+} // namespace
+
+BENCHMARK(cdf);
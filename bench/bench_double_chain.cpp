@@ -0,0 +1,70 @@
+#include "bench.h"
+#include "double_chain.h"
+
+#include <memory>
+#include <random>
+
+namespace {
+
+constexpr const std::array<u64, 4> DOUBLE_CHAIN_CAPACITIES = {1 << 10, 1 << 16, 1 << 20, 1 << 24};
+
+void double_chain(bench_t &bench) {
+  for (const u64 capacity : DOUBLE_CHAIN_CAPACITIES) {
+    const std::string suffix = "/" + std::to_string(capacity);
+    std::unique_ptr<DoubleChain> chain;
+
+    bench.run(
+        "double_chain/allocate" + suffix, capacity, [&] { chain = std::make_unique<DoubleChain>(capacity); },
+        [&] {
+          u64 index;
+          for (u64 i = 0; i < capacity; i++) {
+            chain->allocate_new_index(i, index);
+          }
+          do_not_optimize(index);
+        });
+
+    // Rejuvenating random indexes moves them to the tail of the allocated list, from wherever they were.
+    std::vector<u64> indexes(capacity);
+    std::mt19937_64 rng(capacity);
+    for (u64 &index : indexes) {
+      index = rng() % capacity;
+    }
+
+    time_ns_t now = 0;
+    bench.run(
+        "double_chain/rejuvenate" + suffix, capacity,
+        [&] {
+          chain = std::make_unique<DoubleChain>(capacity);
+          u64 index;
+          for (now = 0; now < static_cast<time_ns_t>(capacity); now++) {
+            chain->allocate_new_index(now, index);
+          }
+        },
+        [&] {
+          for (const u64 index : indexes) {
+            chain->rejuvenate_index(index, now++);
+          }
+        });
+
+    bench.run(
+        "double_chain/expire" + suffix, capacity,
+        [&] {
+          chain = std::make_unique<DoubleChain>(capacity);
+          u64 index;
+          for (u64 i = 0; i < capacity; i++) {
+            chain->allocate_new_index(i, index);
+          }
+        },
+        [&] {
+          // Everything was allocated during the first nanoseconds, so it is all long expired.
+          u64 index;
+          while (chain->expire_one_index(BILLION * 10, index)) {
+            do_not_optimize(index);
+          }
+        });
+  }
+}
+
+} // namespace
+
+BENCHMARK(double_chain);
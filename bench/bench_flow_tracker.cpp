@@ -0,0 +1,40 @@
+#include "bench.h"
+#include "flow_tracker.h"
+
+#include <memory>
+
+namespace {
+
+constexpr const u64 FLOW_TRACKER_CAPACITY = 1 << 22;
+constexpr const u64 FLOW_TRACKER_OPS      = 1 << 22;
+
+// New flows arrive at a constant rate, each living the FlowTracker's fixed 1s, so the tracker settles at `concurrent_flows` live flows
+// with every add matched by an expiration.
+void flow_tracker(bench_t &bench) {
+  const std::vector<flow_t> flows = random_flows(FLOW_TRACKER_OPS, 0);
+
+  for (const u64 concurrent_flows : {1'000, 100'000, 1'000'000}) {
+    const time_ns_t interarrival_ns = BILLION / concurrent_flows;
+    std::unique_ptr<FlowTracker> tracker;
+
+    bench.run(
+        "flow_tracker/churn/" + std::to_string(concurrent_flows), FLOW_TRACKER_OPS,
+        [&] { tracker = std::make_unique<FlowTracker>(FLOW_TRACKER_CAPACITY); },
+        [&] {
+          time_ns_t now = 0;
+          u64 expired   = 0;
+          for (const flow_t &flow : flows) {
+            now += interarrival_ns;
+            expired += tracker->expire_flows(now);
+            if (!tracker->has_flow(flow)) {
+              tracker->add_flow(flow, now);
+            }
+          }
+          do_not_optimize(expired);
+        });
+  }
+}
+
+} // namespace
+
+BENCHMARK(flow_tracker);
@@ -0,0 +1,75 @@
+#include "bench.h"
+#include "incremental_hash_table.h"
+#include "net.h"
+
+#include <unordered_map>
+
+namespace {
+
+constexpr const u64 HASH_OPS             = 1 << 20;
+constexpr const u64 HASH_TABLE_LATENCY_N = 1 << 24;
+
+template <typename Hash, typename Key> void hash_throughput(bench_t &bench, const std::string &name, const std::vector<flow_t> &flows) {
+  const Hash hasher;
+  bench.run(name, flows.size(), [&] {
+    size_t acc = 0;
+    for (const flow_t &flow : flows) {
+      acc += hasher(Key(flow));
+    }
+    do_not_optimize(acc);
+  });
+}
+
+template <typename Table> void lookup(bench_t &bench, const std::string &name, const std::vector<flow_t> &flows) {
+  if (!bench.is_selected(name)) {
+    return;
+  }
+
+  Table table;
+  for (u64 i = 0; i < flows.size(); i++) {
+    table[flows[i]] = i;
+  }
+
+  bench.run(name, flows.size(), [&] {
+    u64 acc = 0;
+    for (const flow_t &flow : flows) {
+      acc += table.contains(flow);
+    }
+    do_not_optimize(acc);
+  });
+}
+
+// Per insert cost of growing a table from empty, rehashes included.
+template <typename Table> void insert_latency(bench_t &bench, const std::string &name, const std::vector<flow_t> &flows) {
+  if (!bench.is_selected(name)) {
+    return;
+  }
+
+  Table table;
+  CyclesHistogram cycles;
+  for (u64 i = 0; i < flows.size(); i++) {
+    const u64 start = read_cycles();
+    table[flows[i]] = i;
+    cycles.add(read_cycles() - start);
+  }
+
+  bench.latency(name, cycles);
+}
+
+void hash(bench_t &bench) {
+  const std::vector<flow_t> flows = random_flows(HASH_OPS, 0);
+
+  hash_throughput<flow_t::flow_hash_t, flow_t>(bench, "hash/flow_t::flow_hash_t", flows);
+  hash_throughput<sflow_t::flow_hash_t, sflow_t>(bench, "hash/sflow_t::flow_hash_t", flows);
+
+  lookup<std::unordered_map<flow_t, u64, flow_t::flow_hash_t>>(bench, "hash/lookup/std::unordered_map", flows);
+  lookup<IncrementalHashTable<flow_t, u64, flow_t::flow_hash_t>>(bench, "hash/lookup/IncrementalHashTable", flows);
+
+  const std::vector<flow_t> many_flows = random_flows(HASH_TABLE_LATENCY_N, 1);
+  insert_latency<std::unordered_map<flow_t, u64, flow_t::flow_hash_t>>(bench, "hash/insert_latency/std::unordered_map", many_flows);
+  insert_latency<IncrementalHashTable<flow_t, u64, flow_t::flow_hash_t>>(bench, "hash/insert_latency/IncrementalHashTable", many_flows);
+}
+
+} // namespace
+
+BENCHMARK(hash);
@@ -0,0 +1,118 @@
+#include "bench.h"
+#include "pcap_reader.h"
+#include "pcap_writer.h"
+#include "system.h"
+
+#include <cstring>
+#include <random>
+
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zstd.h>
+
+namespace {
+
+constexpr const u64 READER_PKTS         = 1 << 20;
+constexpr const bytes_t READER_CAPLEN   = sizeof(ether_hdr_t) + sizeof(ipv4_hdr_t) + sizeof(udp_hdr_t);
+constexpr const bytes_t READER_WIRE_LEN = 64;
+constexpr const int READER_ZSTD_LEVEL   = 3;
+
+// Ethernet/IPv4/UDP headers only (truncated capture), as tracing tools usually capture them.
+std::vector<u8> build_pcap(u64 pkts) {
+  std::vector<u8> pcap(sizeof(pcap_global_header_t) + pkts * (sizeof(pcap_record_header_t) + READER_CAPLEN));
+  u8 *cursor = pcap.data();
+
+  const pcap_global_header_t global_header = {
+      .magic         = PCAP_MAGIC,
+      .version_major = PCAP_VERSION_MAJOR,
+      .version_minor = PCAP_VERSION_MINOR,
+      .thiszone      = 0,
+      .sigfigs       = 0,
+      .snaplen       = 65535,
+      .linktype      = PCAP_LINKTYPE_EN10MB,
+  };
+  memcpy(cursor, &global_header, sizeof(global_header));
+  cursor += sizeof(global_header);
+
+  std::mt19937_64 rng(0);
+  for (u64 i = 0; i < pkts; i++) {
+    const pcap_record_header_t record_header = {
+        .ts_sec  = static_cast<u32>(i / MILLION),
+        .ts_usec = static_cast<u32>(i % MILLION),
+        .caplen  = READER_CAPLEN,
+        .len     = READER_WIRE_LEN,
+    };
+    memcpy(cursor, &record_header, sizeof(record_header));
+    cursor += sizeof(record_header);
+
+    ether_hdr_t ether_hdr = {};
+    ether_hdr.ether_type  = htons(ETHERTYPE_IP);
+    memcpy(cursor, &ether_hdr, sizeof(ether_hdr));
+    cursor += sizeof(ether_hdr);
+
+    ipv4_hdr_t ip_hdr    = {};
+    ip_hdr.version       = 4;
+    ip_hdr.ihl           = 5;
+    ip_hdr.total_length  = htons(READER_WIRE_LEN - sizeof(ether_hdr_t) - CRC_SIZE_BYTES);
+    ip_hdr.next_proto_id = IPPROTO_UDP;
+    ip_hdr.src_addr      = rng();
+    ip_hdr.dst_addr      = rng();
+    memcpy(cursor, &ip_hdr, sizeof(ip_hdr));
+    cursor += sizeof(ip_hdr);
+
+    udp_hdr_t udp_hdr = {};
+    udp_hdr.src_port  = rng();
+    udp_hdr.dst_port  = rng();
+    memcpy(cursor, &udp_hdr, sizeof(udp_hdr));
+    cursor += sizeof(udp_hdr);
+  }
+
+  return pcap;
+}
+
+std::vector<u8> compress(const std::vector<u8> &data) {
+  std::vector<u8> compressed(ZSTD_compressBound(data.size()));
+  const size_t size = ZSTD_compress(compressed.data(), compressed.size(), data.data(), data.size(), READER_ZSTD_LEVEL);
+  assert_or_panic(!ZSTD_isError(size), "Compression failed: %s", ZSTD_getErrorName(size));
+  compressed.resize(size);
+  return compressed;
+}
+
+// An in-memory file, reachable through /proc so that the reader can open it by path.
+class MemoryFile {
+private:
+  int fd;
+
+public:
+  MemoryFile(const std::vector<u8> &data) : fd(memfd_create("pcap-stats-bench", 0)) {
+    assert_or_panic(fd >= 0, "memfd_create failed: %s", strerror(errno));
+    assert_or_panic(write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()), "Failed to fill in-memory file");
+  }
+
+  ~MemoryFile() { close(fd); }
+
+  std::filesystem::path get_path() const { return "/proc/self/fd/" + std::to_string(fd); }
+};
+
+void reader(bench_t &bench) {
+  const std::vector<u8> pcap = build_pcap(READER_PKTS);
+  const MemoryFile plain(pcap);
+  const MemoryFile zstd(compress(pcap));
+
+  for (const auto &[name, file] : {std::make_pair("plain", &plain), std::make_pair("zstd", &zstd)}) {
+    bench.run(std::string("reader/read_next_packet/") + name, READER_PKTS, [&] {
+      pcap_reader_t reader(file->get_path());
+      packet_t packet;
+      u64 pkts = 0;
+      while (reader.read_next_packet(packet)) {
+        pkts++;
+      }
+      assert_or_panic(pkts == READER_PKTS, "Read %lu packets out of %lu", pkts, READER_PKTS);
+    });
+  }
+}
+
+} // namespace
+
+BENCHMARK(reader);
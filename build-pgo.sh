@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# Release build with LTO and profile guided optimization: builds instrumented binaries, trains them on a synthetic trace (the pgo-train
+# target) and rebuilds with the profile. Extra arguments go to cmake, e.g. -DENABLE_MULTIVERSIONING=ON.
+
+set -euo pipefail
+
+PROJECT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="$PROJECT_DIR/build"
+
+if [ -d "$BUILD_DIR" ]; then
+    rm -rf $BUILD_DIR/CMakeCache.txt $BUILD_DIR/CMakeFiles $BUILD_DIR/compile_commands.json || true
+fi
+
+cmake \
+    -G Ninja \
+    -B "$BUILD_DIR" \
+    -S "$PROJECT_DIR" \
+    -DENABLE_ADDRESS_SANITIZER=0 \
+    -DCMAKE_BUILD_TYPE=Release \
+    -DENABLE_LTO=ON \
+    -DPGO=GENERATE \
+    "$@"
+
+ninja -C "$BUILD_DIR" pgo-train
+
+cmake -B "$BUILD_DIR" -DPGO=USE
+
+ninja -C "$BUILD_DIR"
@@ -0,0 +1,72 @@
+#include "alloc_tracker.h"
+
+#include <cstdlib>
+#include <new>
+
+thread_local u32 alloc_tracking_depth = 0;
+thread_local u64 tracked_allocations  = 0;
+
+#ifdef ALLOC_TRACKING_ENABLED
+
+// glibc's own entry points, so that the replacements below do not recurse into themselves.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+namespace {
+
+inline void count_allocation() {
+  if (alloc_tracking_depth > 0) {
+    tracked_allocations++;
+  }
+}
+
+void *allocate_or_throw(size_t size) {
+  count_allocation();
+  void *ptr = __libc_malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+} // namespace
+
+extern "C" {
+
+void *malloc(size_t size) noexcept {
+  count_allocation();
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept {
+  count_allocation();
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) noexcept {
+  count_allocation();
+  return __libc_realloc(ptr, size);
+}
+
+} // extern "C"
+
+void *operator new(size_t size) { return allocate_or_throw(size); }
+void *operator new[](size_t size) { return allocate_or_throw(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  count_allocation();
+  return __libc_malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  count_allocation();
+  return __libc_malloc(size ? size : 1);
+}
+
+// Memory from all of the above goes back through the regular free(), so operator delete is left alone. Aligned news are not replaced:
+// nothing on the ingest path over-aligns.
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "types.h"
+#include "profiler.h"
+
+// Counts the heap allocations made from the ingest path, to check that it stays off the allocator once warmed up (see
+// traffic_stats_tracker_t::reserve_flows).
+//
+// Built with -DENABLE_ALLOC_TRACKING=ON, which replaces the global operator new, as well as malloc, calloc and realloc (the hash table
+// buckets and the C libraries go through those), with versions that count the calls made inside an ALLOC_TRACKING_SCOPE. Counters are per
+// thread, so the background jobs and the report generation do not show up. Otherwise the scope compiles away and nothing is counted.
+
+extern thread_local u32 alloc_tracking_depth;
+extern thread_local u64 tracked_allocations;
+
+// Allocations counted on this thread so far.
+inline u64 get_tracked_allocations() { return tracked_allocations; }
+
+class AllocTrackingScope {
+public:
+  AllocTrackingScope() { alloc_tracking_depth++; }
+  ~AllocTrackingScope() { alloc_tracking_depth--; }
+};
+
+#ifdef ALLOC_TRACKING_ENABLED
+constexpr const bool ALLOC_TRACKING = true;
+#define ALLOC_TRACKING_SCOPE() AllocTrackingScope PROFILE_CONCAT(alloc_tracking_scope_, __LINE__)
+#else
+constexpr const bool ALLOC_TRACKING = false;
+#define ALLOC_TRACKING_SCOPE()                                                                                                                       \
+  do {                                                                                                                                               \
+  } while (0)
+#endif
@@ -0,0 +1,75 @@
+#include "background_job.h"
+#include "system.h"
+
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
+bool BackgroundJob::start(const std::function<bool()> &job) {
+  if (is_running()) {
+    return false;
+  }
+
+  // Don't let the child inherit half filled stdio buffers, or they would get written twice.
+  fflush(stdout);
+  fflush(stderr);
+
+  pid = fork();
+
+  if (pid < 0) {
+    fprintf(stderr, "Failed to fork %s job: %s\n", name.c_str(), strerror(errno));
+    pid = -1;
+    return false;
+  }
+
+  if (pid == 0) {
+    const bool success = job();
+    fflush(stderr);
+    _exit(success ? 0 : 1);
+  }
+
+  return true;
+}
+
+bool BackgroundJob::is_running() {
+  if (pid < 0) {
+    return false;
+  }
+
+  int status;
+  const pid_t result = waitpid(pid, &status, WNOHANG);
+
+  if (result == 0) {
+    return true;
+  }
+
+  if (result < 0) {
+    status = 0;
+  }
+
+  reap(status);
+  return false;
+}
+
+void BackgroundJob::wait() {
+  if (pid < 0) {
+    return;
+  }
+
+  int status;
+  if (waitpid(pid, &status, 0) < 0) {
+    status = 0;
+  }
+
+  reap(status);
+}
+
+void BackgroundJob::reap(int status) {
+  if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "Background %s job failed (exit code %d)\n", name.c_str(), WEXITSTATUS(status));
+  } else if (WIFSIGNALED(status)) {
+    fprintf(stderr, "Background %s job killed by signal %d\n", name.c_str(), WTERMSIG(status));
+  }
+
+  pid = -1;
+}
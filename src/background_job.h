@@ -0,0 +1,31 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include <sys/types.h>
+
+// Runs a job in a forked child process, which works on a copy-on-write image of the whole process as it was at fork time. The parent only
+// pays for the fork itself and keeps going, making this a cheap way of getting a consistent view of large in-memory state.
+//
+// The child only runs the job and exits through _exit(), so it never touches the other threads' state nor runs destructors.
+class BackgroundJob {
+private:
+  const std::string name;
+  pid_t pid;
+
+public:
+  BackgroundJob(const std::string &_name) : name(_name), pid(-1) {}
+  ~BackgroundJob() { wait(); }
+
+  // Returns false (without starting anything) if the previous job is still running.
+  bool start(const std::function<bool()> &job);
+
+  // Reaps the child if it finished, reporting failures.
+  bool is_running();
+
+  void wait();
+
+private:
+  void reap(int status);
+};
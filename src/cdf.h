@@ -1,6 +1,7 @@
 #pragma once
 
 #include "types.h"
+#include "snapshot.h"
 
 #include <map>
 #include <cmath>
@@ -61,6 +62,16 @@ public:
     return avg / total;
   }
 
+  void save(SnapshotWriter &out) const {
+    ::save(out, values);
+    ::save(out, total);
+  }
+
+  void load(SnapshotReader &in) {
+    ::load(in, values);
+    ::load(in, total);
+  }
+
   double get_stdev() const {
     double avg   = get_avg();
     double stdev = 0;
@@ -0,0 +1,105 @@
+#include "checkpoint.h"
+#include "snapshot.h"
+#include "system.h"
+
+#include <cstring>
+
+constexpr const char CHECKPOINT_MAGIC[8] = {'P', 'S', 'T', 'A', 'T', 'C', 'K', 'P'};
+constexpr const u32 CHECKPOINT_VERSION   = 12;
+
+namespace {
+
+void save(SnapshotWriter &out, const checkpoint_params_t &params) {
+  ::save(out, params.pcap_file);
+  ::save(out, params.epoch_duration);
+  ::save(out, params.rate.has_value());
+  ::save(out, params.rate.value_or(0));
+  ::save(out, params.metrics);
+  ::save(out, params.filter);
+  ::save(out, params.flow_tables);
+  ::save(out, params.rss);
+  ::save(out, params.hhh_threshold);
+}
+
+bool matches(SnapshotReader &in, const checkpoint_params_t &params) {
+  checkpoint_params_t saved;
+  bool has_rate;
+  Mbps_t rate;
+
+  ::load(in, saved.pcap_file);
+  ::load(in, saved.epoch_duration);
+  ::load(in, has_rate);
+  ::load(in, rate);
+  ::load(in, saved.metrics);
+  ::load(in, saved.filter);
+  ::load(in, saved.flow_tables);
+  ::load(in, saved.rss);
+  ::load(in, saved.hhh_threshold);
+
+  if (has_rate) {
+    saved.rate = rate;
+  }
+
+  return saved.pcap_file == params.pcap_file && saved.epoch_duration == params.epoch_duration && saved.rate == params.rate &&
+         saved.metrics == params.metrics && saved.filter == params.filter && saved.flow_tables == params.flow_tables &&
+         saved.rss == params.rss && saved.hhh_threshold == params.hhh_threshold;
+}
+
+} // namespace
+
+Checkpointer::Checkpointer(const std::filesystem::path &_file, const checkpoint_params_t &_params, std::chrono::seconds _interval)
+    : file(_file), params(_params), interval(_interval), last_checkpoint(std::chrono::steady_clock::now()), job("checkpoint") {}
+
+void Checkpointer::write_checkpoint(const replay_state_t &state, u64 total_pkts, const std::function<void(SnapshotWriter &)> &save_tracker) {
+  last_checkpoint = std::chrono::steady_clock::now();
+
+  const bool started = job.start([&]() {
+    const std::filesystem::path tmp_file = file.string() + ".tmp";
+
+    SnapshotWriter out(tmp_file);
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    ::save(out, CHECKPOINT_VERSION);
+    save(out, params);
+    ::save(out, state);
+    save_tracker(out);
+
+    if (!out.close()) {
+      fprintf(stderr, "Failed to write checkpoint %s: %s\n", tmp_file.c_str(), strerror(errno));
+      return false;
+    }
+
+    if (rename(tmp_file.c_str(), file.c_str()) != 0) {
+      fprintf(stderr, "Failed to rename checkpoint %s: %s\n", tmp_file.c_str(), strerror(errno));
+      return false;
+    }
+
+    fprintf(stderr, "Checkpoint written to %s (%lu packets)\n", file.c_str(), total_pkts);
+    return true;
+  });
+
+  if (!started) {
+    fprintf(stderr, "Previous checkpoint still being written, skipping\n");
+  }
+}
+
+replay_state_t load_checkpoint(const std::filesystem::path &file, const checkpoint_params_t &params,
+                               const std::function<void(SnapshotReader &)> &load_tracker) {
+  SnapshotReader in(file);
+
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  u32 version;
+  in.read(magic, sizeof(magic));
+  ::load(in, version);
+
+  assert_or_panic(memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) == 0, "%s is not a checkpoint", file.c_str());
+  assert_or_panic(version == CHECKPOINT_VERSION, "Unsupported checkpoint version %u", version);
+  assert_or_panic(matches(in, params),
+                  "Checkpoint %s was taken with a different pcap, epoch, rate, metrics, filter, flow tables, RSS or HHH threshold",
+                  file.c_str());
+
+  replay_state_t state;
+  ::load(in, state);
+  load_tracker(in);
+
+  return state;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "types.h"
+#include "pcap_reader.h"
+#include "traffic_stats_tracker.h"
+#include "background_job.h"
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// State of the replay loop driving the tracker.
+struct replay_state_t {
+  time_ns_t base_time;
+  time_ns_t current_time;
+  pcap_reader_position_t position;
+};
+
+// Run parameters a checkpoint is only valid for.
+struct checkpoint_params_t {
+  std::string pcap_file;
+  time_ns_t epoch_duration;
+  std::optional<Mbps_t> rate;
+  metrics_t metrics;
+  std::string filter;
+  std::vector<flow_table_geometry_t> flow_tables;
+  rss_config_t rss;
+  double hhh_threshold;
+};
+
+// Periodically snapshots the tracker and replay state to a file, to be picked up by --resume.
+//
+// Snapshots are written by a forked child on a copy-on-write image of the process (see BackgroundJob), so ingest only stalls for the fork.
+// The child writes to a temporary file and atomically renames it over the previous checkpoint, so a crash at any point leaves the last
+// complete checkpoint in place.
+class Checkpointer {
+private:
+  const std::filesystem::path file;
+  const checkpoint_params_t params;
+  const std::chrono::seconds interval;
+
+  std::chrono::steady_clock::time_point last_checkpoint;
+  BackgroundJob job;
+
+public:
+  Checkpointer(const std::filesystem::path &_file, const checkpoint_params_t &_params, std::chrono::seconds _interval);
+
+  // Cheap unless the interval elapsed, meant to be called regularly from the ingest loop.
+  template <typename Tracker> void tick(const Tracker &tracker, const replay_state_t &state) {
+    if (std::chrono::steady_clock::now() - last_checkpoint >= interval) {
+      checkpoint(tracker, state);
+    }
+  }
+
+  template <typename Tracker> void checkpoint(const Tracker &tracker, const replay_state_t &state) {
+    write_checkpoint(state, tracker.report.total_pkts, [&](SnapshotWriter &out) { tracker.save(out); });
+  }
+
+private:
+  void write_checkpoint(const replay_state_t &state, u64 total_pkts, const std::function<void(SnapshotWriter &)> &save_tracker);
+};
+
+replay_state_t load_checkpoint(const std::filesystem::path &file, const checkpoint_params_t &params,
+                               const std::function<void(SnapshotReader &)> &load_tracker);
+
+// Restores the tracker from a checkpoint, returning the replay state to resume from.
+template <typename Tracker>
+replay_state_t load_checkpoint(const std::filesystem::path &file, const checkpoint_params_t &params, Tracker &tracker) {
+  const replay_state_t state = load_checkpoint(file, params, [&](SnapshotReader &in) { tracker.load(in); });
+  fprintf(stderr, "Resuming from %s (%lu packets)\n", file.c_str(), tracker.report.total_pkts);
+  return state;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "types.h"
+#include "snapshot.h"
 
 struct simulator_clock_t {
   const time_ns_t epoch_duration;
@@ -23,4 +24,18 @@ struct simulator_clock_t {
 
     return sound_alarm;
   }
+
+  void save(SnapshotWriter &out) const {
+    ::save(out, epoch_duration);
+    ::save(out, on);
+    ::save(out, alarm);
+  }
+
+  void load(SnapshotReader &in) {
+    time_ns_t saved_epoch_duration;
+    ::load(in, saved_epoch_duration);
+    assert(saved_epoch_duration == epoch_duration);
+    ::load(in, on);
+    ::load(in, alarm);
+  }
 };
@@ -0,0 +1,106 @@
+#include "columnar_writer.h"
+#include "system.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr const size_t COLUMNAR_ALIGNMENT = 8;
+
+} // namespace
+
+ColumnarWriter::ColumnarWriter(const std::filesystem::path &file) : out(nullptr), cctx(nullptr), written(0) {
+  out = fopen(file.c_str(), "wb");
+  if (!out) {
+    perror("fopen");
+    panic("Failed to open %s for writing", file.c_str());
+  }
+
+  if (file.extension() == ".zst") {
+    cctx = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+    zstd_out_buff.resize(ZSTD_CStreamOutSize());
+  }
+
+  const u32 version  = COLUMNAR_VERSION;
+  const u32 reserved = 0;
+  write(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+  write(&version, sizeof(version));
+  write(&reserved, sizeof(reserved));
+}
+
+ColumnarWriter::~ColumnarWriter() { close(); }
+
+void ColumnarWriter::close() {
+  if (!out) {
+    return;
+  }
+
+  if (cctx) {
+    compress(nullptr, 0, ZSTD_e_end);
+    ZSTD_freeCCtx(cctx);
+    cctx = nullptr;
+  }
+
+  fclose(out);
+  out = nullptr;
+}
+
+void ColumnarWriter::write_column(std::string_view name, ColumnType type, const void *data, u64 bytes, u64 count) {
+  assert(out && "Writing to a closed columnar file");
+
+  const u32 name_len   = name.size();
+  const u8 type_byte   = static_cast<u8>(type);
+  const u8 reserved[3] = {0, 0, 0};
+
+  write(&count, sizeof(count));
+  write(&name_len, sizeof(name_len));
+  write(&type_byte, sizeof(type_byte));
+  write(reserved, sizeof(reserved));
+  write(name.data(), name.size());
+  write_padding();
+  write(data, bytes);
+  write_padding();
+}
+
+void ColumnarWriter::write_padding() {
+  static const u8 zeros[COLUMNAR_ALIGNMENT] = {0};
+  const size_t misalignment                 = written % COLUMNAR_ALIGNMENT;
+  if (misalignment != 0) {
+    write(zeros, COLUMNAR_ALIGNMENT - misalignment);
+  }
+}
+
+void ColumnarWriter::write(const void *data, size_t size) {
+  written += size;
+
+  if (cctx) {
+    compress(data, size, ZSTD_e_continue);
+    return;
+  }
+
+  if (fwrite(data, 1, size, out) != size) {
+    panic("Failed to write columnar file: %s", strerror(errno));
+  }
+}
+
+void ColumnarWriter::compress(const void *data, size_t size, ZSTD_EndDirective mode) {
+  ZSTD_inBuffer input = {data, size, 0};
+
+  bool finished = false;
+  while (!finished) {
+    ZSTD_outBuffer output = {zstd_out_buff.data(), zstd_out_buff.size(), 0};
+
+    const size_t remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+    if (ZSTD_isError(remaining)) {
+      panic("Compression failed: %s", ZSTD_getErrorName(remaining));
+    }
+
+    if (fwrite(zstd_out_buff.data(), 1, output.pos, out) != output.pos) {
+      panic("Failed to write columnar file: %s", strerror(errno));
+    }
+
+    // When ending the frame we must wait for zstd to fully flush, otherwise it is enough to consume all the input.
+    finished = (mode == ZSTD_e_end) ? (remaining == 0) : (input.pos == input.size);
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include <zstd.h>
+
+// Binary columnar container.
+//
+// All integers are little endian and every section starts 8 byte aligned, so an uncompressed file can be mmapped and each column used
+// in place (e.g. numpy.frombuffer(mm, dtype, count, offset)).
+//
+//   file header (16 bytes):
+//     char magic[8]     "PSTATCOL"
+//     u32  version      COLUMNAR_VERSION
+//     u32  reserved
+//
+//   followed by columns until EOF, each one being:
+//     u64  count        number of elements
+//     u32  name_len     length of the name in bytes (not NUL terminated)
+//     u8   type         ColumnType
+//     u8   reserved[3]
+//     char name[name_len], zero padded to a multiple of 8 bytes
+//     data[count * sizeof(type)], zero padded to a multiple of 8 bytes
+//
+// Scalars are stored as single element columns. If the output file name ends in ".zst", the whole byte stream is wrapped in a zstd frame.
+
+constexpr const char COLUMNAR_MAGIC[8] = {'P', 'S', 'T', 'A', 'T', 'C', 'O', 'L'};
+constexpr const u32 COLUMNAR_VERSION   = 1;
+
+enum class ColumnType : u8 {
+  U64 = 0,
+  I64 = 1,
+  F64 = 2,
+  U32 = 3,
+  U16 = 4,
+};
+
+template <typename T> constexpr ColumnType column_type_of();
+template <> constexpr ColumnType column_type_of<u64>() { return ColumnType::U64; }
+template <> constexpr ColumnType column_type_of<i64>() { return ColumnType::I64; }
+template <> constexpr ColumnType column_type_of<double>() { return ColumnType::F64; }
+template <> constexpr ColumnType column_type_of<u32>() { return ColumnType::U32; }
+template <> constexpr ColumnType column_type_of<u16>() { return ColumnType::U16; }
+
+class ColumnarWriter {
+private:
+  FILE *out;
+  ZSTD_CCtx *cctx;
+  std::vector<u8> zstd_out_buff;
+  u64 written;
+
+public:
+  ColumnarWriter(const std::filesystem::path &file);
+  ~ColumnarWriter();
+
+  ColumnarWriter(const ColumnarWriter &)            = delete;
+  ColumnarWriter &operator=(const ColumnarWriter &) = delete;
+
+  template <typename T> void column(std::string_view name, const T *data, u64 count) {
+    write_column(name, column_type_of<T>(), data, count * sizeof(T), count);
+  }
+
+  template <typename T> void column(std::string_view name, const std::vector<T> &data) { column(name, data.data(), data.size()); }
+
+  template <typename T> void scalar(std::string_view name, T value) { column(name, &value, 1); }
+
+  // Flushes everything and closes the zstd frame. Called by the destructor if not done explicitly.
+  void close();
+
+private:
+  void write_column(std::string_view name, ColumnType type, const void *data, u64 bytes, u64 count);
+  void write_padding();
+  void write(const void *data, size_t size);
+  void compress(const void *data, size_t size, ZSTD_EndDirective mode);
+};
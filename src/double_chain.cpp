@@ -1,4 +1,7 @@
 #include "double_chain.h"
+#include "system.h"
+
+#include <algorithm>
 
 // Requires the array dchain_cell, large enough to fit all the range of
 // possible 'index' values + 2 special values.
@@ -45,7 +48,7 @@ enum DCHAIN_ENUM {
   INDEX_SHIFT     = DCHAIN_RESERVED,
 };
 
-DoubleChain::DoubleChain(u64 index_range) : cells(index_range + DCHAIN_RESERVED), timestamps(index_range) {
+DoubleChain::DoubleChain(u64 index_range) : cells(index_range + DCHAIN_RESERVED), timestamps(index_range), high_watermark(0) {
   dchain_cell_t &al_head = cells[ALLOC_LIST_HEAD];
   al_head.prev           = 0;
   al_head.next           = 0;
@@ -90,6 +93,7 @@ bool DoubleChain::allocate_new_index(time_ns_t time, u64 &index_out) {
 
   index_out             = allocated - INDEX_SHIFT;
   timestamps[index_out] = time;
+  high_watermark        = std::max(high_watermark, index_out + 1);
   return true;
 }
 
@@ -205,4 +209,23 @@ bool DoubleChain::get_oldest_index(u64 &index_out) const {
 
   index_out = al_head.next - INDEX_SHIFT;
   return true;
-}
\ No newline at end of file
+}
+
+void DoubleChain::save(SnapshotWriter &out) const {
+  ::save(out, static_cast<u64>(timestamps.size()));
+  ::save(out, high_watermark);
+  save_array(out, cells.data(), high_watermark + DCHAIN_RESERVED);
+  save_array(out, timestamps.data(), high_watermark);
+}
+
+void DoubleChain::load(SnapshotReader &in) {
+  u64 index_range;
+  ::load(in, index_range);
+  assert_or_panic(index_range == timestamps.size(), "Snapshot DoubleChain capacity mismatch (%lu vs %lu)", index_range, timestamps.size());
+
+  ::load(in, high_watermark);
+  assert_or_panic(high_watermark <= index_range, "Corrupted DoubleChain snapshot");
+
+  load_array(in, cells.data(), high_watermark + DCHAIN_RESERVED);
+  load_array(in, timestamps.data(), high_watermark);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "types.h"
+#include "snapshot.h"
+#include "huge_pages.h"
 
 #include <vector>
 
@@ -10,8 +12,11 @@ struct dchain_cell_t {
 };
 
 class DoubleChain {
-  std::vector<dchain_cell_t> cells;
-  std::vector<time_ns_t> timestamps;
+  huge_vector<dchain_cell_t> cells;
+  huge_vector<time_ns_t> timestamps;
+
+  // Indexes at or above the watermark were never allocated, so they still form the untouched sequential tail of the free list.
+  u64 high_watermark;
 
 public:
   DoubleChain(u64 index_range);
@@ -22,6 +27,10 @@ public:
   bool is_index_allocated(u64 index) const;
   bool free_index(u64 index);
 
+  // Only the cells below the high watermark are saved, the rest is rebuilt exactly as the constructor left it.
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+
 private:
   bool get_oldest_index(u64 &index_out) const;
 };
\ No newline at end of file
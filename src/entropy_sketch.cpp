@@ -0,0 +1,231 @@
+#include "entropy_sketch.h"
+#include "multiversion.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+namespace {
+
+// Uniforms are the top 24 bits of hashes, which a float holds exactly, binned by the exponent and the leading mantissa bits of their float
+// conversion.
+constexpr const u64 ENTROPY_UNIFORM_BITS          = 24;
+constexpr const u64 ENTROPY_VARIATE_MANTISSA_BITS = 7;
+constexpr const u64 ENTROPY_VARIATES              = ENTROPY_UNIFORM_BITS << ENTROPY_VARIATE_MANTISSA_BITS;
+
+// A variate is skew[bin(h1(key))] + exponential[bin(h2(key))], every counter of a bucket having its own pair of hashes.
+struct variate_tables_t {
+  // tan(W1) (pi/2 - W1) + ln(cos(W1) / (pi/2 - W1)), with W1 = pi (U - 1/2) uniform in (-pi/2, pi/2).
+  std::array<float, ENTROPY_VARIATES> skew;
+  // ln(W2), with W2 = -ln(1 - U) exponential.
+  std::array<float, ENTROPY_VARIATES> exponential;
+
+  // Multiply-add-shift hashes of the mixed key, a * x + b.
+  std::array<u32, ENTROPY_BUCKET_SKETCHES> skew_a;
+  std::array<u32, ENTROPY_BUCKET_SKETCHES> skew_b;
+  std::array<u32, ENTROPY_BUCKET_SKETCHES> exponential_a;
+  std::array<u32, ENTROPY_BUCKET_SKETCHES> exponential_b;
+};
+
+constexpr u32 variate_bin(u32 hash) {
+  const float uniform = static_cast<float>(static_cast<i32>(hash >> (32 - ENTROPY_UNIFORM_BITS) | 1));
+  return (std::bit_cast<u32>(uniform) >> (23 - ENTROPY_VARIATE_MANTISSA_BITS)) - (127 << ENTROPY_VARIATE_MANTISSA_BITS);
+}
+
+// A wider uniform would round up to the next power of two, past the last bin.
+static_assert(variate_bin(std::numeric_limits<u32>::max()) == ENTROPY_VARIATES - 1);
+static_assert(variate_bin(0) == 0);
+
+variate_tables_t build_variate_tables() {
+  constexpr const double half_pi = std::numbers::pi / 2;
+
+  variate_tables_t tables;
+  for (u64 bin = 0; bin < ENTROPY_VARIATES; bin++) {
+    // The middle of the bin.
+    const i32 exponent = static_cast<i32>(bin >> ENTROPY_VARIATE_MANTISSA_BITS) - static_cast<i32>(ENTROPY_UNIFORM_BITS);
+    const u64 mantissa = bin & ((1 << ENTROPY_VARIATE_MANTISSA_BITS) - 1);
+    const double u     = std::ldexp(1 + (mantissa + 0.5) / (1 << ENTROPY_VARIATE_MANTISSA_BITS), exponent);
+
+    const double w1         = std::numbers::pi * (u - 0.5);
+    tables.skew[bin]        = std::tan(w1) * (half_pi - w1) + std::log(std::cos(w1) / (half_pi - w1));
+    tables.exponential[bin] = std::log(-std::log1p(-u));
+  }
+
+  // splitmix64, the multipliers odd.
+  u64 state   = 0x2545f4914f6cdd1dULL;
+  auto random = [&]() {
+    u64 z = (state += 0x9e3779b97f4a7c15ULL);
+    z     = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z     = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<u32>((z ^ (z >> 31)) >> 32);
+  };
+  for (u64 j = 0; j < ENTROPY_BUCKET_SKETCHES; j++) {
+    tables.skew_a[j]        = random() | 1;
+    tables.skew_b[j]        = random();
+    tables.exponential_a[j] = random() | 1;
+    tables.exponential_b[j] = random();
+  }
+
+  return tables;
+}
+
+const variate_tables_t VARIATE_TABLES = build_variate_tables();
+
+// murmur3's finalizer, so that keys differing in a few bits (e.g. neighbouring addresses) hash far apart.
+u32 mix_key(u32 key) {
+  key ^= key >> 16;
+  key *= 0x85ebca6bu;
+  key ^= key >> 13;
+  key *= 0xc2b2ae35u;
+  key ^= key >> 16;
+  return key;
+}
+
+} // namespace
+
+EntropySketch::EntropySketch() : sketches{}, cache(ENTROPY_CACHE_SLOTS, slot_t{.key = 0, .count = 0}), items(0) {}
+
+HOT_KERNEL void EntropySketch::update(sketches_t &sketches, u32 key, u64 count) {
+  const variate_tables_t &tables = VARIATE_TABLES;
+  const u64 bucket_index         = mix_key(key) >> (32 - ENTROPY_BUCKET_BITS);
+
+  bucket_t &bucket = sketches.buckets[bucket_index];
+  bucket.items += count;
+  if (bucket.heavy_items > 0 && bucket.heavy_key == key) {
+    bucket.heavy_items += count;
+    return;
+  }
+  // A key updated with more items than the heavy key has in all takes its place, the heavy key going to the counters instead.
+  if (count > bucket.heavy_items) {
+    std::swap(key, bucket.heavy_key);
+    std::swap(count, bucket.heavy_items);
+    if (count == 0) {
+      return;
+    }
+  }
+
+  if (bucket.items == bucket.heavy_items + count) {
+    bucket.first_key = key;
+  } else if (bucket.first_key != key) {
+    bucket.several_keys = true;
+  }
+
+  const u32 x         = mix_key(key);
+  double *counters    = sketches.counters.data() + bucket_index * ENTROPY_BUCKET_SKETCHES;
+  const double weight = static_cast<double>(count);
+  for (u64 j = 0; j < ENTROPY_BUCKET_SKETCHES; j++) {
+    const float skew        = tables.skew[variate_bin(tables.skew_a[j] * x + tables.skew_b[j])];
+    const float exponential = tables.exponential[variate_bin(tables.exponential_a[j] * x + tables.exponential_b[j])];
+    counters[j] += weight * static_cast<double>(skew + exponential);
+  }
+}
+
+double EntropySketch::estimate() const {
+  if (items == 0) {
+    return 0;
+  }
+
+  sketches_t flushed = sketches;
+  for (const slot_t &slot : cache) {
+    if (slot.count > 0) {
+      update(flushed, slot.key, slot.count);
+    }
+  }
+
+  // In nats.
+  double entropy = 0;
+  for (u64 b = 0; b < ENTROPY_BUCKETS; b++) {
+    const bucket_t &bucket = flushed.buckets[b];
+    if (bucket.items == 0) {
+      continue;
+    }
+
+    // Of the keys in the counters.
+    const u64 other_items = bucket.items - bucket.heavy_items;
+    double other_entropy  = 0;
+    if (bucket.several_keys) {
+      double sum         = 0;
+      double sum_squares = 0;
+      for (u64 j = 0; j < ENTROPY_BUCKET_SKETCHES; j++) {
+        const double sample = std::exp(flushed.counters[b * ENTROPY_BUCKET_SKETCHES + j] / static_cast<double>(other_items));
+        sum += sample;
+        sum_squares += sample * sample;
+      }
+      const double mean     = sum / ENTROPY_BUCKET_SKETCHES;
+      const double variance = (sum_squares - sum * mean) / (ENTROPY_BUCKET_SKETCHES - 1);
+      other_entropy         = std::max(-std::log(mean) - variance / (2 * ENTROPY_BUCKET_SKETCHES * mean * mean), 0.0);
+    }
+
+    // The heavy key against the others, then the others among themselves.
+    const double heavy_share = static_cast<double>(bucket.heavy_items) / static_cast<double>(bucket.items);
+    const double other_share = 1 - heavy_share;
+    double bucket_entropy    = 0;
+    if (other_items > 0) {
+      bucket_entropy = -heavy_share * std::log(heavy_share) + other_share * (other_entropy - std::log(other_share));
+    }
+
+    const double share = static_cast<double>(bucket.items) / static_cast<double>(items);
+    entropy += share * (bucket_entropy - std::log(share));
+  }
+
+  return entropy / std::numbers::ln2;
+}
+
+void EntropySketch::reset() {
+  sketches = {};
+  cache.assign(ENTROPY_CACHE_SLOTS, slot_t{.key = 0, .count = 0});
+  items = 0;
+}
+
+void EntropySketch::save(SnapshotWriter &out) const {
+  ::save(out, sketches);
+  ::save(out, cache);
+  ::save(out, items);
+}
+
+void EntropySketch::load(SnapshotReader &in) {
+  ::load(in, sketches);
+  ::load(in, cache);
+  ::load(in, items);
+}
+
+void FlowEntropyEstimator::on_epoch_rollover() {
+  epochs.push_back(estimate());
+
+  src_ip.reset();
+  dst_ip.reset();
+  src_port.reset();
+  dst_port.reset();
+}
+
+std::vector<flow_entropy_t> FlowEntropyEstimator::get_epoch_reports() const {
+  std::vector<flow_entropy_t> reports = epochs;
+  reports.push_back(estimate());
+  return reports;
+}
+
+flow_entropy_t FlowEntropyEstimator::estimate() const {
+  return {
+      .src_ip   = src_ip.estimate(),
+      .dst_ip   = dst_ip.estimate(),
+      .src_port = src_port.estimate(),
+      .dst_port = dst_port.estimate(),
+  };
+}
+
+void FlowEntropyEstimator::save(SnapshotWriter &out) const {
+  src_ip.save(out);
+  dst_ip.save(out);
+  src_port.save(out);
+  dst_port.save(out);
+  ::save(out, epochs);
+}
+
+void FlowEntropyEstimator::load(SnapshotReader &in) {
+  src_ip.load(in);
+  dst_ip.load(in);
+  src_port.load(in);
+  dst_port.load(in);
+  ::load(in, epochs);
+}
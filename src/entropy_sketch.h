@@ -0,0 +1,130 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "snapshot.h"
+
+#include <array>
+#include <limits>
+#include <vector>
+
+// Streaming (Shannon) entropy of the source and destination addresses and ports of the flow stream (every TCP/UDP packet), per epoch,
+// in constant memory however many distinct values an epoch holds. A flat distribution of the destination ports or addresses is the
+// mark of a scan, a collapsing one (or a flat one of the sources) that of a DDoS.
+//
+// Estimation is the stable distribution sketch of Clifford and Cosma ("A simple sketching algorithm for entropy estimation over
+// streaming data", AISTATS 2013): every key gets a maximally skewed 1-stable variate per counter, drawn from hashes of the key, and a
+// counter sums the variates of the stream weighted by their counts. With N keys, E[exp(counter / N)] = exp(-H), so averaging over the
+// counters gives the entropy. Variates come from two tables, of the two halves of the Chambers-Mallows-Stuck formula over a uniform,
+// binned on a log scale so that the heavy tail the estimate of high entropies hinges on is kept down to 2^-24.
+//
+// Keys are spread over ENTROPY_BUCKETS buckets of ENTROPY_BUCKET_SKETCHES counters each (stochastic averaging), and H is the exact
+// entropy of the buckets plus the weighted entropies of the keys within them, so that a key only updates the counters of its bucket
+// for the accuracy of all of them. The largest key of each bucket is counted exactly, outside of the counters, and the entropy of the
+// bucket split between it and the others: on skewed streams a bucket is mostly its largest key, whose weight in the counters would
+// drown the estimate of the others in noise. Estimates of the others are corrected for the bias -ln of a mean of few samples has, and
+// are exact (0) for a single key. Over uniform, Zipf (skews 0.8 to 3) and mixed streams of up to a million distinct keys, as well as
+// the epochs of the pcap-stats-verify traces, errors stay within 0.3 bits.
+//
+// Updating counters on every packet would still be too slow, so packets go through a direct-mapped cache of (key, count) slots first,
+// and a key only reaches its counters, weighted by its count, when another one takes its slot, or when the epoch ends. The counters
+// are a linear function of the counts, so this gives the same result (up to rounding) as updating them one packet at a time, and a
+// cache hit costs an increment. The update of the counters of a bucket is a loop over them that the compiler vectorizes.
+
+constexpr const u64 ENTROPY_BUCKET_BITS     = 7;
+constexpr const u64 ENTROPY_BUCKETS         = 1 << ENTROPY_BUCKET_BITS;
+constexpr const u64 ENTROPY_BUCKET_SKETCHES = 8;
+constexpr const u64 ENTROPY_CACHE_BITS      = 12;
+constexpr const u64 ENTROPY_CACHE_SLOTS     = 1 << ENTROPY_CACHE_BITS;
+
+// In bits, 0 for an epoch without packets.
+struct flow_entropy_t {
+  double src_ip;
+  double dst_ip;
+  double src_port;
+  double dst_port;
+};
+
+// Entropy of a stream of u32 keys.
+class EntropySketch {
+private:
+  struct bucket_t {
+    u64 items;
+    // The largest key of the bucket, as far as the updates tell, is counted exactly instead of going through the counters.
+    u32 heavy_key;
+    u64 heavy_items;
+    // Of the other keys, those in the counters.
+    u32 first_key;
+    bool several_keys;
+  };
+
+  struct sketches_t {
+    std::array<double, ENTROPY_BUCKETS * ENTROPY_BUCKET_SKETCHES> counters;
+    std::array<bucket_t, ENTROPY_BUCKETS> buckets;
+  };
+
+  struct slot_t {
+    u32 key;
+    // 0 for an empty slot.
+    u32 count;
+  };
+
+  sketches_t sketches;
+  std::vector<slot_t> cache;
+  u64 items;
+
+public:
+  EntropySketch();
+
+  void add(u32 key) {
+    slot_t &slot = cache[static_cast<u32>(key * 0x9e3779b1u) >> (32 - ENTROPY_CACHE_BITS)];
+    if (slot.key != key || slot.count == std::numeric_limits<u32>::max()) {
+      if (slot.count > 0) {
+        update(sketches, slot.key, slot.count);
+      }
+      slot = {.key = key, .count = 0};
+    }
+    slot.count++;
+    items++;
+  }
+
+  // Of the keys added since the last reset, in bits.
+  double estimate() const;
+  void reset();
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+
+private:
+  static void update(sketches_t &sketches, u32 key, u64 count);
+};
+
+class FlowEntropyEstimator {
+private:
+  // Of the current epoch.
+  EntropySketch src_ip;
+  EntropySketch dst_ip;
+  EntropySketch src_port;
+  EntropySketch dst_port;
+  // Of the epochs already over.
+  std::vector<flow_entropy_t> epochs;
+
+public:
+  void access(const flow_t &flow) {
+    src_ip.add(flow.five_tuple.src_ip);
+    dst_ip.add(flow.five_tuple.dst_ip);
+    src_port.add(flow.five_tuple.src_port);
+    dst_port.add(flow.five_tuple.dst_port);
+  }
+
+  void on_epoch_rollover();
+
+  // Including the current one.
+  std::vector<flow_entropy_t> get_epoch_reports() const;
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+
+private:
+  flow_entropy_t estimate() const;
+};
@@ -0,0 +1,147 @@
+#include "flow_record_writer.h"
+#include "columnar_writer.h"
+#include "system.h"
+
+#include <cmath>
+
+constexpr const size_t FLOW_RECORD_BATCH_SIZE = 64 * 1024;
+
+flow_record_batch_t::flow_record_batch_t(size_t capacity) {
+  src_ip.reserve(capacity);
+  dst_ip.reserve(capacity);
+  src_port.reserve(capacity);
+  dst_port.reserve(capacity);
+  first_ts_ns.reserve(capacity);
+  last_ts_ns.reserve(capacity);
+  pkts.reserve(capacity);
+  bytes.reserve(capacity);
+  ipt_min_ns.reserve(capacity);
+  ipt_max_ns.reserve(capacity);
+  ipt_avg_ns.reserve(capacity);
+  ipt_stdev_ns.reserve(capacity);
+}
+
+void flow_record_batch_t::push(const flow_t &flow, const flow_record_t &record) {
+  assert(flow.type == FlowType::FiveTuple);
+
+  const u64 ipts        = record.pkts - 1;
+  const double ipt_avg  = ipts > 0 ? record.ipt_sum / ipts : 0;
+  const double ipt_var  = ipts > 0 ? record.ipt_sum_sq / ipts - ipt_avg * ipt_avg : 0;
+  const double ipt_stdv = ipt_var > 0 ? std::sqrt(ipt_var) : 0;
+
+  src_ip.push_back(bswap32(flow.five_tuple.src_ip));
+  dst_ip.push_back(bswap32(flow.five_tuple.dst_ip));
+  src_port.push_back(bswap16(flow.five_tuple.src_port));
+  dst_port.push_back(bswap16(flow.five_tuple.dst_port));
+  first_ts_ns.push_back(record.first);
+  last_ts_ns.push_back(record.last);
+  pkts.push_back(record.pkts);
+  bytes.push_back(record.bytes);
+  ipt_min_ns.push_back(record.ipt_min);
+  ipt_max_ns.push_back(record.ipt_max);
+  ipt_avg_ns.push_back(ipt_avg);
+  ipt_stdev_ns.push_back(ipt_stdv);
+}
+
+void flow_record_batch_t::clear() {
+  src_ip.clear();
+  dst_ip.clear();
+  src_port.clear();
+  dst_port.clear();
+  first_ts_ns.clear();
+  last_ts_ns.clear();
+  pkts.clear();
+  bytes.clear();
+  ipt_min_ns.clear();
+  ipt_max_ns.clear();
+  ipt_avg_ns.clear();
+  ipt_stdev_ns.clear();
+}
+
+FlowRecordWriter::FlowRecordWriter(const std::filesystem::path &file)
+    : current(std::make_unique<flow_record_batch_t>(FLOW_RECORD_BATCH_SIZE)), stop(false), total_records(0),
+      writer(&FlowRecordWriter::writer_loop, this, file) {}
+
+FlowRecordWriter::~FlowRecordWriter() { close(); }
+
+void FlowRecordWriter::hand_over() {
+  std::unique_ptr<flow_record_batch_t> next;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_back(std::move(current));
+    if (!free_batches.empty()) {
+      next = std::move(free_batches.back());
+      free_batches.pop_back();
+    }
+  }
+
+  cv.notify_one();
+
+  if (!next) {
+    next = std::make_unique<flow_record_batch_t>(FLOW_RECORD_BATCH_SIZE);
+  }
+
+  current = std::move(next);
+}
+
+void FlowRecordWriter::close() {
+  if (!writer.joinable()) {
+    return;
+  }
+
+  if (current->size() > 0) {
+    hand_over();
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stop = true;
+  }
+
+  cv.notify_one();
+  writer.join();
+
+  fprintf(stderr, "Exported %lu flow records\n", total_records);
+}
+
+void FlowRecordWriter::writer_loop(const std::filesystem::path &file) {
+  ColumnarWriter out(file);
+
+  while (true) {
+    std::unique_ptr<flow_record_batch_t> batch;
+
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      cv.wait(guard, [this]() { return stop || !pending.empty(); });
+
+      if (pending.empty()) {
+        // Only reachable when stopping, and with nothing left to write.
+        break;
+      }
+
+      batch = std::move(pending.front());
+      pending.pop_front();
+    }
+
+    out.column("src_ip", batch->src_ip);
+    out.column("dst_ip", batch->dst_ip);
+    out.column("src_port", batch->src_port);
+    out.column("dst_port", batch->dst_port);
+    out.column("first_ts_ns", batch->first_ts_ns);
+    out.column("last_ts_ns", batch->last_ts_ns);
+    out.column("pkts", batch->pkts);
+    out.column("bytes", batch->bytes);
+    out.column("ipt_min_ns", batch->ipt_min_ns);
+    out.column("ipt_max_ns", batch->ipt_max_ns);
+    out.column("ipt_avg_ns", batch->ipt_avg_ns);
+    out.column("ipt_stdev_ns", batch->ipt_stdev_ns);
+
+    batch->clear();
+
+    std::lock_guard<std::mutex> guard(lock);
+    free_batches.push_back(std::move(batch));
+  }
+
+  out.close();
+}
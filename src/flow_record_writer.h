@@ -0,0 +1,108 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Everything we know about a single flow, from its creation in the FlowTracker until it expires.
+struct flow_record_t {
+  time_ns_t first;
+  time_ns_t last;
+  u64 pkts;
+  u64 bytes;
+  time_ns_t ipt_min;
+  time_ns_t ipt_max;
+  double ipt_sum;
+  double ipt_sum_sq;
+
+  flow_record_t() : first(0), last(0), pkts(0), bytes(0), ipt_min(0), ipt_max(0), ipt_sum(0), ipt_sum_sq(0) {}
+
+  void start(time_ns_t now, bytes_t pkt_bytes) {
+    *this = flow_record_t();
+    first = now;
+    last  = now;
+    pkts  = 1;
+    bytes = pkt_bytes;
+  }
+
+  void update(time_ns_t now, bytes_t pkt_bytes) {
+    const time_ns_t ipt = now - last;
+    ipt_min             = (pkts == 1) ? ipt : std::min(ipt_min, ipt);
+    ipt_max             = std::max(ipt_max, ipt);
+    ipt_sum += ipt;
+    ipt_sum_sq += static_cast<double>(ipt) * ipt;
+    last = now;
+    pkts++;
+    bytes += pkt_bytes;
+  }
+};
+
+// Column buffers for a block of flow records.
+struct flow_record_batch_t {
+  std::vector<u32> src_ip;
+  std::vector<u32> dst_ip;
+  std::vector<u16> src_port;
+  std::vector<u16> dst_port;
+  std::vector<time_ns_t> first_ts_ns;
+  std::vector<time_ns_t> last_ts_ns;
+  std::vector<u64> pkts;
+  std::vector<u64> bytes;
+  std::vector<time_ns_t> ipt_min_ns;
+  std::vector<time_ns_t> ipt_max_ns;
+  std::vector<double> ipt_avg_ns;
+  std::vector<double> ipt_stdev_ns;
+
+  flow_record_batch_t(size_t capacity);
+
+  size_t size() const { return pkts.size(); }
+  void push(const flow_t &flow, const flow_record_t &record);
+  void clear();
+};
+
+// Exports flow records to a columnar file (see columnar_writer.h), one block of columns per batch. Addresses and ports are stored in host
+// byte order, IPT statistics are computed over the gaps between consecutive packets of the flow (0 for single packet flows).
+//
+// Records are accumulated in memory and handed over to a background thread whenever a batch fills up, so the packet processing path never
+// waits on disk. Batches are recycled, and if the writer falls behind new ones are allocated instead of blocking the caller.
+class FlowRecordWriter {
+private:
+  std::unique_ptr<flow_record_batch_t> current;
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<std::unique_ptr<flow_record_batch_t>> pending;
+  std::vector<std::unique_ptr<flow_record_batch_t>> free_batches;
+  bool stop;
+
+  u64 total_records;
+  std::thread writer;
+
+public:
+  FlowRecordWriter(const std::filesystem::path &file);
+  ~FlowRecordWriter();
+
+  void push(const flow_t &flow, const flow_record_t &record) {
+    current->push(flow, record);
+    total_records++;
+    if (current->size() == current->pkts.capacity()) {
+      hand_over();
+    }
+  }
+
+  // Writes whatever is still buffered and waits for the background thread to finish.
+  void close();
+
+  u64 get_total_records() const { return total_records; }
+
+private:
+  void hand_over();
+  void writer_loop(const std::filesystem::path &file);
+};
@@ -0,0 +1,417 @@
+#include "flow_table_sim.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+constexpr const u32 CRC32C_POLY = 0x82f63b78;
+
+constexpr std::array<u32, 256> make_crc32c_table() {
+  std::array<u32, 256> table{};
+  for (u32 i = 0; i < 256; i++) {
+    u32 crc = i;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+constexpr const std::array<u32, 256> CRC32C_TABLE = make_crc32c_table();
+
+u32 crc32c(const u8 *data, size_t size, u32 seed) {
+  u32 crc = ~seed;
+  for (size_t i = 0; i < size; i++) {
+    crc = (crc >> 8) ^ CRC32C_TABLE[(crc ^ data[i]) & 0xff];
+  }
+  return ~crc;
+}
+
+// MurmurHash3's fmix64.
+u64 fmix64(u64 h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// Maps a 32 bit hash to [0, n) without a division.
+u64 reduce(u32 hash, u64 n) { return (static_cast<u64>(hash) * n) >> 32; }
+
+std::vector<std::string_view> split(std::string_view str, char separator) {
+  std::vector<std::string_view> parts;
+  while (true) {
+    const size_t pos = str.find(separator);
+    parts.push_back(str.substr(0, pos));
+    if (pos == std::string_view::npos) {
+      return parts;
+    }
+    str = str.substr(pos + 1);
+  }
+}
+
+template <typename E, size_t N>
+std::optional<std::vector<E>> parse_names(std::string_view list, const std::array<std::string_view, N> &names) {
+  std::vector<E> values;
+  for (std::string_view name : split(list, ',')) {
+    bool found = false;
+    for (size_t i = 0; i < N; i++) {
+      if (names[i] == name) {
+        values.push_back(static_cast<E>(i));
+        found = true;
+      }
+    }
+    if (!found) {
+      return std::nullopt;
+    }
+  }
+  return values;
+}
+
+std::optional<std::vector<u64>> parse_numbers(std::string_view list) {
+  std::vector<u64> values;
+  for (std::string_view number : split(list, ',')) {
+    u64 value;
+    const auto [end, error] = std::from_chars(number.data(), number.data() + number.size(), value);
+    if (number.empty() || error != std::errc() || end != number.data() + number.size()) {
+      return std::nullopt;
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+std::optional<std::vector<flow_table_geometry_t>> parse_spec(const std::string &spec) {
+  const std::vector<std::string_view> fields = split(spec, ':');
+  if (fields.size() != 6) {
+    return std::nullopt;
+  }
+
+  const auto kinds        = parse_names<FlowTableKind>(fields[0], FLOW_TABLE_KIND_NAMES);
+  const auto entries      = parse_numbers(fields[1]);
+  const auto ways         = parse_numbers(fields[2]);
+  const auto replacements = parse_names<FlowTableReplacement>(fields[3], FLOW_TABLE_REPLACEMENT_NAMES);
+  const auto hashes       = parse_names<FlowTableHash>(fields[4], FLOW_TABLE_HASH_NAMES);
+  const auto timeouts_ms  = parse_numbers(fields[5]);
+  if (!kinds || !entries || !ways || !replacements || !hashes || !timeouts_ms) {
+    return std::nullopt;
+  }
+
+  std::vector<flow_table_geometry_t> geometries;
+  for (FlowTableKind kind : kinds.value()) {
+    for (u64 table_entries : entries.value()) {
+      for (u64 table_ways : ways.value()) {
+        for (FlowTableReplacement replacement : replacements.value()) {
+          for (FlowTableHash hash : hashes.value()) {
+            for (u64 timeout_ms : timeouts_ms.value()) {
+              geometries.push_back({
+                  .kind        = kind,
+                  .entries     = table_entries,
+                  .ways        = table_ways,
+                  .replacement = replacement,
+                  .hash        = hash,
+                  .timeout     = static_cast<time_ns_t>(timeout_ms * MILLION),
+              });
+            }
+          }
+        }
+      }
+    }
+  }
+  return geometries;
+}
+
+} // namespace
+
+std::string flow_table_geometry_t::get_name() const {
+  return std::string(FLOW_TABLE_KIND_NAMES[static_cast<size_t>(kind)]) + ":" + std::to_string(entries) + ":" + std::to_string(ways) + ":" +
+         std::string(FLOW_TABLE_REPLACEMENT_NAMES[static_cast<size_t>(replacement)]) + ":" +
+         std::string(FLOW_TABLE_HASH_NAMES[static_cast<size_t>(hash)]) + ":" + std::to_string(timeout / MILLION);
+}
+
+std::optional<std::vector<flow_table_geometry_t>> parse_flow_table_geometries(const std::vector<std::string> &specs) {
+  std::vector<flow_table_geometry_t> geometries;
+
+  for (const std::string &spec : specs) {
+    const std::optional<std::vector<flow_table_geometry_t>> parsed = parse_spec(spec);
+    if (!parsed.has_value()) {
+      fprintf(stderr, "Invalid flow table %s, expected kind:entries:ways:replacement:hash:timeout_ms\n", spec.c_str());
+      return std::nullopt;
+    }
+
+    for (const flow_table_geometry_t &geometry : parsed.value()) {
+      const u64 min_ways = geometry.kind == FlowTableKind::Cuckoo ? 2 : 1;
+      if (geometry.ways < min_ways || geometry.ways > FLOW_TABLE_MAX_WAYS || geometry.entries < geometry.ways ||
+          geometry.entries % geometry.ways != 0) {
+        fprintf(stderr, "Invalid flow table %s: entries must be a multiple of the ways, which go from 1 (2 for cuckoo) to %lu\n",
+                geometry.get_name().c_str(), FLOW_TABLE_MAX_WAYS);
+        return std::nullopt;
+      }
+      geometries.push_back(geometry);
+    }
+  }
+
+  return geometries;
+}
+
+u64 flow_table_hash(FlowTableHash hash, const flow_t &flow) {
+  u8 key[12];
+  memcpy(key, &flow.five_tuple.src_ip, sizeof(u32));
+  memcpy(key + 4, &flow.five_tuple.dst_ip, sizeof(u32));
+  memcpy(key + 8, &flow.five_tuple.src_port, sizeof(u16));
+  memcpy(key + 10, &flow.five_tuple.dst_port, sizeof(u16));
+
+  switch (hash) {
+  case FlowTableHash::Crc32:
+    // Two CRCs with different seeds, as hardware tables chain them for more index bits.
+    return crc32c(key, sizeof(key), 0) | static_cast<u64>(crc32c(key, sizeof(key), 0xffffffff)) << 32;
+  case FlowTableHash::Murmur: {
+    const u64 addrs = flow.five_tuple.src_ip | static_cast<u64>(flow.five_tuple.dst_ip) << 32;
+    const u64 ports = flow.five_tuple.src_port | static_cast<u64>(flow.five_tuple.dst_port) << 16;
+    return fmix64(addrs ^ fmix64(ports));
+  }
+  case FlowTableHash::Count:
+    break;
+  }
+  return 0;
+}
+
+FlowTableSim::FlowTableSim(const flow_table_geometry_t &_geometry)
+    : geometry(_geometry), entries(_geometry.entries), rng(0x9e3779b97f4a7c15ULL), lookups(0), misses(0), insert_failures(0),
+      live_evictions(0) {
+  epochs.emplace_back();
+}
+
+u64 FlowTableSim::candidate(u64 hash, u64 way) const {
+  const u64 way_entries = geometry.entries / geometry.ways;
+  if (geometry.kind == FlowTableKind::Set) {
+    return reduce(static_cast<u32>(hash), way_entries) * geometry.ways + way;
+  }
+
+  const u64 way_hash = way == 0 ? hash : way == 1 ? hash >> 32 : fmix64(hash + way);
+  return way * way_entries + reduce(static_cast<u32>(way_hash), way_entries);
+}
+
+u64 FlowTableSim::pick_victim(const u64 *candidates, u64 count) {
+  if (geometry.replacement == FlowTableReplacement::Random) {
+    // xorshift64
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return candidates[rng % count];
+  }
+
+  u64 victim = candidates[0];
+  for (u64 i = 1; i < count; i++) {
+    if (entries[candidates[i]].order < entries[victim].order) {
+      victim = candidates[i];
+    }
+  }
+  return victim;
+}
+
+// Walks a chain of moves from one of the (full) candidates of a new flow, each moving the victim to one of its other candidates, until
+// one of them is free. Returns false, leaving the table as it was, if there is none within FLOW_TABLE_MAX_KICKS moves.
+bool FlowTableSim::relocate(const u64 *candidates, time_ns_t now, u64 &freed) {
+  std::array<u64, FLOW_TABLE_MAX_KICKS + 1> path;
+  path[0] = pick_victim(candidates, geometry.ways);
+
+  std::array<u64, FLOW_TABLE_MAX_WAYS> alternatives;
+  for (u64 kick = 0; kick < FLOW_TABLE_MAX_KICKS; kick++) {
+    const entry_t &moved = entries[path[kick]];
+
+    // Entries already on the chain are left out, so that it never loops.
+    u64 count = 0;
+    for (u64 way = 0; way < geometry.ways; way++) {
+      const u64 alternative = candidate(moved.hash, way);
+      if (std::find(path.begin(), path.begin() + kick + 1, alternative) == path.begin() + kick + 1) {
+        alternatives[count++] = alternative;
+      }
+    }
+
+    for (u64 i = 0; i < count; i++) {
+      if (is_free(entries[alternatives[i]], now)) {
+        // Shift every victim one step down the chain, from the end.
+        entries[alternatives[i]] = entries[path[kick]];
+        for (u64 j = kick; j > 0; j--) {
+          entries[path[j]] = entries[path[j - 1]];
+        }
+        freed = path[0];
+        return true;
+      }
+    }
+
+    if (count == 0) {
+      return false;
+    }
+    path[kick + 1] = pick_victim(alternatives.data(), count);
+  }
+
+  return false;
+}
+
+void FlowTableSim::access(const flow_t &flow, u64 hash, time_ns_t now) {
+  lookups++;
+
+  std::array<u64, FLOW_TABLE_MAX_WAYS> candidates;
+  std::optional<u64> free_entry;
+  for (u64 way = 0; way < geometry.ways; way++) {
+    candidates[way] = candidate(hash, way);
+
+    entry_t &entry = entries[candidates[way]];
+    if (is_free(entry, now)) {
+      if (!free_entry.has_value()) {
+        free_entry = candidates[way];
+      }
+    } else if (entry.hash == hash && entry.flow == flow) {
+      entry.last_seen = now;
+      if (geometry.replacement == FlowTableReplacement::Lru) {
+        entry.order = lookups;
+      }
+      return;
+    }
+  }
+
+  misses++;
+  epochs.back().misses++;
+
+  if (!free_entry.has_value()) {
+    if (geometry.kind == FlowTableKind::Set) {
+      free_entry = pick_victim(candidates.data(), geometry.ways);
+      live_evictions++;
+      epochs.back().live_evictions++;
+    } else {
+      u64 freed;
+      if (!relocate(candidates.data(), now, freed)) {
+        insert_failures++;
+        epochs.back().insert_failures++;
+        return;
+      }
+      free_entry = freed;
+    }
+  }
+
+  entries[free_entry.value()] = {
+      .flow      = flow,
+      .hash      = hash,
+      .last_seen = now,
+      .order     = lookups,
+      .used      = true,
+  };
+}
+
+u64 FlowTableSim::get_occupancy(time_ns_t now) const {
+  u64 occupancy = 0;
+  for (const entry_t &entry : entries) {
+    occupancy += !is_free(entry, now);
+  }
+  return occupancy;
+}
+
+void FlowTableSim::on_epoch_rollover(time_ns_t now) {
+  epochs.back().occupancy = get_occupancy(now);
+  epochs.emplace_back();
+}
+
+flow_table_report_t FlowTableSim::get_report(time_ns_t now) const {
+  flow_table_report_t report = {
+      .geometry        = geometry,
+      .lookups         = lookups,
+      .misses          = misses,
+      .insert_failures = insert_failures,
+      .live_evictions  = live_evictions,
+      .epochs          = epochs,
+  };
+  report.epochs.back().occupancy = get_occupancy(now);
+  return report;
+}
+
+void FlowTableSim::save(SnapshotWriter &out) const {
+  ::save(out, static_cast<u64>(entries.size()));
+  for (const entry_t &entry : entries) {
+    ::save(out, entry.flow);
+    ::save(out, entry.hash);
+    ::save(out, entry.last_seen);
+    ::save(out, entry.order);
+    ::save(out, entry.used);
+  }
+  ::save(out, rng);
+  ::save(out, lookups);
+  ::save(out, misses);
+  ::save(out, insert_failures);
+  ::save(out, live_evictions);
+  ::save(out, epochs);
+}
+
+void FlowTableSim::load(SnapshotReader &in) {
+  u64 size;
+  ::load(in, size);
+  entries.resize(size);
+  for (entry_t &entry : entries) {
+    ::load(in, entry.flow);
+    ::load(in, entry.hash);
+    ::load(in, entry.last_seen);
+    ::load(in, entry.order);
+    ::load(in, entry.used);
+  }
+  ::load(in, rng);
+  ::load(in, lookups);
+  ::load(in, misses);
+  ::load(in, insert_failures);
+  ::load(in, live_evictions);
+  ::load(in, epochs);
+}
+
+void FlowTableSimulator::set_geometries(const std::vector<flow_table_geometry_t> &geometries) {
+  tables.clear();
+  used_hashes = {};
+  for (const flow_table_geometry_t &geometry : geometries) {
+    tables.emplace_back(geometry);
+    used_hashes[static_cast<size_t>(geometry.hash)] = true;
+  }
+}
+
+void FlowTableSimulator::access(const flow_t &flow, time_ns_t now) {
+  std::array<u64, static_cast<size_t>(FlowTableHash::Count)> hashes;
+  for (size_t i = 0; i < hashes.size(); i++) {
+    if (used_hashes[i]) {
+      hashes[i] = flow_table_hash(static_cast<FlowTableHash>(i), flow);
+    }
+  }
+
+  for (FlowTableSim &table : tables) {
+    table.access(flow, hashes[static_cast<size_t>(table.get_geometry().hash)], now);
+  }
+}
+
+void FlowTableSimulator::on_epoch_rollover(time_ns_t now) {
+  for (FlowTableSim &table : tables) {
+    table.on_epoch_rollover(now);
+  }
+}
+
+std::vector<flow_table_report_t> FlowTableSimulator::get_reports(time_ns_t now) const {
+  std::vector<flow_table_report_t> reports;
+  for (const FlowTableSim &table : tables) {
+    reports.push_back(table.get_report(now));
+  }
+  return reports;
+}
+
+void FlowTableSimulator::save(SnapshotWriter &out) const {
+  for (const FlowTableSim &table : tables) {
+    table.save(out);
+  }
+}
+
+void FlowTableSimulator::load(SnapshotReader &in) {
+  for (FlowTableSim &table : tables) {
+    table.load(in);
+  }
+}
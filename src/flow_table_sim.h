@@ -0,0 +1,188 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "huge_pages.h"
+#include "snapshot.h"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Replays the flow stream (every TCP/UDP packet) against fixed-size hardware flow tables of many geometries at once.
+//
+// A table has a number of entries, and every flow a number of candidate entries (its ways) where it may live:
+//
+//   set     set-associative, the ways of the flow's set. A new flow that finds its set full evicts one of them (a live eviction), picked
+//           by the replacement policy, as a flow cache would.
+//   cuckoo  d-ary cuckoo, one entry in each of ways sub-tables. A new flow that finds its candidates full moves one of them (picked by the
+//           replacement policy) to one of its other candidates, and so on for up to FLOW_TABLE_MAX_KICKS moves. If that does not free an
+//           entry the insert fails, leaving the table as it was, as an exact match table would. The flow is then retried on its next
+//           packet.
+//
+// Replacement is lru (least recently seen), fifo (least recently inserted) or random. Entries not seen for the timeout are free again, a
+// timeout of 0 never expires them.
+//
+// Each hash function is computed once per packet and shared by every table using it. Its 64 bits are split into the candidates: the low
+// half indexes the first way, the high half the second, remixed for the others.
+
+constexpr const u64 FLOW_TABLE_MAX_WAYS  = 64;
+constexpr const u64 FLOW_TABLE_MAX_KICKS = 8;
+
+enum class FlowTableKind : u8 {
+  Set,
+  Cuckoo,
+  Count,
+};
+
+enum class FlowTableReplacement : u8 {
+  Lru,
+  Fifo,
+  Random,
+  Count,
+};
+
+enum class FlowTableHash : u8 {
+  Crc32,
+  Murmur,
+  Count,
+};
+
+constexpr const std::array<std::string_view, static_cast<size_t>(FlowTableKind::Count)> FLOW_TABLE_KIND_NAMES = {"set", "cuckoo"};
+constexpr const std::array<std::string_view, static_cast<size_t>(FlowTableReplacement::Count)> FLOW_TABLE_REPLACEMENT_NAMES = {
+    "lru",
+    "fifo",
+    "random",
+};
+constexpr const std::array<std::string_view, static_cast<size_t>(FlowTableHash::Count)> FLOW_TABLE_HASH_NAMES = {"crc32", "murmur"};
+
+struct flow_table_geometry_t {
+  FlowTableKind kind;
+  u64 entries;
+  u64 ways;
+  FlowTableReplacement replacement;
+  FlowTableHash hash;
+  time_ns_t timeout;
+
+  // kind:entries:ways:replacement:hash:timeout_ms, as parsed.
+  std::string get_name() const;
+
+  bool operator==(const flow_table_geometry_t &other) const = default;
+};
+
+// Geometries from "kind:entries:ways:replacement:hash:timeout_ms" specs, where every field may be a comma separated list, standing for
+// every combination (e.g. "set,cuckoo:65536,1048576:4:lru:crc32:1000" is four tables). Returns nothing, and prints why, if one is invalid.
+std::optional<std::vector<flow_table_geometry_t>> parse_flow_table_geometries(const std::vector<std::string> &specs);
+
+// Used when the flow_tables metric is asked for without geometries.
+const std::vector<std::string> DEFAULT_FLOW_TABLE_SPECS = {
+    "set:65536,262144,1048576:1,4,8:lru:crc32:1000",
+    "cuckoo:65536,262144,1048576:2,4:lru:crc32:1000",
+};
+
+struct flow_table_epoch_t {
+  u64 misses;
+  u64 insert_failures;
+  u64 live_evictions;
+  // Live entries when the epoch ended.
+  u64 occupancy;
+};
+
+struct flow_table_report_t {
+  flow_table_geometry_t geometry;
+  u64 lookups;
+  u64 misses;
+  u64 insert_failures;
+  u64 live_evictions;
+  std::vector<flow_table_epoch_t> epochs;
+};
+
+// A single table.
+class FlowTableSim {
+private:
+  struct entry_t {
+    flow_t flow;
+    u64 hash;
+    time_ns_t last_seen;
+    // Replacement order: the lookup number of its last hit with lru, of its insertion otherwise. Unlike times, lookup numbers never tie.
+    u64 order;
+    bool used;
+  };
+
+  flow_table_geometry_t geometry;
+  huge_vector<entry_t> entries;
+  u64 rng;
+
+  u64 lookups;
+  u64 misses;
+  u64 insert_failures;
+  u64 live_evictions;
+  std::vector<flow_table_epoch_t> epochs;
+
+public:
+  FlowTableSim(const flow_table_geometry_t &geometry);
+
+  const flow_table_geometry_t &get_geometry() const { return geometry; }
+
+  // With the hash of the flow, by the table's hash function.
+  void access(const flow_t &flow, u64 hash, time_ns_t now);
+  void on_epoch_rollover(time_ns_t now);
+
+  // The last epoch ends now.
+  flow_table_report_t get_report(time_ns_t now) const;
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+
+private:
+  u64 candidate(u64 hash, u64 way) const;
+  bool is_free(const entry_t &entry, time_ns_t now) const {
+    return !entry.used || (geometry.timeout > 0 && now - entry.last_seen > geometry.timeout);
+  }
+  u64 pick_victim(const u64 *candidates, u64 count);
+  bool relocate(const u64 *candidates, time_ns_t now, u64 &freed);
+  u64 get_occupancy(time_ns_t now) const;
+};
+
+class FlowTableSimulator {
+private:
+  std::vector<FlowTableSim> tables;
+  // Hash functions used by at least one table.
+  std::array<bool, static_cast<size_t>(FlowTableHash::Count)> used_hashes;
+
+public:
+  FlowTableSimulator() : used_hashes{} {}
+
+  void set_geometries(const std::vector<flow_table_geometry_t> &geometries);
+
+  // Times are those of the packets, TCP/UDP or not, so that epochs end at the right time.
+  void access(const flow_t &flow, time_ns_t now);
+  void on_epoch_rollover(time_ns_t now);
+  // The last epoch ends now.
+  std::vector<flow_table_report_t> get_reports(time_ns_t now) const;
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+u64 flow_table_hash(FlowTableHash hash, const flow_t &flow);
+
+inline void save(SnapshotWriter &out, const flow_table_report_t &report) {
+  save(out, report.geometry);
+  save(out, report.lookups);
+  save(out, report.misses);
+  save(out, report.insert_failures);
+  save(out, report.live_evictions);
+  save(out, report.epochs);
+}
+
+inline void load(SnapshotReader &in, flow_table_report_t &report) {
+  load(in, report.geometry);
+  load(in, report.lookups);
+  load(in, report.misses);
+  load(in, report.insert_failures);
+  load(in, report.live_evictions);
+  load(in, report.epochs);
+}
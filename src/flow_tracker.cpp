@@ -1,7 +1,8 @@
 #include "flow_tracker.h"
 #include "system.h"
+#include "probes.h"
 
-FlowTracker::FlowTracker(u64 capacity) : double_chain(capacity), flow_to_index(), index_to_flow(capacity) {}
+FlowTracker::FlowTracker(u64 capacity) : double_chain(capacity), flow_to_index(), index_to_flow(capacity), record_sink(nullptr) {}
 
 u64 FlowTracker::expire_flows(time_ns_t now) {
   u64 expired_count = 0;
@@ -9,6 +10,10 @@ u64 FlowTracker::expire_flows(time_ns_t now) {
   while (double_chain.expire_one_index(now, index_out)) {
     assert(index_out < index_to_flow.size());
     const flow_t &flow = index_to_flow.at(index_out);
+    PROBE_FLOW_EXPIRE(now, flow);
+    if (record_sink) {
+      record_sink->push(flow, index_to_record[index_out]);
+    }
     flow_to_index.erase(flow);
     expired_count++;
   }
@@ -29,5 +34,58 @@ void FlowTracker::add_flow(const flow_t &flow, time_ns_t now) {
 
   assert(index_out < index_to_flow.size());
   index_to_flow.at(index_out) = flow;
-  flow_to_index[flow]         = index_out;
+  flow_to_index_rehashes.track(flow_to_index, [&]() { flow_to_index[flow] = index_out; });
+  PROBE_FLOW_CREATE(now, flow);
+
+  if (record_sink) {
+    // Indexes are handed out lowest first and recycled, so this only grows up to the peak number of concurrent flows.
+    if (index_out >= index_to_record.size()) {
+      index_to_record.resize(index_out + 1);
+    }
+    index_to_record[index_out] = flow_record_t();
+  }
+}
+
+void FlowTracker::set_record_sink(FlowRecordWriter *sink) { record_sink = sink; }
+
+void FlowTracker::record_packet(const flow_t &flow, time_ns_t now, bytes_t bytes) {
+  if (!record_sink) {
+    return;
+  }
+
+  const u64 *index = flow_to_index.find(flow);
+  assert(index && "Recording a packet for an untracked flow");
+
+  flow_record_t &record = index_to_record[*index];
+  if (record.pkts == 0) {
+    record.start(now, bytes);
+  } else {
+    record.update(now, bytes);
+  }
+}
+
+void FlowTracker::flush_records() {
+  if (!record_sink) {
+    return;
+  }
+
+  flow_to_index.for_each([this](const flow_t &flow, u64 index) { record_sink->push(flow, index_to_record[index]); });
+}
+
+void FlowTracker::save(SnapshotWriter &out) const {
+  double_chain.save(out);
+  // The flow of every allocated index is in the map, which is all that is needed to rebuild index_to_flow.
+  ::save(out, flow_to_index);
+  ::save(out, index_to_record);
+}
+
+void FlowTracker::load(SnapshotReader &in) {
+  double_chain.load(in);
+  ::load(in, flow_to_index);
+  ::load(in, index_to_record);
+
+  flow_to_index.for_each([this](const flow_t &flow, u64 index) {
+    assert_or_panic(index < index_to_flow.size(), "Corrupted FlowTracker snapshot");
+    index_to_flow[index] = flow;
+  });
 }
@@ -1,20 +1,45 @@
 #pragma once
 
 #include "double_chain.h"
+#include "flow_record_writer.h"
+#include "hash_table_stats.h"
+#include "huge_pages.h"
+#include "incremental_hash_table.h"
 #include "types.h"
 #include "net.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <vector>
 
 class FlowTracker {
   DoubleChain double_chain;
-  std::unordered_map<flow_t, u64, flow_t::flow_hash_t> flow_to_index;
-  std::vector<flow_t> index_to_flow;
+  IncrementalHashTable<flow_t, u64, flow_t::flow_hash_t> flow_to_index;
+  huge_vector<flow_t> index_to_flow;
+  rehash_tracker_t flow_to_index_rehashes;
+
+  // Only populated when exporting flow records.
+  FlowRecordWriter *record_sink;
+  std::vector<flow_record_t> index_to_record;
 
 public:
   FlowTracker(u64 capacity);
 
+  // Sizes the flow index for that many live flows, the rest is already sized for the capacity.
+  void reserve(u64 flows) { flow_to_index.reserve(std::min(flows, index_to_flow.size())); }
+
   bool has_flow(const flow_t &flow) const;
   void add_flow(const flow_t &flow, time_ns_t now);
   u64 expire_flows(time_ns_t now);
-};
\ No newline at end of file
+
+  u64 get_live_flows() const { return flow_to_index.size(); }
+  double get_load_factor() const { return flow_to_index.load_factor(); }
+  hash_table_stats_t get_table_stats(bool scan_all) const { return get_hash_table_stats(flow_to_index, flow_to_index_rehashes, scan_all); }
+
+  // Every expired flow (and every live one, on flush_records) is pushed to the sink.
+  void set_record_sink(FlowRecordWriter *sink);
+  void record_packet(const flow_t &flow, time_ns_t now, bytes_t bytes);
+  void flush_records();
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Introspection of the IncrementalHashTables backing the tracker (see incremental_hash_table.h). Works for any table with the
+// std::unordered_* bucket interface.
+struct hash_table_stats_t {
+  u64 size;
+  u64 bucket_count;
+  double load_factor;
+
+  // Over non-empty buckets. For big tables only an evenly strided subset of the buckets is scanned, see get_hash_table_stats().
+  double avg_bucket_len;
+  u64 max_bucket_len;
+
+  // Growths of the table, i.e. migrations started, and the time spent in the inserts that started them (allocating the new bucket
+  // array and the first migration step). The rest of a migration is spread over later inserts and not counted.
+  u64 rehashes;
+  time_ns_t rehash_ns;
+
+  // Exact for tables that know their footprint (get_bytes()). Otherwise estimated: bucket array plus one heap node per element (next
+  // pointer, element and cached hash, rounded to malloc's granularity).
+  u64 bytes;
+};
+
+// Counts the inserts that grew the table (for IncrementalHashTable, the ones starting a migration, not stop-the-world rehashes) and how
+// long they took. Inserts that might grow the table are routed through track(), which only times the ones that would cross the max load
+// factor, so the common case costs a comparison.
+struct rehash_tracker_t {
+  u64 rehashes;
+  time_ns_t rehash_ns;
+
+  rehash_tracker_t() : rehashes(0), rehash_ns(0) {}
+
+  template <typename Table, typename Op> void track(const Table &table, Op &&op) {
+    if (table.size() + 1 <= static_cast<double>(table.max_load_factor()) * table.bucket_count()) {
+      op();
+      return;
+    }
+
+    const u64 buckets_before = table.bucket_count();
+    const auto start         = std::chrono::steady_clock::now();
+
+    op();
+
+    if (table.bucket_count() != buckets_before) {
+      rehashes++;
+      rehash_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+  }
+};
+
+constexpr const u64 HASH_TABLE_STATS_MAX_SCANNED_BUCKETS = 1024;
+constexpr const u64 HASH_TABLE_STATS_MALLOC_ALIGNMENT    = 16;
+
+template <typename Table> u64 get_hash_table_bytes(const Table &table, u64 node_bytes) {
+  if constexpr (requires { table.get_bytes(); }) {
+    return table.get_bytes();
+  } else {
+    return table.bucket_count() * sizeof(void *) + table.size() * node_bytes;
+  }
+}
+
+// Walks every bucket if scan_all is set, otherwise at most HASH_TABLE_STATS_MAX_SCANNED_BUCKETS of them.
+template <typename Table> hash_table_stats_t get_hash_table_stats(const Table &table, const rehash_tracker_t &rehash_tracker, bool scan_all) {
+  const u64 bucket_count = table.bucket_count();
+  const u64 stride       = scan_all ? 1 : std::max<u64>(1, bucket_count / HASH_TABLE_STATS_MAX_SCANNED_BUCKETS);
+
+  u64 non_empty_buckets = 0;
+  u64 scanned_elements  = 0;
+  u64 max_bucket_len    = 0;
+
+  for (u64 bucket = 0; bucket < bucket_count; bucket += stride) {
+    const u64 len = table.bucket_size(bucket);
+    if (len > 0) {
+      non_empty_buckets++;
+      scanned_elements += len;
+      max_bucket_len = std::max(max_bucket_len, len);
+    }
+  }
+
+  constexpr const u64 node_raw_bytes = sizeof(void *) + sizeof(typename Table::value_type) + sizeof(size_t);
+  constexpr const u64 node_chunks    = (node_raw_bytes + HASH_TABLE_STATS_MALLOC_ALIGNMENT - 1) / HASH_TABLE_STATS_MALLOC_ALIGNMENT;
+  constexpr const u64 node_bytes     = node_chunks * HASH_TABLE_STATS_MALLOC_ALIGNMENT;
+
+  return {
+      .size           = table.size(),
+      .bucket_count   = bucket_count,
+      .load_factor    = static_cast<double>(table.load_factor()),
+      .avg_bucket_len = non_empty_buckets > 0 ? scanned_elements / static_cast<double>(non_empty_buckets) : 0,
+      .max_bucket_len = max_bucket_len,
+      .rehashes       = rehash_tracker.rehashes,
+      .rehash_ns      = rehash_tracker.rehash_ns,
+      .bytes          = get_hash_table_bytes(table, node_bytes),
+  };
+}
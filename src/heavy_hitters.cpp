@@ -0,0 +1,224 @@
+#include "heavy_hitters.h"
+#include "system.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+void SpaceSaving::set_capacity(u64 _capacity) {
+  capacity = _capacity;
+  clear();
+  heap.reserve(capacity);
+  positions.reserve(capacity);
+}
+
+void SpaceSaving::add(u32 key) {
+  u32 *position = positions.find(key);
+  if (position) {
+    heap[*position].count++;
+    sift_down(*position);
+    return;
+  }
+
+  if (heap.size() < capacity) {
+    heap.push_back({.key = key, .count = 1, .error = 0});
+    positions[key] = heap.size() - 1;
+    sift_up(heap.size() - 1);
+    return;
+  }
+
+  const counter_t smallest = heap[0];
+  positions.erase(smallest.key);
+  place(0, {.key = key, .count = smallest.count + 1, .error = smallest.count});
+  sift_down(0);
+}
+
+void SpaceSaving::clear() {
+  heap.clear();
+  positions.clear();
+}
+
+void SpaceSaving::place(u64 position, const counter_t &counter) {
+  heap[position]         = counter;
+  positions[counter.key] = position;
+}
+
+void SpaceSaving::sift_up(u64 position) {
+  const counter_t counter = heap[position];
+  while (position > 0) {
+    const u64 parent = (position - 1) / 2;
+    if (heap[parent].count <= counter.count) {
+      break;
+    }
+    place(position, heap[parent]);
+    position = parent;
+  }
+  place(position, counter);
+}
+
+void SpaceSaving::sift_down(u64 position) {
+  const counter_t counter = heap[position];
+  while (true) {
+    u64 child = 2 * position + 1;
+    if (child >= heap.size()) {
+      break;
+    }
+    if (child + 1 < heap.size() && heap[child + 1].count < heap[child].count) {
+      child++;
+    }
+    if (counter.count <= heap[child].count) {
+      break;
+    }
+    place(position, heap[child]);
+    position = child;
+  }
+  place(position, counter);
+}
+
+void SpaceSaving::save(SnapshotWriter &out) const {
+  ::save(out, capacity);
+  ::save(out, heap);
+  ::save(out, positions);
+}
+
+void SpaceSaving::load(SnapshotReader &in) {
+  ::load(in, capacity);
+  ::load(in, heap);
+  ::load(in, positions);
+}
+
+HierarchicalHeavyHitters::HierarchicalHeavyHitters() : threshold(0), rng(0x9e3779b97f4a7c15ULL), total_pkts(0), epoch_pkts(0) {
+  set_threshold(DEFAULT_HHH_THRESHOLD);
+}
+
+void HierarchicalHeavyHitters::set_threshold(double _threshold) {
+  assert_or_panic(_threshold > 0 && _threshold <= 1, "Invalid HHH threshold %f", _threshold);
+  threshold = _threshold;
+
+  const u64 counters = std::ceil(HHH_COUNTERS_PER_THRESHOLD / threshold);
+  for (u64 i = 0; i < HHH_SUMMARIES; i++) {
+    total[i].set_capacity(counters);
+    epoch[i].set_capacity(counters);
+  }
+}
+
+void HierarchicalHeavyHitters::access(const flow_t &flow) {
+  // xorshift64
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+
+  const u64 summary  = rng % HHH_SUMMARIES;
+  const u32 addr     = summary < HHH_LEVELS ? flow.five_tuple.src_ip : flow.five_tuple.dst_ip;
+  const bits_t level = HHH_PREFIX_SIZES[summary % HHH_LEVELS];
+  const u32 prefix   = ipv4_mask_prefix(addr, level);
+
+  total[summary].add(prefix);
+  epoch[summary].add(prefix);
+  total_pkts++;
+  epoch_pkts++;
+}
+
+void HierarchicalHeavyHitters::on_epoch_rollover() {
+  epochs.push_back(extract(epoch, epoch_pkts));
+
+  for (SpaceSaving &summary : epoch) {
+    summary.clear();
+  }
+  epoch_pkts = 0;
+}
+
+hhh_report_t HierarchicalHeavyHitters::get_report() const { return extract(total, total_pkts); }
+
+std::vector<hhh_report_t> HierarchicalHeavyHitters::get_epoch_reports() const {
+  std::vector<hhh_report_t> reports = epochs;
+  reports.push_back(extract(epoch, epoch_pkts));
+  return reports;
+}
+
+hhh_report_t HierarchicalHeavyHitters::extract(const summaries_t &summaries, u64 pkts) const {
+  return {
+      .pkts = pkts,
+      .src  = extract(summaries.data(), pkts),
+      .dst  = extract(summaries.data() + HHH_LEVELS, pkts),
+  };
+}
+
+std::vector<hhh_prefix_t> HierarchicalHeavyHitters::extract(const SpaceSaving *levels, u64 pkts) const {
+  std::vector<hhh_prefix_t> heavy;
+  // Lower bound counts of the heavy hitters, and whether one above them was found already.
+  std::vector<u64> heavy_lower_bounds;
+  std::vector<bool> covered;
+
+  const double min_pkts = threshold * pkts;
+
+  for (u64 level = 0; level < HHH_LEVELS; level++) {
+    const bits_t prefix_size = HHH_PREFIX_SIZES[level];
+
+    std::unordered_map<u32, u64> below;
+    for (u64 i = 0; i < heavy.size(); i++) {
+      if (!covered[i]) {
+        below[ipv4_mask_prefix(heavy[i].prefix, prefix_size)] += heavy_lower_bounds[i];
+      }
+    }
+
+    std::unordered_set<u32> found;
+    levels[level].for_each([&](u32 prefix, u64 count, u64 error) {
+      const u64 upper_bound = count * HHH_SUMMARIES;
+      const auto it         = below.find(prefix);
+      const u64 residual    = upper_bound - std::min(upper_bound, it == below.end() ? 0 : it->second);
+
+      if (residual > 0 && residual >= min_pkts) {
+        heavy.push_back({.prefix = prefix, .prefix_size = prefix_size, .pkts = upper_bound, .residual_pkts = residual});
+        heavy_lower_bounds.push_back((count - error) * HHH_SUMMARIES);
+        covered.push_back(false);
+        found.insert(prefix);
+      }
+    });
+
+    for (u64 i = 0; i < heavy.size(); i++) {
+      if (heavy[i].prefix_size > prefix_size && found.contains(ipv4_mask_prefix(heavy[i].prefix, prefix_size))) {
+        covered[i] = true;
+      }
+    }
+  }
+
+  std::sort(heavy.begin(), heavy.end(), [](const hhh_prefix_t &a, const hhh_prefix_t &b) {
+    if (a.prefix_size != b.prefix_size) {
+      return a.prefix_size > b.prefix_size;
+    }
+    if (a.pkts != b.pkts) {
+      return a.pkts > b.pkts;
+    }
+    return bswap32(a.prefix) < bswap32(b.prefix);
+  });
+
+  return heavy;
+}
+
+void HierarchicalHeavyHitters::save(SnapshotWriter &out) const {
+  ::save(out, rng);
+  for (const SpaceSaving &summary : total) {
+    summary.save(out);
+  }
+  ::save(out, total_pkts);
+  for (const SpaceSaving &summary : epoch) {
+    summary.save(out);
+  }
+  ::save(out, epoch_pkts);
+  ::save(out, epochs);
+}
+
+void HierarchicalHeavyHitters::load(SnapshotReader &in) {
+  ::load(in, rng);
+  for (SpaceSaving &summary : total) {
+    summary.load(in);
+  }
+  ::load(in, total_pkts);
+  for (SpaceSaving &summary : epoch) {
+    summary.load(in);
+  }
+  ::load(in, epoch_pkts);
+  ::load(in, epochs);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "incremental_hash_table.h"
+#include "snapshot.h"
+
+#include <array>
+#include <functional>
+#include <vector>
+
+// Hierarchical heavy hitters (HHH) of the source and destination addresses of the flow stream (every TCP/UDP packet): the prefixes whose
+// packets, once those of the heavy hitters below them are taken out, still make up at least a threshold fraction of the packets. A /16
+// carrying a lot of traffic spread over many addresses is then reported, as is a single heavy /32 in it, but not the /16 if that /32 is all
+// of its traffic.
+//
+// Counting is RHHH (Ben Basat et al., "Constant Time Updates in Hierarchical Heavy Hitters", SIGCOMM 2017). Every prefix size of both
+// hierarchies has a Space-Saving summary, and every packet updates a single one of them, picked at random, with its address cut to that
+// prefix size: one hash lookup and heap update per packet, however deep the hierarchy. Counts are scaled back by the number of summaries,
+// which keeps them unbiased, with a sampling error in the order of sqrt(packets * HHH_SUMMARIES), so in short epochs prefixes right at the
+// threshold may be missed or included. Summaries hold HHH_COUNTERS_PER_THRESHOLD / threshold counters, for an error of at most a tenth
+// of the threshold on top of that.
+//
+// Heavy hitters are extracted bottom up, from /32 to /8: a prefix is one if its count, minus the lower bound counts of the heavy hitters
+// below it not already under another one in between, reaches the threshold.
+
+// Most specific first.
+constexpr const std::array<bits_t, 4> HHH_PREFIX_SIZES = {32, 24, 16, 8};
+
+constexpr const u64 HHH_LEVELS                 = HHH_PREFIX_SIZES.size();
+constexpr const u64 HHH_DIMENSIONS             = 2;
+constexpr const u64 HHH_SUMMARIES              = HHH_DIMENSIONS * HHH_LEVELS;
+constexpr const u64 HHH_COUNTERS_PER_THRESHOLD = 10;
+constexpr const double DEFAULT_HHH_THRESHOLD   = 0.01;
+
+struct hhh_prefix_t {
+  // Network byte order.
+  u32 prefix;
+  bits_t prefix_size;
+  // Estimated packets of the prefix, and among them those not under a heavy hitter below it.
+  u64 pkts;
+  u64 residual_pkts;
+};
+
+struct hhh_report_t {
+  u64 pkts;
+  // Most specific first, then heaviest first.
+  std::vector<hhh_prefix_t> src;
+  std::vector<hhh_prefix_t> dst;
+};
+
+// Top-k counts of a stream of keys in k counters: a key without a counter takes over the smallest one, and inherits its count as the
+// bound on how much it may be overestimated.
+class SpaceSaving {
+private:
+  struct counter_t {
+    u32 key;
+    u64 count;
+    u64 error;
+  };
+
+  u64 capacity;
+  // Min-heap on the counts.
+  std::vector<counter_t> heap;
+  IncrementalHashTable<u32, u32, std::hash<u32>> positions;
+
+public:
+  SpaceSaving() : capacity(0) {}
+
+  void set_capacity(u64 capacity);
+  void add(u32 key);
+  void clear();
+
+  // Calls fn(key, count, error) for every counter, in no particular order.
+  template <typename Fn> void for_each(Fn &&fn) const {
+    for (const counter_t &counter : heap) {
+      fn(counter.key, counter.count, counter.error);
+    }
+  }
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+
+private:
+  void place(u64 position, const counter_t &counter);
+  void sift_up(u64 position);
+  void sift_down(u64 position);
+};
+
+class HierarchicalHeavyHitters {
+private:
+  // By dimension (source, then destination) and prefix size.
+  typedef std::array<SpaceSaving, HHH_SUMMARIES> summaries_t;
+
+  double threshold;
+  u64 rng;
+
+  summaries_t total;
+  u64 total_pkts;
+  summaries_t epoch;
+  u64 epoch_pkts;
+  // Of the epochs already over.
+  std::vector<hhh_report_t> epochs;
+
+public:
+  HierarchicalHeavyHitters();
+
+  // A fraction in (0, 1].
+  void set_threshold(double threshold);
+  double get_threshold() const { return threshold; }
+
+  void access(const flow_t &flow);
+  void on_epoch_rollover();
+
+  hhh_report_t get_report() const;
+  // Including the current one.
+  std::vector<hhh_report_t> get_epoch_reports() const;
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+
+private:
+  hhh_report_t extract(const summaries_t &summaries, u64 pkts) const;
+  std::vector<hhh_prefix_t> extract(const SpaceSaving *levels, u64 pkts) const;
+};
+
+inline void save(SnapshotWriter &out, const hhh_report_t &report) {
+  save(out, report.pkts);
+  save(out, report.src);
+  save(out, report.dst);
+}
+
+inline void load(SnapshotReader &in, hhh_report_t &report) {
+  load(in, report.pkts);
+  load(in, report.src);
+  load(in, report.dst);
+}
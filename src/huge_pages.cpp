@@ -0,0 +1,198 @@
+#include "huge_pages.h"
+#include "system.h"
+
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+
+#include <sys/mman.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+HugePages huge_pages;
+
+namespace {
+
+size_t round_up(size_t bytes, size_t alignment) { return (bytes + alignment - 1) / alignment * alignment; }
+
+} // namespace
+
+std::optional<HugePageMode> parse_huge_page_mode(std::string_view name) {
+  for (size_t i = 0; i < HUGE_PAGE_MODE_NAMES.size(); i++) {
+    if (HUGE_PAGE_MODE_NAMES[i] == name) {
+      return static_cast<HugePageMode>(i);
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<HugePages::region_t> HugePages::map_hugetlb(size_t bytes, HugePageBacking backing) {
+  const bool is_1g    = backing == HugePageBacking::Hugetlb1G;
+  const size_t length = round_up(bytes, is_1g ? HUGE_PAGE_1G : HUGE_PAGE_2M);
+  const int size_flag = is_1g ? MAP_HUGE_1GB : MAP_HUGE_2MB;
+
+  void *base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+  if (base == MAP_FAILED) {
+    return std::nullopt;
+  }
+
+  return region_t{base, length, backing};
+}
+
+HugePages::region_t HugePages::map_thp(size_t bytes) {
+  // Over-map by a huge page and trim both ends, so that the region starts on a huge page boundary.
+  const size_t length = round_up(bytes, HUGE_PAGE_2M);
+
+  u8 *mapping = static_cast<u8 *>(mmap(nullptr, length + HUGE_PAGE_2M, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (mapping == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+
+  u8 *base          = reinterpret_cast<u8 *>(round_up(reinterpret_cast<uintptr_t>(mapping), HUGE_PAGE_2M));
+  const size_t head = base - mapping;
+  if (head > 0) {
+    munmap(mapping, head);
+  }
+  munmap(base + length, HUGE_PAGE_2M - head);
+
+  // Only a hint: THP may be disabled, or limited to madvise'd regions, which this is.
+  madvise(base, length, MADV_HUGEPAGE);
+
+  return region_t{base, length, HugePageBacking::Thp};
+}
+
+void *HugePages::allocate(size_t bytes) {
+  if (mode == HugePageMode::Off || bytes < HUGE_PAGE_MIN_BYTES) {
+    void *ptr = calloc(bytes, 1);
+    if (!ptr) {
+      throw std::bad_alloc();
+    }
+    return ptr;
+  }
+
+  std::optional<region_t> region;
+  if (mode == HugePageMode::Huge1G && bytes >= HUGE_PAGE_1G) {
+    region = map_hugetlb(bytes, HugePageBacking::Hugetlb1G);
+  }
+  if (!region.has_value() && (mode == HugePageMode::Huge1G || mode == HugePageMode::Huge2M)) {
+    region = map_hugetlb(bytes, HugePageBacking::Hugetlb2M);
+  }
+  if (!region.has_value()) {
+    region = map_thp(bytes);
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  regions.emplace(region->base, region.value());
+  total_regions[static_cast<size_t>(region->backing)]++;
+  total_mapped_bytes[static_cast<size_t>(region->backing)] += region->length;
+  return region->base;
+}
+
+void HugePages::release(void *ptr) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    const auto it = regions.find(ptr);
+    if (it != regions.end()) {
+      munmap(it->second.base, it->second.length);
+      regions.erase(it);
+      return;
+    }
+  }
+
+  free(ptr);
+}
+
+std::array<huge_page_backing_stats_t, static_cast<size_t>(HugePageBacking::Count)> HugePages::get_stats() {
+  std::array<huge_page_backing_stats_t, static_cast<size_t>(HugePageBacking::Count)> stats{};
+
+  std::lock_guard<std::mutex> guard(lock);
+
+  for (size_t i = 0; i < stats.size(); i++) {
+    stats[i].total_regions      = total_regions[i];
+    stats[i].total_mapped_bytes = total_mapped_bytes[i];
+  }
+
+  for (const auto &[base, region] : regions) {
+    huge_page_backing_stats_t &backing_stats = stats[static_cast<size_t>(region.backing)];
+    backing_stats.regions++;
+    backing_stats.mapped_bytes += region.length;
+  }
+
+  // Adjacent regions with the same flags may have been merged into a single mapping, which is then accounted to the backing of the region
+  // it starts in.
+  std::ifstream smaps("/proc/self/smaps");
+  const region_t *current = nullptr;
+
+  for (std::string line; std::getline(smaps, line);) {
+    std::istringstream fields(line);
+    std::string field;
+    fields >> field;
+
+    if (field.back() != ':') {
+      // A mapping header, "start-end perms offset dev inode [path]".
+      const uintptr_t start = std::stoull(field.substr(0, field.find('-')), nullptr, 16);
+      current               = nullptr;
+
+      auto it = regions.upper_bound(reinterpret_cast<void *>(start));
+      if (it != regions.begin()) {
+        --it;
+        const uintptr_t region_start = reinterpret_cast<uintptr_t>(it->second.base);
+        if (start < region_start + it->second.length) {
+          current = &it->second;
+        }
+      }
+      continue;
+    }
+
+    if (!current) {
+      continue;
+    }
+
+    u64 kb = 0;
+    fields >> kb;
+
+    huge_page_backing_stats_t &backing_stats = stats[static_cast<size_t>(current->backing)];
+    if (field == "Rss:") {
+      backing_stats.resident_bytes += kb * 1024;
+    } else if (field == "AnonHugePages:") {
+      backing_stats.huge_bytes += kb * 1024;
+    } else if (field == "Private_Hugetlb:" || field == "Shared_Hugetlb:") {
+      // Hugetlb pages are not part of Rss.
+      backing_stats.resident_bytes += kb * 1024;
+      backing_stats.huge_bytes += kb * 1024;
+    }
+  }
+
+  return stats;
+}
+
+void HugePages::dump_to_stderr() {
+  const auto stats = get_stats();
+
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Huge pages (%s):\n", HUGE_PAGE_MODE_NAMES[static_cast<size_t>(mode)].data());
+
+  bool any = false;
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].total_regions == 0) {
+      continue;
+    }
+    any = true;
+    fprintf(stderr, "  %-12s %6lu regions %10.1f MB mapped %10.1f MB resident %10.1f MB on huge pages (%lu regions, %.1f MB ever mapped)\n",
+            HUGE_PAGE_BACKING_NAMES[i].data(), stats[i].regions, stats[i].mapped_bytes / 1e6, stats[i].resident_bytes / 1e6,
+            stats[i].huge_bytes / 1e6, stats[i].total_regions, stats[i].total_mapped_bytes / 1e6);
+  }
+
+  if (!any) {
+    fprintf(stderr, "  no allocation of at least %lu bytes\n", HUGE_PAGE_MIN_BYTES);
+  }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Huge page backing for the big, randomly accessed arrays of the tracker (DoubleChain cells and timestamps, FlowTracker::index_to_flow,
+// hash table buckets and nodes), selected with --huge-pages.
+//
+// Allocations of at least HUGE_PAGE_MIN_BYTES are mmap'ed with MAP_HUGETLB, using 1 GB pages for the ones that fill at least one in 1g
+// mode and 2 MB pages otherwise. Those need pages reserved by the admin (vm.nr_hugepages), so when the mapping fails the region falls back
+// to regular pages, 2 MB aligned and madvise'd MADV_HUGEPAGE for transparent huge pages. Smaller allocations, and every allocation in off
+// mode, come from calloc. Whichever way, the memory comes back zeroed.
+//
+// The mode must be set before the tracker is built. What actually ended up on huge pages is only known once the pages are touched, so the
+// report reads it from /proc/self/smaps.
+
+enum class HugePageMode : u8 {
+  Off,
+  Thp,
+  Huge2M,
+  Huge1G,
+  Count,
+};
+
+constexpr const std::array<std::string_view, static_cast<size_t>(HugePageMode::Count)> HUGE_PAGE_MODE_NAMES = {"off", "thp", "2m", "1g"};
+
+constexpr const size_t HUGE_PAGE_2M        = 2ull << 20;
+constexpr const size_t HUGE_PAGE_1G        = 1ull << 30;
+constexpr const size_t HUGE_PAGE_MIN_BYTES = HUGE_PAGE_2M;
+
+std::optional<HugePageMode> parse_huge_page_mode(std::string_view name);
+
+// How a region got mapped.
+enum class HugePageBacking : u8 {
+  Hugetlb1G,
+  Hugetlb2M,
+  Thp,
+  Count,
+};
+
+constexpr const std::array<std::string_view, static_cast<size_t>(HugePageBacking::Count)> HUGE_PAGE_BACKING_NAMES = {
+    "hugetlb_1g",
+    "hugetlb_2m",
+    "thp",
+};
+
+struct huge_page_backing_stats_t {
+  // Currently mapped.
+  u64 regions;
+  u64 mapped_bytes;
+  u64 resident_bytes;
+  u64 huge_bytes;
+
+  // Ever mapped, released ones included.
+  u64 total_regions;
+  u64 total_mapped_bytes;
+};
+
+class HugePages {
+private:
+  struct region_t {
+    void *base;
+    size_t length;
+    HugePageBacking backing;
+  };
+
+  HugePageMode mode;
+
+  // Mapped regions, by start address.
+  std::mutex lock;
+  std::map<void *, region_t> regions;
+  std::array<u64, static_cast<size_t>(HugePageBacking::Count)> total_regions;
+  std::array<u64, static_cast<size_t>(HugePageBacking::Count)> total_mapped_bytes;
+
+public:
+  HugePages() : mode(HugePageMode::Off), total_regions{}, total_mapped_bytes{} {}
+
+  void set_mode(HugePageMode _mode) { mode = _mode; }
+  HugePageMode get_mode() const { return mode; }
+
+  // Zeroed memory, to be returned with release().
+  void *allocate(size_t bytes);
+  void release(void *ptr);
+
+  // Per backing.
+  std::array<huge_page_backing_stats_t, static_cast<size_t>(HugePageBacking::Count)> get_stats();
+  void dump_to_stderr();
+
+private:
+  static std::optional<region_t> map_hugetlb(size_t bytes, HugePageBacking backing);
+  static region_t map_thp(size_t bytes);
+};
+
+extern HugePages huge_pages;
+
+// For std containers whose elements should follow --huge-pages.
+template <typename T> struct HugePageAllocator {
+  using value_type = T;
+
+  HugePageAllocator() = default;
+  template <typename U> HugePageAllocator(const HugePageAllocator<U> &) {}
+
+  T *allocate(size_t n) { return static_cast<T *>(huge_pages.allocate(n * sizeof(T))); }
+  void deallocate(T *ptr, size_t) { huge_pages.release(ptr); }
+
+  template <typename U> bool operator==(const HugePageAllocator<U> &) const { return true; }
+};
+
+template <typename T> using huge_vector = std::vector<T, HugePageAllocator<T>>;
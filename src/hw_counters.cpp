@@ -0,0 +1,201 @@
+#include "hw_counters.h"
+#include "system.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+HwCounters hw_counters;
+
+namespace {
+
+struct hw_event_t {
+  std::string_view name;
+  u32 type;
+  u64 config;
+};
+
+constexpr u64 hw_cache_event(u64 cache, u64 op, u64 result) { return cache | (op << 8) | (result << 16); }
+
+const std::array<hw_event_t, HW_COUNTERS_MAX_EVENTS> HW_EVENTS = {{
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"llc_load_misses", PERF_TYPE_HW_CACHE,
+     hw_cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"dtlb_load_misses", PERF_TYPE_HW_CACHE,
+     hw_cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+}};
+
+int perf_event_open(perf_event_attr *attr) { return syscall(SYS_perf_event_open, attr, 0, -1, -1, 0); }
+
+} // namespace
+
+HwCounters::~HwCounters() {
+  for (const counter_t &counter : counters) {
+    if (counter.page) {
+      munmap(counter.page, sysconf(_SC_PAGESIZE));
+    }
+    close(counter.fd);
+  }
+}
+
+bool HwCounters::enable() {
+  use_rdpmc = true;
+
+  for (const hw_event_t &event : HW_EVENTS) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = event.type;
+    attr.config         = event.config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    const int fd = perf_event_open(&attr);
+    if (fd < 0) {
+      fprintf(stderr, "HW counter %s unavailable: %s\n", event.name.data(), strerror(errno));
+      continue;
+    }
+
+    void *page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+    if (page == MAP_FAILED) {
+      page = nullptr;
+    }
+
+    const perf_event_mmap_page *mmap_page = static_cast<const perf_event_mmap_page *>(page);
+    if (!mmap_page || !mmap_page->cap_user_rdpmc) {
+      use_rdpmc = false;
+    }
+
+    counters.push_back({event.name, fd, static_cast<perf_event_mmap_page *>(page)});
+  }
+
+#if !defined(__x86_64__) && !defined(__i386__)
+  use_rdpmc = false;
+#endif
+
+  if (counters.empty()) {
+    fprintf(stderr, "No HW counters available (check kernel.perf_event_paranoid, or whether this is a VM without a virtual PMU), "
+                    "going on without them\n");
+    return false;
+  }
+
+  if (!use_rdpmc) {
+    fprintf(stderr, "Userspace rdpmc not allowed, sampling HW counters on 1 in %lu packets\n", HW_COUNTERS_SYSCALL_SAMPLE_STEP);
+  }
+
+  enabled = true;
+  return true;
+}
+
+u64 HwCounters::read_counter(const counter_t &counter) const {
+#if defined(__x86_64__) || defined(__i386__)
+  if (use_rdpmc) {
+    // Lock-free read protocol described in linux/perf_event.h.
+    const volatile perf_event_mmap_page *page = counter.page;
+    u32 seq;
+    u64 count;
+
+    do {
+      seq = page->lock;
+      __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+      const u32 index = page->index;
+      count           = page->offset;
+
+      if (page->cap_user_rdpmc && index) {
+        const u16 width = page->pmc_width;
+        i64 pmc         = __rdpmc(index - 1);
+        pmc <<= 64 - width;
+        pmc >>= 64 - width;
+        count += pmc;
+      }
+
+      __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    } while (page->lock != seq);
+
+    return count;
+  }
+#endif
+
+  u64 count = 0;
+  if (::read(counter.fd, &count, sizeof(count)) != sizeof(count)) {
+    return 0;
+  }
+  return count;
+}
+
+void HwCounters::read(u64 *values) const {
+  for (size_t i = 0; i < counters.size(); i++) {
+    values[i] = read_counter(counters[i]);
+  }
+}
+
+void HwCounters::add(HwCounterStage stage, const u64 *start) {
+  std::array<u64, HW_COUNTERS_MAX_EVENTS> end;
+  read(end.data());
+
+  std::array<u64, HW_COUNTERS_MAX_EVENTS> &stage_totals = totals[static_cast<size_t>(stage)];
+  for (size_t i = 0; i < counters.size(); i++) {
+    stage_totals[i] += end[i] - start[i];
+  }
+  sampled[static_cast<size_t>(stage)]++;
+}
+
+double HwCounters::per_million_pkts(HwCounterStage stage, size_t counter) const {
+  const u64 stage_sampled = sampled[static_cast<size_t>(stage)];
+  return stage_sampled > 0 ? totals[static_cast<size_t>(stage)][counter] * static_cast<double>(MILLION) / stage_sampled : 0;
+}
+
+void HwCounters::dump_to_stderr() const {
+  fprintf(stderr, "\nHW counters per million packets (%s):\n", use_rdpmc ? "every packet measured" : "sampled");
+  fprintf(stderr, "  %-18s", "event");
+  for (const std::string_view stage : HW_COUNTER_STAGE_NAMES) {
+    fprintf(stderr, " %16s", stage.data());
+  }
+  fprintf(stderr, "\n");
+
+  for (size_t i = 0; i < counters.size(); i++) {
+    fprintf(stderr, "  %-18s", counters[i].name.data());
+    for (size_t stage = 0; stage < HW_COUNTER_STAGE_NAMES.size(); stage++) {
+      fprintf(stderr, " %16.0f", per_million_pkts(static_cast<HwCounterStage>(stage), i));
+    }
+    fprintf(stderr, "\n");
+  }
+}
+
+void HwCounters::write_json(JsonWriter &j) const {
+  // Keys in lexicographic order, matching the report.
+  std::vector<size_t> stages(HW_COUNTER_STAGE_NAMES.size());
+  std::iota(stages.begin(), stages.end(), 0);
+  std::sort(stages.begin(), stages.end(), [](size_t a, size_t b) { return HW_COUNTER_STAGE_NAMES[a] < HW_COUNTER_STAGE_NAMES[b]; });
+
+  std::vector<size_t> events(counters.size());
+  std::iota(events.begin(), events.end(), 0);
+  std::sort(events.begin(), events.end(), [this](size_t a, size_t b) { return counters[a].name < counters[b].name; });
+
+  j.begin_object();
+  for (const size_t stage : stages) {
+    j.key(HW_COUNTER_STAGE_NAMES[stage]);
+    j.begin_object();
+    j.key("per_million_pkts");
+    j.begin_object();
+    for (const size_t i : events) {
+      j.field(counters[i].name, per_million_pkts(static_cast<HwCounterStage>(stage), i));
+    }
+    j.end_object();
+    j.field("sampled_packets", sampled[stage]);
+    j.end_object();
+  }
+  j.end_object();
+}
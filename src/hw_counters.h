@@ -0,0 +1,114 @@
+#pragma once
+
+#include "types.h"
+#include "json_writer.h"
+#include "profiler.h"
+
+#include <array>
+#include <string_view>
+#include <vector>
+
+#include <linux/perf_event.h>
+
+// Hardware performance counters (perf_event_open) attributed to the reader, the header parser and the tracker, enabled with
+// --hw-counters on top of --profile.
+//
+// Counters are read from userspace with rdpmc when the kernel allows it, which is cheap enough to do around every packet. Otherwise every
+// read is a syscall, so only one in HW_COUNTERS_SYSCALL_SAMPLE_STEP packets gets measured and the totals are extrapolated. Events the PMU
+// (or the permissions, or the hypervisor) does not provide are skipped, and with none at all the run goes on without counters.
+
+enum class HwCounterStage : u8 {
+  Reader,
+  Parser,
+  Tracker,
+  Count,
+};
+
+constexpr const std::array<std::string_view, static_cast<size_t>(HwCounterStage::Count)> HW_COUNTER_STAGE_NAMES = {
+    "reader",
+    "parser",
+    "tracker",
+};
+
+constexpr const size_t HW_COUNTERS_MAX_EVENTS         = 6;
+constexpr const u64 HW_COUNTERS_SYSCALL_SAMPLE_STEP = 1024;
+
+class HwCounters {
+private:
+  struct counter_t {
+    std::string_view name;
+    int fd;
+    perf_event_mmap_page *page;
+  };
+
+  bool enabled;
+  bool use_rdpmc;
+  std::vector<counter_t> counters;
+
+  // Packets seen by the reader, and whether the current one is being measured.
+  u64 pkts;
+  bool sampling;
+
+  std::array<std::array<u64, HW_COUNTERS_MAX_EVENTS>, static_cast<size_t>(HwCounterStage::Count)> totals;
+  std::array<u64, static_cast<size_t>(HwCounterStage::Count)> sampled;
+
+public:
+  HwCounters() : enabled(false), use_rdpmc(false), pkts(0), sampling(false), totals{}, sampled{} {}
+  ~HwCounters();
+
+  // Returns false (after explaining why) if no counter could be opened.
+  bool enable();
+  bool is_enabled() const { return enabled; }
+
+  void begin_packet() {
+    pkts++;
+    sampling = enabled && (use_rdpmc || pkts % HW_COUNTERS_SYSCALL_SAMPLE_STEP == 0);
+  }
+
+  bool is_sampling() const { return sampling; }
+
+  void read(u64 *values) const;
+  void add(HwCounterStage stage, const u64 *start);
+
+  void dump_to_stderr() const;
+  void write_json(JsonWriter &j) const;
+
+private:
+  u64 read_counter(const counter_t &counter) const;
+  double per_million_pkts(HwCounterStage stage, size_t counter) const;
+};
+
+extern HwCounters hw_counters;
+
+class HwCounterScope {
+private:
+  const HwCounterStage stage;
+  std::array<u64, HW_COUNTERS_MAX_EVENTS> start;
+  bool active;
+
+public:
+  HwCounterScope(HwCounterStage _stage) : stage(_stage) {
+    if (stage == HwCounterStage::Reader) {
+      hw_counters.begin_packet();
+    }
+
+    active = hw_counters.is_sampling();
+    if (active) {
+      hw_counters.read(start.data());
+    }
+  }
+
+  ~HwCounterScope() {
+    if (active) {
+      hw_counters.add(stage, start.data());
+    }
+  }
+};
+
+#ifdef PROFILING_ENABLED
+#define PROFILE_HW_SCOPE(stage) HwCounterScope PROFILE_CONCAT(profile_hw_scope_, __LINE__)(stage)
+#else
+#define PROFILE_HW_SCOPE(stage)                                                                                                                      \
+  do {                                                                                                                                               \
+  } while (0)
+#endif
@@ -0,0 +1,346 @@
+#pragma once
+
+#include "types.h"
+#include "system.h"
+#include "huge_pages.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Chained hash table that grows incrementally.
+//
+// std::unordered_map rehashes everything at once when it crosses its max load factor, which for tens of millions of flows stalls ingest
+// for hundreds of milliseconds. Here, growing allocates a table with twice the buckets and then every insert/erase migrates a bounded
+// number of buckets from the old one (at most INCREMENTAL_HASH_TABLE_MIGRATION_STEP non-empty ones, and a few times that many empty ones),
+// so that no single operation pays for more than a handful of chains. Lookups check both tables while a migration is in progress. The
+// new bucket array comes zeroed from calloc or mmap, which for big tables means lazily zeroed pages, so starting a migration costs next to
+// nothing. Big bucket arrays and the node chunks follow --huge-pages (see huge_pages.h).
+//
+// Nodes live in fixed size chunks that are never moved, linked by 32 bit indexes (0 being the null index), and are recycled through a
+// free list, so steady state churn does not hit the allocator either. Hashes are finalized with a 64 bit mixer, as buckets are picked with
+// a power of two mask and the flow hashes are plain XORs of the fields.
+
+constexpr const u64 INCREMENTAL_HASH_TABLE_MIN_BUCKETS    = 16;
+constexpr const u64 INCREMENTAL_HASH_TABLE_MIGRATION_STEP = 4;
+constexpr const u64 INCREMENTAL_HASH_TABLE_EMPTY_VISITS   = 10 * INCREMENTAL_HASH_TABLE_MIGRATION_STEP;
+constexpr const u64 INCREMENTAL_HASH_TABLE_CHUNK_BITS     = 16;
+
+// Value type for tables used as sets. Not stored in snapshots.
+struct hash_set_tag_t {};
+
+template <typename K, typename V, typename Hash> class IncrementalHashTable {
+public:
+  using key_type    = K;
+  using mapped_type = V;
+  using value_type  = std::pair<K, V>;
+
+private:
+  static constexpr const u32 NIL        = 0;
+  static constexpr const u64 CHUNK_SIZE = 1 << INCREMENTAL_HASH_TABLE_CHUNK_BITS;
+
+  struct node_t {
+    K key;
+    V value;
+    u32 hash;
+    u32 next;
+  };
+
+  struct table_t {
+    u32 *buckets;
+    u64 mask;
+    u64 size;
+
+    table_t() : buckets(nullptr), mask(0), size(0) {}
+
+    u64 bucket_count() const { return buckets ? mask + 1 : 0; }
+
+    void allocate(u64 bucket_count) {
+      buckets = static_cast<u32 *>(huge_pages.allocate(bucket_count * sizeof(u32)));
+      mask = bucket_count - 1;
+      size = 0;
+    }
+
+    void release() {
+      if (buckets) {
+        huge_pages.release(buckets);
+      }
+      buckets = nullptr;
+      mask    = 0;
+      size    = 0;
+    }
+  };
+
+  Hash hasher;
+
+  // While migrating, tables[0] is the old table and tables[1] the new one, and buckets below next_migrated_bucket are already empty.
+  table_t tables[2];
+  bool migrating;
+  u64 next_migrated_bucket;
+
+  std::vector<huge_vector<node_t>> chunks;
+  u32 free_nodes;
+  u64 used_nodes;
+
+  u32 growths;
+
+public:
+  IncrementalHashTable() : migrating(false), next_migrated_bucket(0), free_nodes(NIL), used_nodes(0), growths(0) {
+    tables[0].allocate(INCREMENTAL_HASH_TABLE_MIN_BUCKETS);
+  }
+
+  ~IncrementalHashTable() {
+    tables[0].release();
+    tables[1].release();
+  }
+
+  IncrementalHashTable(const IncrementalHashTable &)            = delete;
+  IncrementalHashTable &operator=(const IncrementalHashTable &) = delete;
+
+  u64 size() const { return tables[0].size + tables[1].size; }
+  bool empty() const { return size() == 0; }
+
+  // Of the table being grown into, while migrating.
+  u64 bucket_count() const { return current_table().bucket_count(); }
+  // Including the elements of the old table that have yet to migrate into it.
+  u64 bucket_size(u64 bucket) const {
+    u64 len = 0;
+    for (u32 n = current_table().buckets[bucket]; n != NIL; n = node(n).next) {
+      len++;
+    }
+    if (migrating) {
+      for (u32 n = tables[0].buckets[bucket & tables[0].mask]; n != NIL; n = node(n).next) {
+        len += (node(n).hash & tables[1].mask) == bucket;
+      }
+    }
+    return len;
+  }
+
+  double load_factor() const { return size() / static_cast<double>(bucket_count()); }
+
+  // Growth starts when the load factor reaches 1.
+  float max_load_factor() const { return 1; }
+
+  bool is_migrating() const { return migrating; }
+  // Since construction or the last clear().
+  u32 get_growths() const { return growths; }
+
+  u64 get_bytes() const {
+    return (tables[0].bucket_count() + tables[1].bucket_count()) * sizeof(u32) + chunks.size() * CHUNK_SIZE * sizeof(node_t);
+  }
+
+  const V *find(const K &key) const {
+    const u64 h = mix(hasher(key));
+    for (int t = 0; t < (migrating ? 2 : 1); t++) {
+      for (u32 n = tables[t].buckets[h & tables[t].mask]; n != NIL; n = node(n).next) {
+        if (node(n).hash == static_cast<u32>(h) && node(n).key == key) {
+          return &node(n).value;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  V *find(const K &key) { return const_cast<V *>(static_cast<const IncrementalHashTable *>(this)->find(key)); }
+
+  bool contains(const K &key) const { return find(key) != nullptr; }
+
+  // Inserts a default constructed value if the key is not there yet.
+  V &operator[](const K &key) {
+    migrate_step();
+
+    V *value = find(key);
+    if (value) {
+      return *value;
+    }
+
+    if (!migrating && tables[0].size >= tables[0].bucket_count()) {
+      start_growth();
+    }
+
+    const u64 h  = mix(hasher(key));
+    const u32 n  = allocate_node();
+    node_t &slot = node(n);
+    slot.key     = key;
+    slot.value   = V();
+    slot.hash    = static_cast<u32>(h);
+    link(current_table_mut(), n, h);
+
+    return slot.value;
+  }
+
+  void insert(const K &key) { (*this)[key]; }
+
+  bool erase(const K &key) {
+    migrate_step();
+
+    const u64 h = mix(hasher(key));
+    for (int t = 0; t < (migrating ? 2 : 1); t++) {
+      u32 *prev = &tables[t].buckets[h & tables[t].mask];
+      for (u32 n = *prev; n != NIL; prev = &node(n).next, n = *prev) {
+        if (node(n).hash == static_cast<u32>(h) && node(n).key == key) {
+          *prev = node(n).next;
+          tables[t].size--;
+          release_node(n);
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  // Calls fn(key, value) for every element, in no particular order.
+  template <typename Fn> void for_each(Fn &&fn) const {
+    for (int t = 0; t < (migrating ? 2 : 1); t++) {
+      for (u64 bucket = 0; bucket < tables[t].bucket_count(); bucket++) {
+        for (u32 n = tables[t].buckets[bucket]; n != NIL; n = node(n).next) {
+          fn(node(n).key, node(n).value);
+        }
+      }
+    }
+  }
+
+  // Keeps the node chunks and the biggest bucket array, so that a table that is cleared and refilled over and over (e.g. once per epoch)
+  // goes back to the allocator only when it outgrows its previous peak. A table much bigger than what it held (typically a pre-sized one)
+  // only resets the buckets its nodes hashed to.
+  void clear() {
+    if (migrating) {
+      tables[0].release();
+      tables[0] = tables[1];
+      tables[1] = table_t();
+    }
+    if (used_nodes < tables[0].bucket_count() / 8) {
+      for (u32 n = 1; n <= used_nodes; n++) {
+        tables[0].buckets[node(n).hash & tables[0].mask] = NIL;
+      }
+    } else {
+      memset(tables[0].buckets, 0, tables[0].bucket_count() * sizeof(u32));
+    }
+    tables[0].size       = 0;
+    migrating            = false;
+    next_migrated_bucket = 0;
+    free_nodes           = NIL;
+    used_nodes           = 0;
+    growths              = 0;
+  }
+
+  // Makes room for count elements, buckets and nodes, so that inserting up to that many never allocates. Only meant for empty tables:
+  // pre-sizing before ingest starts, or bulk loading a snapshot.
+  void reserve(u64 count) {
+    assert(empty());
+    u64 buckets = INCREMENTAL_HASH_TABLE_MIN_BUCKETS;
+    while (buckets < count) {
+      buckets *= 2;
+    }
+    if (buckets > tables[0].bucket_count()) {
+      tables[0].release();
+      tables[0].allocate(buckets);
+    }
+    while (chunks.size() * CHUNK_SIZE < count) {
+      add_chunk();
+    }
+  }
+
+private:
+  static u64 mix(u64 h) {
+    // MurmurHash3's fmix64.
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  const table_t &current_table() const { return tables[migrating ? 1 : 0]; }
+  table_t &current_table_mut() { return tables[migrating ? 1 : 0]; }
+
+  node_t &node(u32 n) { return chunks[(n - 1) >> INCREMENTAL_HASH_TABLE_CHUNK_BITS][(n - 1) & (CHUNK_SIZE - 1)]; }
+  const node_t &node(u32 n) const { return chunks[(n - 1) >> INCREMENTAL_HASH_TABLE_CHUNK_BITS][(n - 1) & (CHUNK_SIZE - 1)]; }
+
+  u32 allocate_node() {
+    if (free_nodes != NIL) {
+      const u32 n = free_nodes;
+      free_nodes  = node(n).next;
+      return n;
+    }
+
+    if (used_nodes == chunks.size() * CHUNK_SIZE) {
+      add_chunk();
+    }
+
+    return ++used_nodes;
+  }
+
+  void add_chunk() {
+    assert_or_panic((chunks.size() + 1) * CHUNK_SIZE < (1ULL << 32), "IncrementalHashTable node indexes exhausted");
+    chunks.emplace_back(CHUNK_SIZE);
+  }
+
+  void release_node(u32 n) {
+    node(n).value = V();
+    node(n).next  = free_nodes;
+    free_nodes    = n;
+  }
+
+  // Only the low 32 bits of the hash are kept in the node, which is plenty for the bucket index (and a quick key mismatch check).
+  void link(table_t &table, u32 n, u64 h) {
+    u32 &bucket  = table.buckets[h & table.mask];
+    node(n).next = bucket;
+    bucket       = n;
+    table.size++;
+  }
+
+  void start_growth() {
+    tables[1].allocate(tables[0].bucket_count() * 2);
+    migrating            = true;
+    next_migrated_bucket = 0;
+    growths++;
+  }
+
+  void migrate_step() {
+    if (!migrating) {
+      return;
+    }
+
+    u64 migrated_buckets = 0;
+    u64 empty_visits     = 0;
+
+    while (next_migrated_bucket < tables[0].bucket_count() && migrated_buckets < INCREMENTAL_HASH_TABLE_MIGRATION_STEP) {
+      u32 n = tables[0].buckets[next_migrated_bucket];
+
+      if (n == NIL) {
+        next_migrated_bucket++;
+        if (++empty_visits == INCREMENTAL_HASH_TABLE_EMPTY_VISITS) {
+          break;
+        }
+        continue;
+      }
+
+      while (n != NIL) {
+        const u32 next = node(n).next;
+        link(tables[1], n, node(n).hash);
+        tables[0].size--;
+        n = next;
+      }
+
+      tables[0].buckets[next_migrated_bucket] = NIL;
+      next_migrated_bucket++;
+      migrated_buckets++;
+    }
+
+    if (next_migrated_bucket == tables[0].bucket_count()) {
+      assert(tables[0].size == 0);
+      tables[0].release();
+      tables[0] = tables[1];
+      tables[1] = table_t();
+      migrating = false;
+    }
+  }
+};
+
+template <typename K, typename Hash> using IncrementalHashSet = IncrementalHashTable<K, hash_set_tag_t, Hash>;
@@ -0,0 +1,154 @@
+#include "json_writer.h"
+#include "system.h"
+
+#include <charconv>
+#include <cmath>
+
+#include <nlohmann/json.hpp>
+
+JsonWriter::JsonWriter(FILE *_out, int _indent) : out(_out), indent(_indent), pending_key(false) {}
+
+void JsonWriter::begin_object() {
+  begin_element();
+  write_raw("{", 1);
+  scope_has_elements.push_back(false);
+}
+
+void JsonWriter::end_object() { end_scope('}'); }
+
+void JsonWriter::begin_array() {
+  begin_element();
+  write_raw("[", 1);
+  scope_has_elements.push_back(false);
+}
+
+void JsonWriter::end_array() { end_scope(']'); }
+
+void JsonWriter::key(std::string_view name) {
+  assert(!pending_key && "Two keys in a row");
+  begin_element();
+  write_raw("\"", 1);
+  write_raw(name.data(), name.size());
+  write_raw("\": ", 3);
+  pending_key = true;
+}
+
+void JsonWriter::value(u64 v) {
+  begin_element();
+  char buffer[32];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+  write_raw(buffer, result.ptr - buffer);
+}
+
+void JsonWriter::value(i64 v) {
+  begin_element();
+  char buffer[32];
+  const auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+  write_raw(buffer, result.ptr - buffer);
+}
+
+void JsonWriter::value(double v) {
+  if (!std::isfinite(v)) {
+    null();
+    return;
+  }
+
+  begin_element();
+
+  // Reuse nlohmann's grisu2 formatter, so that floating point values are byte for byte identical to what json::dump() produces.
+  char buffer[64];
+  char *end = nlohmann::detail::to_chars(buffer, buffer + sizeof(buffer), v);
+  write_raw(buffer, end - buffer);
+}
+
+void JsonWriter::value(std::string_view v) {
+  begin_element();
+  write_raw("\"", 1);
+  for (const char c : v) {
+    switch (c) {
+    case '"':
+      write_raw("\\\"", 2);
+      break;
+    case '\\':
+      write_raw("\\\\", 2);
+      break;
+    case '\b':
+      write_raw("\\b", 2);
+      break;
+    case '\f':
+      write_raw("\\f", 2);
+      break;
+    case '\n':
+      write_raw("\\n", 2);
+      break;
+    case '\r':
+      write_raw("\\r", 2);
+      break;
+    case '\t':
+      write_raw("\\t", 2);
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[7];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+        write_raw(escaped, 6);
+      } else {
+        write_raw(&c, 1);
+      }
+    }
+  }
+  write_raw("\"", 1);
+}
+
+void JsonWriter::null() {
+  begin_element();
+  write_raw("null", 4);
+}
+
+void JsonWriter::finish() {
+  assert(scope_has_elements.empty() && "Unbalanced JSON scopes");
+  write_raw("\n", 1);
+}
+
+void JsonWriter::begin_element() {
+  if (pending_key) {
+    // The key was already placed, this is its value.
+    pending_key = false;
+    return;
+  }
+
+  if (scope_has_elements.empty()) {
+    return;
+  }
+
+  if (scope_has_elements.back()) {
+    write_raw(",", 1);
+  }
+
+  write_raw("\n", 1);
+  write_indent(scope_has_elements.size());
+  scope_has_elements.back() = true;
+}
+
+void JsonWriter::end_scope(char closing) {
+  assert(!scope_has_elements.empty() && "Unbalanced JSON scopes");
+  const bool has_elements = scope_has_elements.back();
+  scope_has_elements.pop_back();
+
+  if (has_elements) {
+    write_raw("\n", 1);
+    write_indent(scope_has_elements.size());
+  }
+
+  write_raw(&closing, 1);
+}
+
+void JsonWriter::write_indent(size_t depth) {
+  static const char spaces[] = "                                ";
+  size_t remaining           = depth * indent;
+  while (remaining > 0) {
+    const size_t chunk = std::min(remaining, sizeof(spaces) - 1);
+    write_raw(spaces, chunk);
+    remaining -= chunk;
+  }
+}
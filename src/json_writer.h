@@ -0,0 +1,52 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+// Streaming JSON emitter.
+//
+// Produces exactly the same text as building a nlohmann::json DOM and calling dump(indent), without ever materializing the DOM. The
+// caller is responsible for emitting object keys in lexicographic order, as that is the order in which nlohmann's (std::map backed)
+// objects get serialized.
+class JsonWriter {
+private:
+  FILE *out;
+  const int indent;
+
+  // One entry per open object/array, telling whether anything was written in it yet.
+  std::vector<bool> scope_has_elements;
+  bool pending_key;
+
+public:
+  JsonWriter(FILE *_out, int _indent = 2);
+
+  void begin_object();
+  void end_object();
+  void begin_array();
+  void end_array();
+
+  void key(std::string_view name);
+
+  void value(u64 v);
+  void value(i64 v);
+  void value(double v);
+  void value(std::string_view v);
+  void null();
+
+  template <typename T> void field(std::string_view name, T v) {
+    key(name);
+    value(v);
+  }
+
+  // Flushes the trailing newline once the top level value is complete.
+  void finish();
+
+private:
+  void begin_element();
+  void end_scope(char closing);
+  void write_indent(size_t depth);
+  void write_raw(const char *data, size_t size) { fwrite(data, 1, size, out); }
+};
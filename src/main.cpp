@@ -2,75 +2,443 @@
 
 #include "pcap_reader.h"
 #include "traffic_stats_tracker.h"
+#include "checkpoint.h"
+#include "telemetry.h"
+#include "profiler.h"
+#include "hw_counters.h"
+#include "alloc_tracker.h"
+#include "huge_pages.h"
 #include "system.h"
 
+#include <csignal>
 #include <iostream>
 #include <filesystem>
+#include <memory>
 
-constexpr const time_ns_t DEFAULT_EPOCH_DURATION_NS = 1'000'000'000; // 1 second in nanoseconds
+constexpr const time_ns_t DEFAULT_EPOCH_DURATION_NS  = 1'000'000'000; // 1 second in nanoseconds
+constexpr const time_s_t DEFAULT_CHECKPOINT_INTERVAL_S = 600;
+constexpr const u64 DEFAULT_TELEMETRY_INTERVAL_MS      = 1'000;
+constexpr const u64 HOUSEKEEPING_STEP                  = 64 * 1024; // Packets between telemetry updates and checkpoint/snapshot checks.
+
+namespace {
+
+volatile sig_atomic_t snapshot_report_requested = 0;
+
+void request_snapshot_report(int) { snapshot_report_requested = 1; }
+
+template <typename Tracker>
+void publish_telemetry(telemetry_counters_t &counters, const Tracker &tracker, const pcap_reader_t &reader,
+                       u64 previous_passes_input_bytes, u64 previous_passes_pcap_bytes, u64 input_file_size) {
+  const u64 input_bytes = reader.get_input_bytes();
+
+  counters.pkts.store(tracker.report.total_pkts, std::memory_order_relaxed);
+  counters.bytes.store(tracker.report.total_bytes, std::memory_order_relaxed);
+  counters.input_bytes.store(previous_passes_input_bytes + input_bytes, std::memory_order_relaxed);
+  counters.input_pcap_bytes.store(previous_passes_pcap_bytes + reader.offset, std::memory_order_relaxed);
+  counters.input_bytes_left.store(input_file_size - std::min(input_bytes, input_file_size), std::memory_order_relaxed);
+  if constexpr (Tracker::has(Metric::Churn)) {
+    counters.live_flows.store(tracker.flow_tracker.get_live_flows(), std::memory_order_relaxed);
+    counters.flow_table_load_factor.store(tracker.flow_tracker.get_load_factor(), std::memory_order_relaxed);
+  }
+}
+
+// Reports on everything processed so far, from a forked child so that ingest is not paused.
+template <typename Tracker> void dump_snapshot_report(BackgroundJob &job, Tracker &tracker, const std::filesystem::path &file) {
+  const bool started = job.start([&]() {
+    const std::filesystem::path tmp_file = file.string() + ".tmp";
+
+    // This is the child's private copy of the tracker, so finalizing it does not affect the parent.
+    tracker.generate_report();
+    tracker.dump_report_to_json_file(tmp_file);
+
+    if (rename(tmp_file.c_str(), file.c_str()) != 0) {
+      perror("rename");
+      return false;
+    }
+
+    return true;
+  });
+
+  if (!started) {
+    fprintf(stderr, "Previous snapshot report still being generated, ignoring request\n");
+  }
+}
+
+} // namespace
 
 struct args_t {
   std::filesystem::path pcap_file;
   std::filesystem::path output_report;
+  std::filesystem::path output_bin_report;
+  std::filesystem::path output_flows;
   time_ns_t epoch_duration;
   std::optional<Mbps_t> rate;
+  std::filesystem::path snapshot_report;
+  std::filesystem::path checkpoint_file;
+  time_s_t checkpoint_interval;
+  bool resume;
+  u64 telemetry_interval_ms;
+  std::filesystem::path telemetry_output;
+  bool profile;
+  std::filesystem::path profile_output;
+  bool hw_counters;
+  bool table_stats;
+  u64 expected_flows;
+  std::string metrics;
+  std::vector<std::string> flow_tables;
+  std::vector<u64> rss_queues;
+  std::string rss_key;
+  bool rss_symmetric;
+  std::optional<double> hhh_threshold;
+  std::string filter;
+  std::string huge_page_mode;
+  u64 readahead_mb;
+  bool drop_behind;
 
-  args_t() : epoch_duration(DEFAULT_EPOCH_DURATION_NS) {}
+  args_t()
+      : epoch_duration(DEFAULT_EPOCH_DURATION_NS), checkpoint_interval(DEFAULT_CHECKPOINT_INTERVAL_S), resume(false),
+        telemetry_interval_ms(DEFAULT_TELEMETRY_INTERVAL_MS), profile(false), hw_counters(false), table_stats(false),
+        expected_flows(0), metrics("all"), rss_symmetric(false), huge_page_mode("off"), readahead_mb(0), drop_behind(false) {}
 };
 
-int main(int argc, char **argv) {
-  args_t args;
+namespace {
 
-  CLI::App app{"Pcap stats"};
-  app.add_option("pcap", args.pcap_file, "Pcap file.")->required();
-  app.add_option("--out", args.output_report, "Output report JSON file.");
-  app.add_option("--epoch", args.epoch_duration, "Epoch duration in nanoseconds (default: 1s).");
-  app.add_option("--mbps", args.rate, "Replay rate in Mbps (optional).");
+template <typename Tracker> void run(const args_t &args, const checkpoint_params_t &checkpoint_params) {
+  Tracker traffic_stats_tracker(args.epoch_duration);
+  traffic_stats_tracker.set_metrics(checkpoint_params.metrics);
+  // The simulators of the opt-in metrics only exist once set_metrics switched them on.
+  if constexpr (Tracker::has(Metric::FlowTables)) {
+    if (traffic_stats_tracker.flow_table_simulator) {
+      traffic_stats_tracker.flow_table_simulator->set_geometries(checkpoint_params.flow_tables);
+    }
+  }
+  if constexpr (Tracker::has(Metric::Rss)) {
+    if (traffic_stats_tracker.rss_simulator) {
+      traffic_stats_tracker.rss_simulator->set_config(checkpoint_params.rss);
+    }
+  }
+  if constexpr (Tracker::has(Metric::Hhh)) {
+    // hhh_threshold is 0 when the metric is off.
+    if (has_metric(checkpoint_params.metrics, Metric::Hhh)) {
+      traffic_stats_tracker.heavy_hitters->set_threshold(checkpoint_params.hhh_threshold);
+    }
+  }
+  traffic_stats_tracker.collect_table_stats = args.table_stats;
+  if (args.expected_flows > 0) {
+    traffic_stats_tracker.reserve_flows(args.expected_flows);
+  }
 
-  CLI11_PARSE(app, argc, argv);
+  std::unique_ptr<FlowRecordWriter> flow_record_writer;
+  if (!args.output_flows.empty()) {
+    flow_record_writer = std::make_unique<FlowRecordWriter>(args.output_flows);
+    if constexpr (Tracker::has(Metric::Churn)) {
+      traffic_stats_tracker.flow_tracker.set_record_sink(flow_record_writer.get());
+    }
+  }
 
-  if (!std::filesystem::exists(args.pcap_file)) {
-    fprintf(stderr, "File %s not found\n", args.pcap_file.c_str());
-    exit(1);
+  std::optional<replay_state_t> resume_state;
+  if (args.resume) {
+    resume_state = load_checkpoint(args.checkpoint_file, checkpoint_params, traffic_stats_tracker);
+  }
+
+  std::unique_ptr<Checkpointer> checkpointer;
+  if (!args.checkpoint_file.empty()) {
+    checkpointer = std::make_unique<Checkpointer>(args.checkpoint_file, checkpoint_params, std::chrono::seconds(args.checkpoint_interval));
   }
 
-  traffic_stats_tracker_t traffic_stats_tracker(args.epoch_duration);
+  std::unique_ptr<Telemetry> telemetry;
+  if (args.telemetry_interval_ms > 0) {
+    telemetry = std::make_unique<Telemetry>(std::chrono::milliseconds(args.telemetry_interval_ms), args.telemetry_output);
+  }
+
+  const u64 input_file_size       = std::filesystem::file_size(args.pcap_file);
+  u64 previous_passes_input_bytes = 0;
+  u64 previous_passes_pcap_bytes  = 0;
+
+  BackgroundJob snapshot_report_job("snapshot report");
+  signal(SIGUSR1, request_snapshot_report);
+
+  // A resumed pass is always finished, no matter how much of the trace was already covered.
+  while (resume_state.has_value() ||
+         traffic_stats_tracker.report.end - traffic_stats_tracker.report.start < traffic_stats_tracker.clock.epoch_duration) {
+    replay_state_t state{};
 
-  while (traffic_stats_tracker.report.end - traffic_stats_tracker.report.start < traffic_stats_tracker.clock.epoch_duration) {
-    const time_ns_t base_time = traffic_stats_tracker.report.end - traffic_stats_tracker.report.start;
-    time_ns_t current_time    = base_time;
+    if (resume_state.has_value()) {
+      state = resume_state.value();
+      resume_state.reset();
+    } else {
+      state.base_time    = traffic_stats_tracker.report.end - traffic_stats_tracker.report.start;
+      state.current_time = state.base_time;
+    }
 
     pcap_reader_t reader(args.pcap_file);
+    if (!args.filter.empty()) {
+      reader.set_filter(args.filter);
+    }
+    if (args.readahead_mb > 0 || args.drop_behind) {
+      reader.set_page_cache_policy({
+          .readahead_bytes = args.readahead_mb << 20,
+          .drop_behind     = args.drop_behind,
+      });
+    }
+    if (state.position.offset > 0) {
+      reader.seek(state.position);
+    }
+
+    u64 pkts_until_housekeeping = HOUSEKEEPING_STEP;
+
     packet_t packet;
     while (reader.read_next_packet(packet)) {
-      if (current_time == 0) {
-        current_time = packet.ts;
+      if (state.current_time == 0) {
+        state.current_time = packet.ts;
       }
 
       if (args.rate.has_value()) {
         const bits_t bits_in_wire   = (PREAMBLE_SIZE_BYTES + IPG_SIZE_BYTES + packet.total_len) * 8;
         const time_ns_t pkt_time_ns = (THOUSAND * bits_in_wire) / static_cast<double>(args.rate.value());
-        current_time += pkt_time_ns;
+        state.current_time += pkt_time_ns;
       } else {
-        current_time = base_time + packet.ts;
+        state.current_time = state.base_time + packet.ts;
       }
 
-      packet.ts = current_time;
+      packet.ts = state.current_time;
       traffic_stats_tracker.feed_packet(packet);
+
+      if (--pkts_until_housekeeping == 0) {
+        pkts_until_housekeeping = HOUSEKEEPING_STEP;
+
+        if (telemetry) {
+          publish_telemetry(telemetry->counters, traffic_stats_tracker, reader, previous_passes_input_bytes, previous_passes_pcap_bytes,
+                            input_file_size);
+        }
+
+        if (checkpointer) {
+          state.position = reader.get_position();
+          checkpointer->tick(traffic_stats_tracker, state);
+        }
+
+        if (snapshot_report_requested) {
+          snapshot_report_requested = 0;
+          if (args.snapshot_report.empty()) {
+            fprintf(stderr, "Snapshot report requested, but neither --snapshot-report nor --out were given\n");
+          } else {
+            dump_snapshot_report(snapshot_report_job, traffic_stats_tracker, args.snapshot_report);
+          }
+        }
+      }
+    }
+
+    if (telemetry) {
+      publish_telemetry(telemetry->counters, traffic_stats_tracker, reader, previous_passes_input_bytes, previous_passes_pcap_bytes,
+                        input_file_size);
     }
 
+    previous_passes_input_bytes += reader.get_input_bytes();
+    previous_passes_pcap_bytes += reader.offset;
+
     const time_ns_t elapsed_ns = traffic_stats_tracker.report.end - traffic_stats_tracker.report.start;
 
     std::cerr << "pkts:    " << traffic_stats_tracker.report.total_pkts << "\n";
+    if (!args.filter.empty()) {
+      std::cerr << "dropped: " << reader.filtered_pkts << " (filter)\n";
+    }
     std::cerr << "start:   " << traffic_stats_tracker.report.start << "\n";
     std::cerr << "end:     " << traffic_stats_tracker.report.end << "\n";
     std::cerr << "elapsed: " << elapsed_ns << " ns (" << (elapsed_ns / static_cast<double>(BILLION)) << " s)\n";
+    if constexpr (ALLOC_TRACKING) {
+      std::cerr << "allocs:  " << get_tracked_allocations() << "\n";
+    }
+
+    if (traffic_stats_tracker.report.total_pkts == 0) {
+      // Nothing to replay again, e.g. the filter dropped every packet.
+      break;
+    }
+  }
+
+  if (telemetry) {
+    telemetry->close();
+  }
+
+  if (flow_record_writer) {
+    if constexpr (Tracker::has(Metric::Churn)) {
+      traffic_stats_tracker.flow_tracker.flush_records();
+    }
+    flow_record_writer->close();
   }
 
-  traffic_stats_tracker.generate_report();
-  if (!args.output_report.empty()) {
-    traffic_stats_tracker.dump_report_to_json_file(args.output_report);
+  {
+    PROFILE_SCOPE(ProfileStage::Report);
+
+    traffic_stats_tracker.generate_report();
+    if (!args.output_report.empty()) {
+      traffic_stats_tracker.dump_report_to_json_file(args.output_report);
+    }
+    if (!args.output_bin_report.empty()) {
+      traffic_stats_tracker.dump_report_to_bin_file(args.output_bin_report);
+    }
+  }
+
+  if (huge_pages.get_mode() != HugePageMode::Off) {
+    huge_pages.dump_to_stderr();
+  }
+
+  if (profiler.is_enabled()) {
+    profiler.dump_to_stderr();
+    if (!args.profile_output.empty()) {
+      profiler.dump_to_json_file(args.profile_output);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  args_t args;
+
+  CLI::App app{"Pcap stats"};
+  app.add_option("pcap", args.pcap_file, "Pcap file.")->required();
+  app.add_option("--out", args.output_report, "Output report JSON file.");
+  app.add_option("--out-bin", args.output_bin_report, "Output report in the binary columnar format (zstd compressed if it ends in .zst).");
+  app.add_option("--flows-out", args.output_flows, "Export per-flow records to a columnar file (zstd compressed if it ends in .zst).");
+  app.add_option("--epoch", args.epoch_duration, "Epoch duration in nanoseconds (default: 1s).");
+  app.add_option("--mbps", args.rate, "Replay rate in Mbps (optional).");
+  app.add_flag("--table-stats", args.table_stats, "Report hash table introspection stats per epoch and at the end.");
+  app.add_option("--filter", args.filter, "Only account packets matching this BPF expression (pcap-filter syntax).");
+  app.add_option("--metrics", args.metrics, "Comma separated metrics to compute (default: all), see src/metrics.h.");
+  app.add_option("--flow-tables", args.flow_tables,
+                 "Flow tables to simulate, as kind:entries:ways:replacement:hash:timeout_ms (implies the flow_tables metric).");
+  app.add_option("--rss-queues", args.rss_queues, "Comma separated queue counts to spread the flows over (implies the rss metric).")
+      ->delimiter(',');
+  app.add_option("--rss-key", args.rss_key, "RSS Toeplitz key, as 40 hex bytes (default: the Microsoft key, implies the rss metric).");
+  app.add_flag("--rss-symmetric", args.rss_symmetric, "Hash both directions of a connection to the same queue (implies the rss metric).");
+  app.add_option("--hhh-threshold", args.hhh_threshold,
+                 "Fraction of the packets making a heavy hitter prefix (default: 0.01, implies the hhh metric).");
+  app.add_option("--expected-flows", args.expected_flows, "Pre-size the flow tables for this many flows, so they never grow while ingesting.");
+  app.add_option("--readahead", args.readahead_mb, "Read the trace sequentially, keeping this many MB requested ahead of the cursor.");
+  app.add_flag("--drop-behind", args.drop_behind, "Drop the trace from the page cache as it is read, so it does not evict everything else.");
+  app.add_option("--huge-pages", args.huge_page_mode, "Back the big flow tables with huge pages: off, thp, 2m or 1g (default: off).");
+  app.add_option("--snapshot-report", args.snapshot_report, "Where to dump reports requested with SIGUSR1 (default: <--out>.snapshot).");
+  app.add_option("--checkpoint", args.checkpoint_file, "Periodically snapshot the tracker state to this file.");
+  app.add_option("--checkpoint-interval", args.checkpoint_interval, "Seconds (wall clock) between checkpoints (default: 600).");
+  app.add_flag("--resume", args.resume, "Resume from the --checkpoint file.");
+  app.add_option("--telemetry-interval", args.telemetry_interval_ms, "Wall clock ms between progress samples, 0 to disable (default: 1000).");
+  app.add_option("--telemetry-out", args.telemetry_output, "Also append progress samples to this file, as JSON lines.");
+  app.add_flag("--profile", args.profile, "Account cycles spent in each processing stage and print them at the end.");
+  app.add_option("--profile-out", args.profile_output, "Also dump the profile to this JSON file (implies --profile).");
+  app.add_flag("--hw-counters", args.hw_counters, "Add HW performance counters per stage to the profile (implies --profile).");
+
+  CLI11_PARSE(app, argc, argv);
+
+  if (!std::filesystem::exists(args.pcap_file)) {
+    fprintf(stderr, "File %s not found\n", args.pcap_file.c_str());
+    exit(1);
+  }
+
+  if (args.resume && args.checkpoint_file.empty()) {
+    fprintf(stderr, "--resume requires --checkpoint\n");
+    exit(1);
+  }
+
+  if (args.profile || !args.profile_output.empty() || args.hw_counters) {
+#ifndef PROFILING_ENABLED
+    fprintf(stderr, "Built without profiling support (ENABLE_PROFILING=OFF)\n");
+    exit(1);
+#endif
+    profiler.enable();
+    if (args.hw_counters) {
+      hw_counters.enable();
+    }
   }
 
+  std::optional<metrics_t> metrics = parse_metrics(args.metrics);
+  if (!metrics.has_value() || metrics.value() == 0) {
+    fprintf(stderr, "Invalid --metrics %s, expected a comma separated list of: all", args.metrics.c_str());
+    for (std::string_view name : METRIC_NAMES) {
+      fprintf(stderr, " %.*s", static_cast<int>(name.size()), name.data());
+    }
+    fprintf(stderr, "\n");
+    exit(1);
+  }
+
+  if (!args.flow_tables.empty()) {
+    metrics.value() |= metric_bit(Metric::FlowTables);
+  }
+
+  std::vector<flow_table_geometry_t> flow_tables;
+  if (has_metric(metrics.value(), Metric::FlowTables)) {
+    const std::optional<std::vector<flow_table_geometry_t>> geometries =
+        parse_flow_table_geometries(args.flow_tables.empty() ? DEFAULT_FLOW_TABLE_SPECS : args.flow_tables);
+    if (!geometries.has_value()) {
+      exit(1);
+    }
+    flow_tables = geometries.value();
+  }
+
+  if (!args.rss_queues.empty() || !args.rss_key.empty() || args.rss_symmetric) {
+    metrics.value() |= metric_bit(Metric::Rss);
+  }
+
+  rss_config_t rss = {.queue_counts = {}, .key = DEFAULT_RSS_KEY, .symmetric = args.rss_symmetric};
+  if (has_metric(metrics.value(), Metric::Rss)) {
+    rss.queue_counts = args.rss_queues.empty() ? DEFAULT_RSS_QUEUE_COUNTS : args.rss_queues;
+    for (u64 queues : rss.queue_counts) {
+      if (queues == 0 || queues > RSS_MAX_QUEUES) {
+        fprintf(stderr, "Invalid --rss-queues %lu, expected between 1 and %lu\n", queues, RSS_MAX_QUEUES);
+        exit(1);
+      }
+    }
+    if (!args.rss_key.empty()) {
+      const std::optional<rss_key_t> key = parse_rss_key(args.rss_key);
+      if (!key.has_value()) {
+        fprintf(stderr, "Invalid --rss-key %s, expected %lu hex bytes\n", args.rss_key.c_str(), RSS_KEY_SIZE);
+        exit(1);
+      }
+      rss.key = key.value();
+    }
+  }
+
+  if (args.hhh_threshold.has_value()) {
+    metrics.value() |= metric_bit(Metric::Hhh);
+    if (!(args.hhh_threshold.value() > 0 && args.hhh_threshold.value() <= 1)) {
+      fprintf(stderr, "Invalid --hhh-threshold %f, expected a fraction in (0, 1]\n", args.hhh_threshold.value());
+      exit(1);
+    }
+  }
+  const double hhh_threshold = has_metric(metrics.value(), Metric::Hhh) ? args.hhh_threshold.value_or(DEFAULT_HHH_THRESHOLD) : 0;
+
+  const std::optional<HugePageMode> huge_page_mode = parse_huge_page_mode(args.huge_page_mode);
+  if (!huge_page_mode.has_value()) {
+    fprintf(stderr, "Invalid --huge-pages %s, expected off, thp, 2m or 1g\n", args.huge_page_mode.c_str());
+    exit(1);
+  }
+  huge_pages.set_mode(huge_page_mode.value());
+
+  if (!args.output_flows.empty() && !has_metric(metrics.value(), Metric::Churn)) {
+    fprintf(stderr, "--flows-out requires the churn metric\n");
+    exit(1);
+  }
+
+  if (args.snapshot_report.empty() && !args.output_report.empty()) {
+    args.snapshot_report = args.output_report.string() + ".snapshot";
+  }
+
+  const checkpoint_params_t checkpoint_params = {
+      .pcap_file      = std::filesystem::canonical(args.pcap_file).string(),
+      .epoch_duration = args.epoch_duration,
+      .rate           = args.rate,
+      .metrics        = metrics.value(),
+      .filter         = args.filter,
+      .flow_tables    = flow_tables,
+      .rss            = rss,
+      .hhh_threshold  = hhh_threshold,
+  };
+
+  with_traffic_stats_tracker(metrics.value(), [&]<typename Tracker>(std::type_identity<Tracker>) {
+    if (metrics.value() != ALL_METRICS) {
+      fprintf(stderr, "Metrics: %s (computing %s)\n", format_metrics(metrics.value()).c_str(), format_metrics(Tracker::METRICS).c_str());
+    }
+    run<Tracker>(args, checkpoint_params);
+  });
+
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "types.h"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Groups of report fields that can be turned off with --metrics. Each one maps to a policy class of the tracker (see
+// traffic_stats_tracker.h), so a disabled metric has neither state nor per-packet work.
+//
+//   pkt_sizes    pkt_bytes_{avg,cdf,stdev}
+//   flows        total_flows
+//   symm_flows   total_symm_flows
+//   churn        epochs[].{expired,new}_flows, needed for --flows-out and the live flows of the telemetry
+//   concurrency  epochs[].concurrent_flows
+//   flow_sizes   pkts_per_flow_{avg,cdf,stdev} and top_k_flows{,_bytes}_cdf
+//   flow_times   flow_duration_us_{avg,cdf,stdev} and flow_dts_us_{avg,cdf,stdev}
+//
+// Packet, byte and TCP/UDP packet counts, and the start and end times, are always reported.
+//
+// The metrics after those are opt-in analyses, too costly to run by default: "all" leaves them out, so they have to be listed (e.g.
+// "all,flow_cache"). They are all instantiated together, and only the listed ones switched on at runtime: the others allocate nothing,
+// but still cost a branch per TCP/UDP packet and epoch each.
+//
+//   flow_cache   flow_cache.{accesses,cold_misses,capacities,miss_ratios}, the miss ratio curve of an LRU flow cache (see reuse_distance.h)
+//   flow_tables  flow_tables[], misses, insert failures, live evictions and occupancy of simulated hardware flow tables (see
+//                flow_table_sim.h), overall and per epoch
+//   rss          rss[], packets, bytes and flows per queue of the flow stream spread with RSS over several queue counts (see rss_sim.h),
+//                overall and per epoch, with their max/mean imbalance
+//   hhh          hhh.{src,dst,epochs,pkts,threshold}, hierarchical heavy hitter prefixes of the source and destination addresses (see
+//                heavy_hitters.h), overall and per epoch
+//   entropy      epochs[].{src,dst}_{ip,port}_entropy, estimated entropy of the addresses and ports per epoch (see entropy_sketch.h)
+
+enum class Metric : u8 {
+  PktSizes,
+  Flows,
+  SymmFlows,
+  Churn,
+  Concurrency,
+  FlowSizes,
+  FlowTimes,
+  FlowCache,
+  FlowTables,
+  Rss,
+  Hhh,
+  Entropy,
+  Count,
+};
+
+constexpr const std::array<std::string_view, static_cast<size_t>(Metric::Count)> METRIC_NAMES = {
+    "pkt_sizes", "flows", "symm_flows", "churn", "concurrency", "flow_sizes", "flow_times", "flow_cache", "flow_tables", "rss", "hhh",
+    "entropy",
+};
+
+// Bitmask of metrics.
+typedef u32 metrics_t;
+
+constexpr metrics_t metric_bit(Metric metric) { return 1u << static_cast<u32>(metric); }
+
+constexpr const Metric FIRST_OPT_IN_METRIC = Metric::FlowCache;
+
+// What "all" stands for, every metric but the opt-in ones.
+constexpr const metrics_t ALL_METRICS    = (1u << static_cast<u32>(FIRST_OPT_IN_METRIC)) - 1;
+constexpr const metrics_t OPT_IN_METRICS = ((1u << static_cast<u32>(Metric::Count)) - 1) & ~ALL_METRICS;
+
+constexpr bool has_metric(metrics_t metrics, Metric metric) { return metrics & metric_bit(metric); }
+
+// From a comma separated list of names, "all" among them.
+inline std::optional<metrics_t> parse_metrics(std::string_view list) {
+  metrics_t metrics = 0;
+  while (!list.empty()) {
+    const size_t comma          = list.find(',');
+    const std::string_view name = list.substr(0, comma);
+
+    bool found = name == "all";
+    if (found) {
+      metrics |= ALL_METRICS;
+    }
+    for (size_t i = 0; i < METRIC_NAMES.size(); i++) {
+      if (METRIC_NAMES[i] == name) {
+        metrics |= metric_bit(static_cast<Metric>(i));
+        found = true;
+      }
+    }
+    if (!found) {
+      return std::nullopt;
+    }
+
+    list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+  }
+
+  return metrics;
+}
+
+inline std::string format_metrics(metrics_t metrics) {
+  const bool all = (metrics & ALL_METRICS) == ALL_METRICS;
+
+  std::string list = all ? "all" : "";
+  for (size_t i = 0; i < METRIC_NAMES.size(); i++) {
+    if (has_metric(metrics, static_cast<Metric>(i)) && !(all && has_metric(ALL_METRICS, static_cast<Metric>(i)))) {
+      list += (list.empty() ? "" : ",") + std::string(METRIC_NAMES[i]);
+    }
+  }
+  return list;
+}
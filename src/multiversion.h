@@ -0,0 +1,12 @@
+#pragma once
+
+// Hot per-packet entry points, built with ENABLE_MULTIVERSIONING, are compiled once for the baseline ISA and once per target in
+// MULTIVERSIONING_TARGETS (e.g. "arch=x86-64-v3"), everything they inline included. The dynamic loader picks the best one the CPU
+// supports, so a single binary still runs everywhere.
+//
+// Only put it on out of line definitions, not on their declarations in headers: GCC 12 then loses the clones when linking with LTO.
+#ifdef MULTIVERSIONING_ENABLED
+#define HOT_KERNEL __attribute__((target_clones("default," MULTIVERSIONING_TARGETS)))
+#else
+#define HOT_KERNEL
+#endif
@@ -46,6 +46,15 @@ struct ipv4_hdr_t {
   u32 dst_addr;
 } __attribute__((__packed__));
 
+struct ipv6_hdr_t {
+  u32 vtc_flow;
+  u16 payload_len;
+  u8 proto;
+  u8 hop_limits;
+  u8 src_addr[16];
+  u8 dst_addr[16];
+} __attribute__((__packed__));
+
 struct udp_hdr_t {
   u16 src_port;
   u16 dst_port;
@@ -90,6 +99,13 @@ inline u32 ipv4_set_prefix(u32 addr, u8 prefix, bits_t prefix_size) {
   return bswap32((prefix_masked << (32 - prefix_size)) | (swapped_addr >> prefix_size));
 }
 
+// The network of addr with a prefix_size bits mask (e.g. 10.1.2.3 and 8 give 10.0.0.0).
+inline u32 ipv4_mask_prefix(u32 addr, bits_t prefix_size) {
+  assert(prefix_size <= 32);
+  const u32 mask = prefix_size == 0 ? 0 : ~0u << (32 - prefix_size);
+  return bswap32(bswap32(addr) & mask);
+}
+
 enum class FlowType {
   FiveTuple = 0,
 };
@@ -215,6 +231,8 @@ struct sflow_t {
 
   sflow_t(const sflow_t &sflow) : src_ip(sflow.src_ip), dst_ip(sflow.dst_ip), src_port(sflow.src_port), dst_port(sflow.dst_port) {}
 
+  sflow_t &operator=(const sflow_t &) = default;
+
   sflow_t(u32 _src_ip, u32 _dst_ip, u16 _src_port, u16 _dst_port) : src_ip(_src_ip), dst_ip(_dst_ip), src_port(_src_port), dst_port(_dst_port) {}
 
   bool operator==(const sflow_t &other) const {
@@ -0,0 +1,169 @@
+#include "packet_filter.h"
+#include "system.h"
+
+#include <arpa/inet.h>
+#include <charconv>
+#include <sstream>
+
+// Large enough for any record, the filter only ever looks at the captured bytes.
+constexpr const int FILTER_SNAPLEN = 262144;
+
+namespace {
+
+std::optional<u32> parse_ipv4(const std::string &str) {
+  in_addr addr;
+  if (inet_pton(AF_INET, str.c_str(), &addr) != 1) {
+    return std::nullopt;
+  }
+  return addr.s_addr;
+}
+
+// Decimal only: libpcap reads a leading 0 as octal and 0x as hex, so those are left to it.
+std::optional<u32> parse_u32(const std::string &str, u32 max) {
+  if (str.size() > 1 && str[0] == '0') {
+    return std::nullopt;
+  }
+
+  u32 value;
+  const auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (error != std::errc() || end != str.data() + str.size() || value > max) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// A single primitive, starting at tokens[i]. Returns false if it is not one the fast path understands.
+bool parse_primitive(const std::vector<std::string> &tokens, size_t &i, std::vector<filter_term_t> &terms) {
+  if (tokens[i] == "ip") {
+    // Every packet the fast path sees is IPv4.
+    i++;
+    return true;
+  }
+
+  if (tokens[i] == "tcp" || tokens[i] == "udp") {
+    terms.push_back({
+        .field = FilterField::Proto,
+        .value = tokens[i] == "tcp" ? static_cast<u32>(IPPROTO_TCP) : static_cast<u32>(IPPROTO_UDP),
+        .mask  = 0,
+    });
+    i++;
+    return true;
+  }
+
+  enum class Direction { Src, Dst, Any } direction = Direction::Any;
+  if (tokens[i] == "src" || tokens[i] == "dst") {
+    direction = tokens[i] == "src" ? Direction::Src : Direction::Dst;
+    i++;
+  }
+
+  if (i + 1 >= tokens.size()) {
+    return false;
+  }
+
+  const std::string &kind  = tokens[i];
+  const std::string &value = tokens[i + 1];
+  i += 2;
+
+  if (kind == "port") {
+    const std::optional<u32> port = parse_u32(value, UINT16_MAX);
+    if (!port.has_value()) {
+      return false;
+    }
+
+    const FilterField fields[] = {FilterField::SrcPort, FilterField::DstPort, FilterField::AnyPort};
+    terms.push_back({
+        .field = fields[static_cast<int>(direction)],
+        .value = htons(port.value()),
+        .mask  = 0,
+    });
+    return true;
+  }
+
+  std::optional<u32> addr;
+  u32 prefix_len = 32;
+
+  if (kind == "host") {
+    addr = parse_ipv4(value);
+  } else if (kind == "net") {
+    const size_t slash = value.find('/');
+    if (slash == std::string::npos) {
+      return false;
+    }
+    addr                                 = parse_ipv4(value.substr(0, slash));
+    const std::optional<u32> parsed_len = parse_u32(value.substr(slash + 1), 32);
+    if (!parsed_len.has_value()) {
+      return false;
+    }
+    prefix_len = parsed_len.value();
+  } else {
+    return false;
+  }
+
+  if (!addr.has_value()) {
+    return false;
+  }
+
+  const u32 mask             = prefix_len == 0 ? 0 : htonl(~0u << (32 - prefix_len));
+  const FilterField fields[] = {FilterField::SrcIp, FilterField::DstIp, FilterField::AnyIp};
+  terms.push_back({
+      .field = fields[static_cast<int>(direction)],
+      .value = addr.value() & mask,
+      .mask  = mask,
+  });
+  return true;
+}
+
+} // namespace
+
+std::optional<std::vector<filter_term_t>> parse_fast_filter(const std::string &expression) {
+  std::vector<std::string> tokens;
+  std::istringstream stream(expression);
+  for (std::string token; stream >> token;) {
+    tokens.push_back(token);
+  }
+
+  if (tokens.empty()) {
+    return std::nullopt;
+  }
+
+  std::vector<filter_term_t> terms;
+  size_t i = 0;
+  while (true) {
+    if (!parse_primitive(tokens, i, terms)) {
+      return std::nullopt;
+    }
+
+    if (i == tokens.size()) {
+      return terms;
+    }
+
+    if (tokens[i] != "and" && tokens[i] != "&&") {
+      return std::nullopt;
+    }
+
+    if (++i == tokens.size()) {
+      return std::nullopt;
+    }
+  }
+}
+
+PacketFilter::PacketFilter(const std::string &expression, int linktype, bool _fast_path) {
+  pcap_t *pd = pcap_open_dead(linktype, FILTER_SNAPLEN);
+  if (!pd) {
+    panic("Failed to set up a pcap handle for the filter");
+  }
+
+  if (pcap_compile(pd, &program, expression.c_str(), 1, PCAP_NETMASK_UNKNOWN) != 0) {
+    fprintf(stderr, "Invalid filter \"%s\": %s\n", expression.c_str(), pcap_geterr(pd));
+    pcap_close(pd);
+    exit(1);
+  }
+
+  pcap_close(pd);
+
+  if (_fast_path) {
+    fast_path = parse_fast_filter(expression);
+  }
+}
+
+PacketFilter::~PacketFilter() { pcap_freecode(&program); }
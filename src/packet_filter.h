@@ -0,0 +1,85 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+
+#include <optional>
+#include <pcap.h>
+#include <string>
+#include <vector>
+
+// A --filter expression, applied by the reader so that filtered out packets never reach the tracker.
+//
+// The expression is always compiled to BPF (pcap_compile), which defines its semantics. Conjunctions of simple 5-tuple predicates (tcp,
+// udp, ip, [src|dst] host, [src|dst] net, [src|dst] port) are also evaluated directly on the parsed flow key, skipping the BPF
+// interpreter. That is only exact on untagged IPv4 TCP/UDP packets without IP options nor fragmentation, every other packet still goes
+// through BPF.
+
+enum class FilterField : u8 {
+  Proto,
+  SrcIp,
+  DstIp,
+  AnyIp,
+  SrcPort,
+  DstPort,
+  AnyPort,
+};
+
+// Addresses and ports in network byte order, as in flow_t.
+struct filter_term_t {
+  FilterField field;
+  u32 value;
+  u32 mask;
+};
+
+class PacketFilter {
+private:
+  bpf_program program;
+  std::optional<std::vector<filter_term_t>> fast_path;
+
+public:
+  // Panics if the expression does not compile. Without fast_path every packet goes through BPF.
+  PacketFilter(const std::string &expression, int linktype, bool fast_path = true);
+  ~PacketFilter();
+
+  PacketFilter(const PacketFilter &)            = delete;
+  PacketFilter &operator=(const PacketFilter &) = delete;
+
+  bool has_fast_path() const { return fast_path.has_value(); }
+
+  // Only for packets the fast path is exact on.
+  bool matches_flow(u8 proto, const flow_t &flow) const {
+    for (const filter_term_t &term : fast_path.value()) {
+      if (!matches_term(term, proto, flow)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool matches_record(const pcap_pkthdr *header, const u8 *data) const { return pcap_offline_filter(&program, header, data) != 0; }
+
+private:
+  static bool matches_term(const filter_term_t &term, u8 proto, const flow_t &flow) {
+    switch (term.field) {
+    case FilterField::Proto:
+      return proto == term.value;
+    case FilterField::SrcIp:
+      return (flow.five_tuple.src_ip & term.mask) == term.value;
+    case FilterField::DstIp:
+      return (flow.five_tuple.dst_ip & term.mask) == term.value;
+    case FilterField::AnyIp:
+      return (flow.five_tuple.src_ip & term.mask) == term.value || (flow.five_tuple.dst_ip & term.mask) == term.value;
+    case FilterField::SrcPort:
+      return flow.five_tuple.src_port == term.value;
+    case FilterField::DstPort:
+      return flow.five_tuple.dst_port == term.value;
+    case FilterField::AnyPort:
+      return flow.five_tuple.src_port == term.value || flow.five_tuple.dst_port == term.value;
+    }
+    return false;
+  }
+};
+
+// The fast path terms of an expression, if it has one.
+std::optional<std::vector<filter_term_t>> parse_fast_filter(const std::string &expression);
@@ -5,13 +5,30 @@
 #include "pcap_reader.h"
 #include "types.h"
 #include "system.h"
-
+#include "profiler.h"
+#include "hw_counters.h"
+#include "probes.h"
+#include "alloc_tracker.h"
+#include "multiversion.h"
+
+#include <algorithm>
+#include <deque>
 #include <vector>
 #include <fstream>
+#include <fcntl.h>
 #include <string.h>
 
 #include <zstd.h>
 
+constexpr const u64 PCAP_GLOBAL_HEADER_SIZE = 24;
+constexpr const u64 PCAP_RECORD_HEADER_SIZE = 16;
+
+// Input bytes between two applications of the page cache policy.
+constexpr const u64 PAGE_CACHE_UPDATE_STEP = 8 << 20;
+
+// Pages this close behind the read cursor are kept, as stdio and the zstd stream may still be reading from them.
+constexpr const u64 PAGE_CACHE_DROP_MARGIN = 4 << 20;
+
 namespace {
 
 std::vector<u8> get_file_signature(const std::string &filepath, size_t bytesToRead = 4) {
@@ -29,6 +46,15 @@ std::vector<u8> get_file_signature(const std::string &filepath, size_t bytesToRe
   return buffer;
 }
 
+} // namespace
+
+struct zstd_frame_checkpoint_t {
+  u64 raw_offset;
+  u64 offset;
+};
+
+constexpr const size_t ZSTD_FRAME_CHECKPOINTS = 16;
+
 struct ZstdContext {
   FILE *raw_file;
   ZSTD_DStream *dctx;
@@ -45,7 +71,14 @@ struct ZstdContext {
 
   bool eof_reached;
 
-  ZstdContext(const char *filename) : in_pos(0), in_len(0), out_pos(0), out_len(0), eof_reached(false) {
+  // Compressed bytes fed to the decompressor, and decompressed bytes handed to libpcap.
+  u64 raw_offset;
+  u64 offset;
+
+  // Most recent frame boundaries, used to seek without decompressing the whole stream again.
+  std::deque<zstd_frame_checkpoint_t> frames;
+
+  ZstdContext(const char *filename) : in_pos(0), in_len(0), out_pos(0), out_len(0), eof_reached(false), raw_offset(0), offset(0) {
     raw_file = fopen(filename, "rb");
     if (!raw_file) {
       perror("fopen");
@@ -65,8 +98,41 @@ struct ZstdContext {
     }
     ZSTD_freeDStream(dctx);
   }
+
+  void add_frame_checkpoint(u64 frame_raw_offset, u64 frame_offset) {
+    frames.push_back({frame_raw_offset, frame_offset});
+    if (frames.size() > ZSTD_FRAME_CHECKPOINTS) {
+      frames.pop_front();
+    }
+  }
+
+  zstd_frame_checkpoint_t get_frame_checkpoint(u64 target) const {
+    for (auto it = frames.rbegin(); it != frames.rend(); it++) {
+      if (it->offset <= target) {
+        return *it;
+      }
+    }
+    return {0, 0};
+  }
+
+  void restart_at(const zstd_frame_checkpoint_t &frame) {
+    if (fseek(raw_file, frame.raw_offset, SEEK_SET) != 0) {
+      panic("Failed to seek zstd trace: %s", strerror(errno));
+    }
+
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+    in_pos      = 0;
+    in_len      = 0;
+    out_pos     = 0;
+    out_len     = 0;
+    eof_reached = false;
+    raw_offset  = frame.raw_offset;
+    offset      = frame.offset;
+  }
 };
 
+namespace {
+
 // Libpcap calls this thinking it's reading a normal file.
 // We intercept it and feed it decompressed data.
 ssize_t zstd_read_fn(void *cookie, char *buf, size_t size) {
@@ -83,6 +149,7 @@ ssize_t zstd_read_fn(void *cookie, char *buf, size_t size) {
       memcpy(buf + total_copied, ctx->out_buff.data() + ctx->out_pos, to_copy);
 
       ctx->out_pos += to_copy;
+      ctx->offset += to_copy;
       total_copied += to_copy;
 
       if (total_copied == size) {
@@ -122,6 +189,7 @@ ssize_t zstd_read_fn(void *cookie, char *buf, size_t size) {
         }
         ctx->in_len = read;
         ctx->in_pos = 0;
+        PROBE_READER_REFILL(ctx->raw_offset, read);
       }
 
       ZSTD_inBuffer input = {ctx->in_buff.data(), ctx->in_len, ctx->in_pos};
@@ -129,12 +197,18 @@ ssize_t zstd_read_fn(void *cookie, char *buf, size_t size) {
       // The actual decompression
       const size_t ret = ZSTD_decompressStream(ctx->dctx, &output, &input);
 
+      ctx->raw_offset += input.pos - ctx->in_pos;
       ctx->in_pos = input.pos;
 
       if (ZSTD_isError(ret)) {
         panic("Decompression failed: %s", ZSTD_getErrorName(ret));
       }
 
+      if (ret == 0) {
+        // A frame was fully decoded and flushed, so the next one starts right here.
+        ctx->add_frame_checkpoint(ctx->raw_offset, ctx->offset + output.pos);
+      }
+
       // If frame is over (ret==0), we might need to loop again to get next frame
       // But usually we just return what we have.
       if (output.pos > 0) {
@@ -148,6 +222,41 @@ ssize_t zstd_read_fn(void *cookie, char *buf, size_t size) {
   return total_copied;
 }
 
+// Seeks restart from the closest known frame boundary before the target whenever that is backwards or past the current offset (e.g. the
+// one a checkpoint saved), and decompress and discard from there.
+int zstd_seek_fn(void *cookie, off64_t *position, int whence) {
+  ZstdContext *ctx = static_cast<ZstdContext *>(cookie);
+
+  u64 target;
+  switch (whence) {
+  case SEEK_SET:
+    target = *position;
+    break;
+  case SEEK_CUR:
+    target = ctx->offset + *position;
+    break;
+  default:
+    // The decompressed size is unknown.
+    return -1;
+  }
+
+  const zstd_frame_checkpoint_t frame = ctx->get_frame_checkpoint(target);
+  if (target < ctx->offset || frame.offset > ctx->offset) {
+    ctx->restart_at(frame);
+  }
+
+  std::vector<char> discard(ZSTD_DStreamOutSize());
+  while (ctx->offset < target) {
+    const size_t chunk = std::min<u64>(discard.size(), target - ctx->offset);
+    if (zstd_read_fn(cookie, discard.data(), chunk) <= 0) {
+      return -1;
+    }
+  }
+
+  *position = ctx->offset;
+  return 0;
+}
+
 int zstd_close_fn(void *cookie) {
   ZstdContext *ctx = static_cast<ZstdContext *>(cookie);
   delete ctx; // Clean up our context
@@ -156,7 +265,9 @@ int zstd_close_fn(void *cookie) {
 
 } // namespace
 
-pcap_reader_t::pcap_reader_t(const std::filesystem::path &file) : pd(nullptr), assume_ip(false), pcap_start(0), total_pkts(0), start(0), end(0) {
+pcap_reader_t::pcap_reader_t(const std::filesystem::path &file)
+    : pd(nullptr), assume_ip(false), pcap_start(0), total_pkts(0), start(0), end(0), offset(PCAP_GLOBAL_HEADER_SIZE), zstd(nullptr),
+      filtered_pkts(0), next_page_cache_update(UINT64_MAX), readahead_end(0), dropped_end(0) {
   const std::vector<u8> signature = get_file_signature(file.string());
 
   static const std::vector<u8> zst_sig     = {0x28, 0xB5, 0x2F, 0xFD};
@@ -168,11 +279,12 @@ pcap_reader_t::pcap_reader_t(const std::filesystem::path &file) : pd(nullptr), a
 
   if (signature == zst_sig) {
     ZstdContext *ctx = new ZstdContext(file.c_str());
+    zstd             = ctx;
 
     cookie_io_functions_t funcs = {
         .read  = zstd_read_fn,
         .write = NULL, // Libpcap only reads
-        .seek  = NULL, // Streaming zstd is not seekable
+        .seek  = zstd_seek_fn,
         .close = zstd_close_fn,
     };
 
@@ -220,18 +332,37 @@ pcap_reader_t::pcap_reader_t(const std::filesystem::path &file) : pd(nullptr), a
   }
 }
 
-bool pcap_reader_t::read_next_packet(packet_t &read_data) {
-  const u8 *data;
-  struct pcap_pkthdr *header;
-
-  if (pcap_next_ex(pd, &header, &data) != 1) {
-    return false;
+pcap_reader_t::~pcap_reader_t() {
+  if (pd) {
+    // Also closes the underlying stream, and with it the zstd context.
+    pcap_close(pd);
   }
+}
+
+namespace {
+
+// What the filter fast path needs besides the flow key.
+struct parsed_hdrs_t {
+  u8 proto;
+
+  // Untagged IPv4 without options nor fragmentation, with the whole L4 header captured: the flow key then says all BPF would.
+  bool simple;
+};
+
+__attribute__((always_inline)) inline parsed_hdrs_t parse_packet(const pcap_pkthdr *header, const u8 *data, bool assume_ip,
+                                                                  packet_t &read_data) {
+  parsed_hdrs_t parsed = {
+      .proto  = 0,
+      .simple = false,
+  };
 
   read_data.pkt       = data;
   read_data.hdrs_len  = 0;
   read_data.total_len = header->len + CRC_SIZE_BYTES;
   read_data.ts        = header->ts.tv_sec * 1'000'000'000 + header->ts.tv_usec * 1'000;
+  read_data.flow.reset();
+
+  bool vlan = false;
 
   if (assume_ip) {
     read_data.total_len += sizeof(ether_hdr_t);
@@ -254,11 +385,12 @@ bool pcap_reader_t::read_next_packet(packet_t &read_data) {
       ether_type = ntohs(reinterpret_cast<const u16 *>(data)[0]);
       data += sizeof(u16);
       read_data.hdrs_len += sizeof(vlan_hdr_t) + sizeof(u16);
+      vlan = true;
     }
 
     if (ether_type != ETHERTYPE_IP) {
       read_data.hdrs_len = read_data.total_len;
-      return true;
+      return parsed;
     }
   }
 
@@ -267,7 +399,7 @@ bool pcap_reader_t::read_next_packet(packet_t &read_data) {
   read_data.hdrs_len += sizeof(ipv4_hdr_t);
 
   if (ip_hdr->version != 4) {
-    return true;
+    return parsed;
   }
 
   u16 sport = 0;
@@ -291,7 +423,7 @@ bool pcap_reader_t::read_next_packet(packet_t &read_data) {
     dport = udp_hdr->dst_port;
   } break;
   default: {
-    return true;
+    return parsed;
   }
   }
 
@@ -302,5 +434,131 @@ bool pcap_reader_t::read_next_packet(packet_t &read_data) {
   read_data.flow->five_tuple.src_port = sport;
   read_data.flow->five_tuple.dst_port = dport;
 
-  return true;
-}
\ No newline at end of file
+  parsed.proto  = ip_hdr->next_proto_id;
+  parsed.simple = !vlan && ip_hdr->ihl == sizeof(ipv4_hdr_t) / 4 && (ntohs(ip_hdr->fragment_offset) & 0x1fff) == 0 &&
+                  header->caplen >= read_data.hdrs_len;
+
+  return parsed;
+}
+
+} // namespace
+
+void pcap_reader_t::set_filter(const std::string &expression, bool fast_path) {
+  filter = std::make_unique<PacketFilter>(expression, pcap_datalink(pd), fast_path);
+}
+
+void pcap_reader_t::set_page_cache_policy(const page_cache_policy_t &policy) {
+  page_cache_policy = policy;
+
+  if (policy.readahead_bytes > 0) {
+    const int fd = fileno(zstd ? zstd->raw_file : pcap_file(pd));
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  next_page_cache_update = 0;
+  update_page_cache();
+}
+
+// Requests the next readahead window (POSIX_FADV_WILLNEED) once half of the previous one was consumed, and drops what is behind the cursor
+// (POSIX_FADV_DONTNEED). Both only act on the page cache, errors are ignored.
+void pcap_reader_t::update_page_cache() {
+  const page_cache_policy_t &policy = page_cache_policy.value();
+  const int fd                      = fileno(zstd ? zstd->raw_file : pcap_file(pd));
+  const u64 cursor                  = get_input_bytes();
+
+  if (policy.readahead_bytes > 0 && cursor + policy.readahead_bytes / 2 >= readahead_end) {
+    const u64 window_start = std::max(cursor, readahead_end);
+    readahead_end          = cursor + policy.readahead_bytes;
+    posix_fadvise(fd, window_start, readahead_end - window_start, POSIX_FADV_WILLNEED);
+  }
+
+  if (policy.drop_behind && cursor > dropped_end + PAGE_CACHE_DROP_MARGIN) {
+    const u64 drop_end = cursor - PAGE_CACHE_DROP_MARGIN;
+    posix_fadvise(fd, dropped_end, drop_end - dropped_end, POSIX_FADV_DONTNEED);
+    dropped_end = drop_end;
+  }
+
+  const u64 step          = policy.readahead_bytes > 0 ? std::min(PAGE_CACHE_UPDATE_STEP, policy.readahead_bytes / 4) : PAGE_CACHE_UPDATE_STEP;
+  next_page_cache_update = cursor + std::max<u64>(step, 1);
+}
+
+HOT_KERNEL bool pcap_reader_t::read_next_packet(packet_t &read_data) {
+  ALLOC_TRACKING_SCOPE();
+  const u8 *data;
+  struct pcap_pkthdr *header;
+
+  if (get_input_bytes() >= next_page_cache_update) {
+    update_page_cache();
+  }
+
+  while (true) {
+    {
+      PROFILE_SCOPE(ProfileStage::Read);
+      PROFILE_HW_SCOPE(HwCounterStage::Reader);
+      if (pcap_next_ex(pd, &header, &data) != 1) {
+        return false;
+      }
+    }
+
+    offset += PCAP_RECORD_HEADER_SIZE + header->caplen;
+
+    parsed_hdrs_t parsed;
+    {
+      PROFILE_SCOPE(ProfileStage::Parse);
+      PROFILE_HW_SCOPE(HwCounterStage::Parser);
+      parsed = parse_packet(header, data, assume_ip, read_data);
+    }
+
+    if (!filter) {
+      return true;
+    }
+
+    PROFILE_SCOPE(ProfileStage::Filter);
+    PROFILE_HW_SCOPE(HwCounterStage::Parser);
+
+    const bool matches = parsed.simple && filter->has_fast_path() ? filter->matches_flow(parsed.proto, read_data.flow.value())
+                                                                  : filter->matches_record(header, data);
+    if (matches) {
+      return true;
+    }
+
+    filtered_pkts++;
+  }
+}
+
+u64 pcap_reader_t::get_input_bytes() const { return zstd ? zstd->raw_offset : offset; }
+
+pcap_reader_position_t pcap_reader_t::get_position() const {
+  pcap_reader_position_t position = {
+      .offset           = offset,
+      .frame_raw_offset = 0,
+      .frame_offset     = 0,
+  };
+
+  if (zstd) {
+    const zstd_frame_checkpoint_t frame = zstd->get_frame_checkpoint(offset);
+    position.frame_raw_offset           = frame.raw_offset;
+    position.frame_offset               = frame.offset;
+  }
+
+  return position;
+}
+
+void pcap_reader_t::seek(const pcap_reader_position_t &position) {
+  if (zstd) {
+    zstd->add_frame_checkpoint(position.frame_raw_offset, position.frame_offset);
+  }
+
+  // libpcap reads records straight from the FILE, so repositioning it underneath is enough.
+  if (fseek(pcap_file(pd), position.offset, SEEK_SET) != 0) {
+    panic("Failed to seek pcap to offset %lu", position.offset);
+  }
+
+  offset = position.offset;
+
+  if (page_cache_policy.has_value()) {
+    readahead_end          = 0;
+    dropped_end            = 0;
+    next_page_cache_update = 0;
+  }
+}
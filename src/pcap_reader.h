@@ -2,11 +2,35 @@
 
 #include "types.h"
 #include "net.h"
+#include "packet_filter.h"
 
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <pcap.h>
 
+struct ZstdContext;
+
+// Where the reader is within the trace, enough to resume reading from the same packet.
+struct pcap_reader_position_t {
+  // Offset of the next packet record within the (decompressed) pcap stream.
+  u64 offset;
+
+  // Zstd traces only: compressed and decompressed offsets of the last frame starting at or before the packet, so that resuming only needs to
+  // decompress from there.
+  u64 frame_raw_offset;
+  u64 frame_offset;
+};
+
+// How the trace should use the page cache, which by default keeps everything read and only reads ahead as much as the kernel guesses.
+struct page_cache_policy_t {
+  // Marks the file as read sequentially and keeps that many bytes ahead of the read cursor requested (0 leaves readahead alone).
+  u64 readahead_bytes;
+
+  // Drops the pages behind the read cursor from the cache, so scanning a huge trace does not evict everything else.
+  bool drop_behind;
+};
+
 struct pcap_reader_t {
   pcap_t *pd;
   bool assume_ip;
@@ -15,7 +39,38 @@ struct pcap_reader_t {
   time_ns_t start;
   time_ns_t end;
 
+  u64 offset;
+  ZstdContext *zstd;
+
+  // Records dropped by the filter, which read_next_packet skips over.
+  std::unique_ptr<PacketFilter> filter;
+  u64 filtered_pkts;
+
+  // Input bytes (see get_input_bytes) at which the page cache policy is next applied, never without one.
+  std::optional<page_cache_policy_t> page_cache_policy;
+  u64 next_page_cache_update;
+  u64 readahead_end;
+  u64 dropped_end;
+
   pcap_reader_t(const std::filesystem::path &file);
+  ~pcap_reader_t();
+
+  pcap_reader_t(const pcap_reader_t &)            = delete;
+  pcap_reader_t &operator=(const pcap_reader_t &) = delete;
+
+  // Only packets matching the BPF expression are returned from then on (see PacketFilter).
+  void set_filter(const std::string &expression, bool fast_path = true);
+
+  void set_page_cache_policy(const page_cache_policy_t &policy);
 
   bool read_next_packet(packet_t &read_data);
+
+  // Bytes of the trace file consumed so far (compressed bytes, for zstd traces).
+  u64 get_input_bytes() const;
+
+  pcap_reader_position_t get_position() const;
+  void seek(const pcap_reader_position_t &position);
+
+private:
+  void update_page_cache();
 };
\ No newline at end of file
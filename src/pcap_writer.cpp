@@ -0,0 +1,89 @@
+#include "pcap_writer.h"
+#include "system.h"
+
+#include <cstring>
+
+constexpr const size_t PCAP_WRITER_BUFFER_SIZE = 4 << 20;
+
+PcapWriter::PcapWriter(const std::filesystem::path &file, u32 snaplen, int zstd_level)
+    : out(nullptr), cctx(nullptr), buffer(PCAP_WRITER_BUFFER_SIZE), buffered(0), written(0) {
+  out = fopen(file.c_str(), "wb");
+  if (!out) {
+    perror("fopen");
+    panic("Failed to open %s for writing", file.c_str());
+  }
+
+  if (file.extension() == ".zst") {
+    cctx = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, zstd_level);
+    zstd_out_buff.resize(ZSTD_CStreamOutSize());
+  }
+
+  const pcap_global_header_t header = {
+      .magic         = PCAP_MAGIC,
+      .version_major = PCAP_VERSION_MAJOR,
+      .version_minor = PCAP_VERSION_MINOR,
+      .thiszone      = 0,
+      .sigfigs       = 0,
+      .snaplen       = snaplen,
+      .linktype      = PCAP_LINKTYPE_EN10MB,
+  };
+  append(&header, sizeof(header));
+}
+
+PcapWriter::~PcapWriter() { close(); }
+
+void PcapWriter::close() {
+  if (!out) {
+    return;
+  }
+
+  flush();
+
+  if (cctx) {
+    compress(nullptr, 0, ZSTD_e_end);
+    ZSTD_freeCCtx(cctx);
+    cctx = nullptr;
+  }
+
+  if (fclose(out) != 0) {
+    panic("Failed to close pcap file: %s", strerror(errno));
+  }
+  out = nullptr;
+}
+
+void PcapWriter::flush() {
+  if (buffered == 0) {
+    return;
+  }
+
+  if (cctx) {
+    compress(buffer.data(), buffered, ZSTD_e_continue);
+  } else if (fwrite(buffer.data(), 1, buffered, out) != buffered) {
+    panic("Failed to write pcap file: %s", strerror(errno));
+  }
+
+  written += buffered;
+  buffered = 0;
+}
+
+void PcapWriter::compress(const void *data, size_t size, ZSTD_EndDirective mode) {
+  ZSTD_inBuffer input = {data, size, 0};
+
+  bool finished = false;
+  while (!finished) {
+    ZSTD_outBuffer output = {zstd_out_buff.data(), zstd_out_buff.size(), 0};
+
+    const size_t remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+    if (ZSTD_isError(remaining)) {
+      panic("Compression failed: %s", ZSTD_getErrorName(remaining));
+    }
+
+    if (fwrite(zstd_out_buff.data(), 1, output.pos, out) != output.pos) {
+      panic("Failed to write pcap file: %s", strerror(errno));
+    }
+
+    // When ending the frame we must wait for zstd to fully flush, otherwise it is enough to consume all the input.
+    finished = (mode == ZSTD_e_end) ? (remaining == 0) : (input.pos == input.size);
+  }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include <zstd.h>
+
+// On-disk pcap headers, microsecond timestamps variant.
+constexpr const u32 PCAP_MAGIC           = 0xa1b2c3d4;
+constexpr const u16 PCAP_VERSION_MAJOR   = 2;
+constexpr const u16 PCAP_VERSION_MINOR   = 4;
+constexpr const u32 PCAP_LINKTYPE_EN10MB = 1;
+
+struct pcap_global_header_t {
+  u32 magic;
+  u16 version_major;
+  u16 version_minor;
+  i32 thiszone;
+  u32 sigfigs;
+  u32 snaplen;
+  u32 linktype;
+};
+
+struct pcap_record_header_t {
+  u32 ts_sec;
+  u32 ts_usec;
+  u32 caplen;
+  u32 len;
+};
+
+// Writes Ethernet pcap files, wrapping them in a zstd frame if the file name ends in ".zst" (which is what pcap_reader_t expects).
+//
+// Records are staged in a large buffer and only handed to stdio/zstd when it fills up, as generators push tens of millions of small records.
+class PcapWriter {
+private:
+  FILE *out;
+  ZSTD_CCtx *cctx;
+  std::vector<u8> buffer;
+  std::vector<u8> zstd_out_buff;
+  size_t buffered;
+  u64 written;
+
+public:
+  PcapWriter(const std::filesystem::path &file, u32 snaplen, int zstd_level = ZSTD_CLEVEL_DEFAULT);
+  ~PcapWriter();
+
+  PcapWriter(const PcapWriter &)            = delete;
+  PcapWriter &operator=(const PcapWriter &) = delete;
+
+  // Data holds the caplen captured bytes of a packet that was len bytes long on the wire (without CRC).
+  void write(time_ns_t ts, const u8 *data, bytes_t caplen, bytes_t len) {
+    const pcap_record_header_t header = {
+        .ts_sec  = static_cast<u32>(ts / BILLION),
+        .ts_usec = static_cast<u32>((ts % BILLION) / THOUSAND),
+        .caplen  = caplen,
+        .len     = len,
+    };
+    append(&header, sizeof(header));
+    append(data, caplen);
+  }
+
+  // Uncompressed pcap bytes written so far.
+  u64 get_written() const { return written + buffered; }
+
+  // Flushes everything and closes the zstd frame. Called by the destructor if not done explicitly.
+  void close();
+
+private:
+  void append(const void *data, size_t size) {
+    if (buffered + size > buffer.size()) {
+      flush();
+    }
+    memcpy(buffer.data() + buffered, data, size);
+    buffered += size;
+  }
+
+  void flush();
+  void compress(const void *data, size_t size, ZSTD_EndDirective mode);
+};
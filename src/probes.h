@@ -0,0 +1,50 @@
+#pragma once
+
+// USDT probes, under the "pcap_stats" provider. Each one is a single nop in the binary (plus its arguments already being in registers)
+// until a tracer attaches to it, e.g.:
+//
+//   bpftrace -e 'usdt:./pcap-stats:pcap_stats:flow_expire { @[arg3] = count(); }'
+//
+// Probe arguments:
+//   packet_ingest  (ts_ns, total_len, is_tcpudp)
+//   flow_create    (ts_ns, src_ip, dst_ip, src_port, dst_port)
+//   flow_expire    (ts_ns, src_ip, dst_ip, src_port, dst_port)
+//   epoch_rollover (ts_ns, epoch)
+//   reader_refill  (raw_offset, bytes), when the zstd reader pulls more compressed data from disk
+//
+// Addresses and ports are in network byte order, as stored in flow_t. Building with -DENABLE_USDT_PROBES=OFF (or without sys/sdt.h, from
+// systemtap-sdt-dev) removes them altogether.
+
+#ifdef USDT_PROBES_ENABLED
+
+#include <sys/sdt.h>
+
+#define PROBE_PACKET_INGEST(ts, total_len, is_tcpudp) DTRACE_PROBE3(pcap_stats, packet_ingest, ts, total_len, is_tcpudp)
+#define PROBE_FLOW_CREATE(ts, flow)                                                                                                                  \
+  DTRACE_PROBE5(pcap_stats, flow_create, ts, (flow).five_tuple.src_ip, (flow).five_tuple.dst_ip, (flow).five_tuple.src_port,                     \
+                (flow).five_tuple.dst_port)
+#define PROBE_FLOW_EXPIRE(ts, flow)                                                                                                                  \
+  DTRACE_PROBE5(pcap_stats, flow_expire, ts, (flow).five_tuple.src_ip, (flow).five_tuple.dst_ip, (flow).five_tuple.src_port,                     \
+                (flow).five_tuple.dst_port)
+#define PROBE_EPOCH_ROLLOVER(ts, epoch) DTRACE_PROBE2(pcap_stats, epoch_rollover, ts, epoch)
+#define PROBE_READER_REFILL(raw_offset, bytes) DTRACE_PROBE2(pcap_stats, reader_refill, raw_offset, bytes)
+
+#else
+
+#define PROBE_PACKET_INGEST(ts, total_len, is_tcpudp)                                                                                                \
+  do {                                                                                                                                               \
+  } while (0)
+#define PROBE_FLOW_CREATE(ts, flow)                                                                                                                  \
+  do {                                                                                                                                               \
+  } while (0)
+#define PROBE_FLOW_EXPIRE(ts, flow)                                                                                                                  \
+  do {                                                                                                                                               \
+  } while (0)
+#define PROBE_EPOCH_ROLLOVER(ts, epoch)                                                                                                              \
+  do {                                                                                                                                               \
+  } while (0)
+#define PROBE_READER_REFILL(raw_offset, bytes)                                                                                                       \
+  do {                                                                                                                                               \
+  } while (0)
+
+#endif
@@ -0,0 +1,132 @@
+#include "profiler.h"
+#include "hw_counters.h"
+#include "json_writer.h"
+#include "system.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+Profiler profiler;
+
+namespace {
+
+constexpr const std::array<double, 5> PACKET_COST_PERCENTILES = {50, 90, 99, 99.9, 99.99};
+
+std::string percentile_name(double percentile) {
+  char name[16];
+  snprintf(name, sizeof(name), "p%g", percentile);
+  return name;
+}
+
+} // namespace
+
+u64 CyclesHistogram::get_percentile(double percentile) const {
+  if (total == 0) {
+    return 0;
+  }
+
+  const u64 rank = std::max<u64>(1, static_cast<u64>(std::ceil(total * percentile / 100)));
+  u64 accounted  = 0;
+
+  for (u64 bucket = 0; bucket < BUCKETS; bucket++) {
+    accounted += counts[bucket];
+    if (accounted >= rank) {
+      return bucket_start(bucket);
+    }
+  }
+
+  return max;
+}
+
+void Profiler::enable() {
+  enabled      = true;
+  start_cycles = read_cycles();
+  start_time   = std::chrono::steady_clock::now();
+}
+
+double Profiler::get_cycles_per_ns() const {
+  const u64 elapsed_cycles = read_cycles() - start_cycles;
+  const double elapsed_ns  = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+  return elapsed_ns > 0 ? elapsed_cycles / elapsed_ns : 1;
+}
+
+void Profiler::dump_to_stderr() const {
+  const double cycles_per_ns = get_cycles_per_ns();
+  const double wall_s        = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+  fprintf(stderr, "\nProfile (%.3f s wall, %.3f cycles/ns):\n", wall_s, cycles_per_ns);
+  fprintf(stderr, "  %-16s %14s %12s %10s %8s\n", "stage", "calls", "cycles/call", "time (s)", "wall %");
+
+  for (size_t i = 0; i < PROFILE_STAGE_NAMES.size(); i++) {
+    const double stage_s = stage_cycles[i] / cycles_per_ns / BILLION;
+    fprintf(stderr, "  %-16s %14lu %12.1f %10.3f %7.2f%%\n", PROFILE_STAGE_NAMES[i].data(), stage_calls[i],
+            stage_calls[i] > 0 ? stage_cycles[i] / static_cast<double>(stage_calls[i]) : 0.0, stage_s, wall_s > 0 ? 100 * stage_s / wall_s : 0.0);
+  }
+
+  fprintf(stderr, "  feed_packet cost (ns) over %lu packets:", packet_cycles.get_total());
+  for (const double percentile : PACKET_COST_PERCENTILES) {
+    fprintf(stderr, " %s=%.1f", percentile_name(percentile).c_str(), packet_cycles.get_percentile(percentile) / cycles_per_ns);
+  }
+  fprintf(stderr, " max=%.1f\n", packet_cycles.get_max() / cycles_per_ns);
+
+  if (hw_counters.is_enabled()) {
+    hw_counters.dump_to_stderr();
+  }
+}
+
+void Profiler::dump_to_json_file(const std::filesystem::path &file) const {
+  const double cycles_per_ns = get_cycles_per_ns();
+  const double wall_s        = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+  FILE *out = fopen(file.c_str(), "w");
+  if (!out) {
+    perror("fopen");
+    panic("Failed to open profile output %s", file.c_str());
+  }
+
+  JsonWriter j(out);
+
+  // Keys in lexicographic order, matching the report.
+  j.begin_object();
+  j.field("cycles_per_ns", cycles_per_ns);
+
+  if (hw_counters.is_enabled()) {
+    j.key("hw_counters");
+    hw_counters.write_json(j);
+  }
+
+  j.key("packet_cost_ns");
+  j.begin_object();
+  j.field("max", packet_cycles.get_max() / cycles_per_ns);
+  for (const double percentile : PACKET_COST_PERCENTILES) {
+    j.field(percentile_name(percentile), packet_cycles.get_percentile(percentile) / cycles_per_ns);
+  }
+  j.end_object();
+
+  j.field("packets", packet_cycles.get_total());
+
+  std::array<size_t, PROFILE_STAGE_NAMES.size()> order;
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [](size_t a, size_t b) { return PROFILE_STAGE_NAMES[a] < PROFILE_STAGE_NAMES[b]; });
+
+  j.key("stages");
+  j.begin_object();
+  for (const size_t i : order) {
+    j.key(PROFILE_STAGE_NAMES[i]);
+    j.begin_object();
+    j.field("calls", stage_calls[i]);
+    j.field("cycles", stage_cycles[i]);
+    j.field("wall_s", stage_cycles[i] / cycles_per_ns / BILLION);
+    j.end_object();
+  }
+  j.end_object();
+
+  j.field("wall_s", wall_s);
+  j.end_object();
+  j.finish();
+
+  fclose(out);
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Per-stage cycle accounting, enabled at runtime with --profile.
+//
+// Stages are timed with scoped timers reading the TSC, converted to wall time with a frequency calibrated against the steady clock over the
+// whole run. Building with -DENABLE_PROFILING=OFF compiles every timer away, and with it the (predictable) branch on the runtime flag.
+//
+// Timers are nested: the per-packet cost of feed_packet includes the tracker stages, but not reading and parsing the packet.
+
+enum class ProfileStage : u8 {
+  Read,
+  Parse,
+  Filter,
+  EpochRollover,
+  Expiry,
+  FlowTracker,
+  FlowStats,
+  CdfUpdate,
+  FlowCache,
+  FlowTables,
+  Rss,
+  Hhh,
+  Entropy,
+  Report,
+  Count,
+};
+
+constexpr const std::array<std::string_view, static_cast<size_t>(ProfileStage::Count)> PROFILE_STAGE_NAMES = {
+    "read", "parse", "filter", "epoch_rollover", "expiry", "flow_tracker", "flow_stats", "cdf_update", "flow_cache", "flow_tables",
+    "rss", "hhh", "entropy", "report",
+};
+
+inline u64 read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Log-linear histogram of cycle counts: exact below 16, otherwise 16 sub-buckets per power of two (at most 6.25% relative error).
+class CyclesHistogram {
+private:
+  static constexpr const u64 SUB_BUCKET_BITS = 4;
+  static constexpr const u64 SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+  static constexpr const u64 BUCKETS         = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  std::array<u64, BUCKETS> counts;
+  u64 total;
+  u64 max;
+
+public:
+  CyclesHistogram() : counts{}, total(0), max(0) {}
+
+  void add(u64 cycles) {
+    counts[bucket_of(cycles)]++;
+    total++;
+    max = std::max(max, cycles);
+  }
+
+  u64 get_total() const { return total; }
+  u64 get_max() const { return max; }
+
+  // Lower bound of the bucket holding the given percentile (0-100).
+  u64 get_percentile(double percentile) const;
+
+private:
+  static u64 bucket_of(u64 cycles) {
+    if (cycles < SUB_BUCKETS) {
+      return cycles;
+    }
+    const u64 exponent = 63 - __builtin_clzll(cycles);
+    const u64 sub      = (cycles >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+  }
+
+  static u64 bucket_start(u64 bucket) {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+    const u64 exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    const u64 sub      = bucket % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS);
+  }
+};
+
+class Profiler {
+private:
+  bool enabled;
+
+  std::array<u64, static_cast<size_t>(ProfileStage::Count)> stage_cycles;
+  std::array<u64, static_cast<size_t>(ProfileStage::Count)> stage_calls;
+  CyclesHistogram packet_cycles;
+
+  u64 start_cycles;
+  std::chrono::steady_clock::time_point start_time;
+
+public:
+  Profiler() : enabled(false), stage_cycles{}, stage_calls{}, start_cycles(0) {}
+
+  void enable();
+  bool is_enabled() const { return enabled; }
+
+  void add(ProfileStage stage, u64 cycles) {
+    stage_cycles[static_cast<size_t>(stage)] += cycles;
+    stage_calls[static_cast<size_t>(stage)]++;
+  }
+
+  void add_packet(u64 cycles) { packet_cycles.add(cycles); }
+
+  void dump_to_stderr() const;
+  void dump_to_json_file(const std::filesystem::path &file) const;
+
+private:
+  // Cycle counter ticks per nanosecond, measured since enable().
+  double get_cycles_per_ns() const;
+};
+
+extern Profiler profiler;
+
+class ProfileScope {
+private:
+  const ProfileStage stage;
+  const u64 start;
+
+public:
+  ProfileScope(ProfileStage _stage) : stage(_stage), start(profiler.is_enabled() ? read_cycles() : 0) {}
+
+  ~ProfileScope() {
+    if (profiler.is_enabled()) {
+      profiler.add(stage, read_cycles() - start);
+    }
+  }
+};
+
+class PacketProfileScope {
+private:
+  const u64 start;
+
+public:
+  PacketProfileScope() : start(profiler.is_enabled() ? read_cycles() : 0) {}
+
+  ~PacketProfileScope() {
+    if (profiler.is_enabled()) {
+      profiler.add_packet(read_cycles() - start);
+    }
+  }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef PROFILING_ENABLED
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(stage)
+#define PROFILE_PACKET_SCOPE() PacketProfileScope PROFILE_CONCAT(profile_packet_scope_, __LINE__)
+#else
+#define PROFILE_SCOPE(stage)                                                                                                                         \
+  do {                                                                                                                                               \
+  } while (0)
+#define PROFILE_PACKET_SCOPE()                                                                                                                       \
+  do {                                                                                                                                               \
+  } while (0)
+#endif
@@ -0,0 +1,100 @@
+#include "reuse_distance.h"
+
+#include <algorithm>
+#include <utility>
+
+// Smallest tree, so that the first renumberings are not back to back.
+constexpr const u64 REUSE_DISTANCE_MIN_ACCESSES = 1 << 20;
+
+void ReuseDistanceTracker::access(const flow_t &flow) {
+  if (next_access >= fenwick.size()) {
+    renumber();
+  }
+
+  const u64 now = next_access++;
+  u64 &last     = last_access[flow];
+  accesses++;
+
+  if (last == 0) {
+    cold_misses++;
+  } else {
+    const u64 more_recent = last_access.size() - prefix_sum(last);
+    distances[bucket_of(more_recent + 1)]++;
+    add(last, -1);
+  }
+
+  add(now, 1);
+  last = now;
+}
+
+void ReuseDistanceTracker::renumber() {
+  std::vector<std::pair<u64, flow_t>> by_last_access;
+  by_last_access.reserve(last_access.size());
+  last_access.for_each([&](const flow_t &flow, u64 access) { by_last_access.emplace_back(access, flow); });
+  std::sort(by_last_access.begin(), by_last_access.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  for (u64 i = 0; i < by_last_access.size(); i++) {
+    last_access[by_last_access[i].second] = i + 1;
+  }
+
+  const u64 flows = by_last_access.size();
+  const u64 size  = std::max(REUSE_DISTANCE_MIN_ACCESSES, 2 * flows);
+
+  // Built in linear time: every node adds itself to its parent once complete.
+  fenwick.assign(size + 1, 0);
+  for (u64 i = 1; i <= size; i++) {
+    if (i <= flows) {
+      fenwick[i]++;
+    }
+    const u64 parent = i + (i & -i);
+    if (parent <= size) {
+      fenwick[parent] += fenwick[i];
+    }
+  }
+
+  next_access = flows + 1;
+}
+
+std::vector<miss_ratio_point_t> ReuseDistanceTracker::get_miss_ratio_curve() const {
+  std::vector<miss_ratio_point_t> curve;
+  if (accesses == 0) {
+    return curve;
+  }
+
+  u64 last_bucket = 0;
+  for (u64 bucket = 0; bucket < BUCKETS; bucket++) {
+    if (distances[bucket] > 0) {
+      last_bucket = bucket;
+    }
+  }
+
+  // Misses of a cache holding the distances up to the end of the bucket: the cold ones and every longer distance.
+  u64 misses = accesses;
+  for (u64 bucket = 1; bucket <= std::max<u64>(last_bucket, 1); bucket++) {
+    misses -= distances[bucket];
+    curve.push_back({
+        .capacity   = bucket_start(bucket + 1) - 1,
+        .miss_ratio = static_cast<double>(misses) / accesses,
+    });
+  }
+
+  return curve;
+}
+
+void ReuseDistanceTracker::save(SnapshotWriter &out) const {
+  ::save(out, last_access);
+  ::save(out, fenwick);
+  ::save(out, next_access);
+  ::save(out, accesses);
+  ::save(out, cold_misses);
+  ::save(out, distances);
+}
+
+void ReuseDistanceTracker::load(SnapshotReader &in) {
+  ::load(in, last_access);
+  ::load(in, fenwick);
+  ::load(in, next_access);
+  ::load(in, accesses);
+  ::load(in, cold_misses);
+  ::load(in, distances);
+}
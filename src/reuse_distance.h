@@ -0,0 +1,96 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "huge_pages.h"
+#include "incremental_hash_table.h"
+#include "snapshot.h"
+
+#include <array>
+#include <vector>
+
+// LRU stack (reuse) distances of flow accesses, every TCP/UDP packet being an access to its flow, from which the miss ratio of an LRU flow
+// cache of any capacity follows in a single pass: an access hits a cache of capacity C iff its distance is at most C.
+//
+// Distances are computed with Mattson's algorithm over a Fenwick tree, in O(log n) per access. Accesses are numbered in order, and the tree
+// holds a one at the number of the last access of every flow seen so far. The distance of an access is then one plus the number of flows
+// whose last access is more recent than the previous access of its own flow, a single prefix sum. Access numbers only ever grow, so when
+// they run past the end of the tree the flows are renumbered by their last access and the tree rebuilt, twice as large as the flow count.
+//
+// Distances are counted in a log-linear histogram (16 sub-buckets per power of two), so the curve is exact at the last distance of every
+// bucket, which is where it is reported.
+
+struct miss_ratio_point_t {
+  u64 capacity;
+  double miss_ratio;
+};
+
+class ReuseDistanceTracker {
+private:
+  static constexpr const u64 SUB_BUCKET_BITS = 4;
+  static constexpr const u64 SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+  static constexpr const u64 BUCKETS         = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  // Number of the last access of every flow, starting from 1.
+  IncrementalHashTable<flow_t, u64, flow_t::flow_hash_t> last_access;
+
+  // 1-based, empty until the first access.
+  huge_vector<u32> fenwick;
+  u64 next_access;
+
+  u64 accesses;
+  u64 cold_misses;
+  std::array<u64, BUCKETS> distances;
+
+public:
+  ReuseDistanceTracker() : next_access(0), accesses(0), cold_misses(0), distances{} {}
+
+  void access(const flow_t &flow);
+
+  u64 get_accesses() const { return accesses; }
+  u64 get_cold_misses() const { return cold_misses; }
+
+  // From capacity 1 to the first capacity at which only cold misses are left, increasing.
+  std::vector<miss_ratio_point_t> get_miss_ratio_curve() const;
+
+  u64 get_bytes() const { return last_access.get_bytes() + fenwick.size() * sizeof(u32); }
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+
+private:
+  void renumber();
+
+  // Flows last accessed at or before the given access.
+  u64 prefix_sum(u64 access) const {
+    u64 sum = 0;
+    for (; access > 0; access &= access - 1) {
+      sum += fenwick[access];
+    }
+    return sum;
+  }
+
+  void add(u64 access, i32 delta) {
+    for (; access < fenwick.size(); access += access & -access) {
+      fenwick[access] += delta;
+    }
+  }
+
+  static u64 bucket_of(u64 distance) {
+    if (distance < SUB_BUCKETS) {
+      return distance;
+    }
+    const u64 exponent = 63 - __builtin_clzll(distance);
+    const u64 sub      = (distance >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+  }
+
+  static u64 bucket_start(u64 bucket) {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+    const u64 exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    const u64 sub      = bucket % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS);
+  }
+};
@@ -0,0 +1,180 @@
+#include "rss_sim.h"
+
+#include <algorithm>
+#include <cstring>
+
+std::optional<rss_key_t> parse_rss_key(const std::string &hex) {
+  std::string digits;
+  for (char c : hex) {
+    if (c != ':') {
+      digits += c;
+    }
+  }
+
+  if (digits.size() != 2 * RSS_KEY_SIZE) {
+    return std::nullopt;
+  }
+
+  rss_key_t key;
+  for (u64 i = 0; i < RSS_KEY_SIZE; i++) {
+    u8 byte = 0;
+    for (char c : digits.substr(2 * i, 2)) {
+      if (c >= '0' && c <= '9') {
+        byte = byte << 4 | (c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        byte = byte << 4 | (c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        byte = byte << 4 | (c - 'A' + 10);
+      } else {
+        return std::nullopt;
+      }
+    }
+    key[i] = byte;
+  }
+
+  return key;
+}
+
+ToeplitzHash::ToeplitzHash(const rss_key_t &key) {
+  // The 32 bits of the key starting at every bit of the input.
+  auto window = [&](u64 bit) {
+    u64 bits = 0;
+    for (u64 i = 0; i < sizeof(u64); i++) {
+      const u64 byte = bit / 8 + i;
+      bits           = bits << 8 | (byte < RSS_KEY_SIZE ? key[byte] : 0);
+    }
+    return static_cast<u32>(bits << (bit % 8) >> 32);
+  };
+
+  for (u64 position = 0; position < RSS_INPUT_SIZE; position++) {
+    for (u64 value = 0; value < 256; value++) {
+      u32 contribution = 0;
+      for (u64 bit = 0; bit < 8; bit++) {
+        if (value & (0x80 >> bit)) {
+          contribution ^= window(position * 8 + bit);
+        }
+      }
+      table[position][value] = contribution;
+    }
+  }
+}
+
+double get_rss_imbalance(const rss_queue_counts_t *queues, u64 count, u64 rss_queue_counts_t::*field) {
+  u64 max   = 0;
+  u64 total = 0;
+  for (u64 i = 0; i < count; i++) {
+    max = std::max(max, queues[i].*field);
+    total += queues[i].*field;
+  }
+  return total == 0 ? 0 : static_cast<double>(max) * count / total;
+}
+
+RssSimulator::RssSimulator()
+    : config{.queue_counts = {}, .key = DEFAULT_RSS_KEY, .symmetric = false}, toeplitz(DEFAULT_RSS_KEY), row_size(0) {}
+
+void RssSimulator::set_config(const rss_config_t &_config) {
+  config   = _config;
+  toeplitz = ToeplitzHash(config.key);
+
+  retas.clear();
+  row_offsets.clear();
+  row_size = 0;
+  for (u64 queues : config.queue_counts) {
+    std::array<u8, RSS_RETA_SIZE> reta;
+    for (u64 i = 0; i < RSS_RETA_SIZE; i++) {
+      reta[i] = i % queues;
+    }
+    retas.push_back(reta);
+    row_offsets.push_back(row_size);
+    row_size += queues;
+  }
+
+  totals.assign(row_size, rss_queue_counts_t{});
+  epochs.assign(row_size, rss_queue_counts_t{});
+}
+
+u32 RssSimulator::hash(const flow_t &flow) const {
+  u32 src_ip   = flow.five_tuple.src_ip;
+  u32 dst_ip   = flow.five_tuple.dst_ip;
+  u16 src_port = flow.five_tuple.src_port;
+  u16 dst_port = flow.five_tuple.dst_port;
+
+  if (config.symmetric && std::make_pair(bswap32(src_ip), bswap16(src_port)) > std::make_pair(bswap32(dst_ip), bswap16(dst_port))) {
+    std::swap(src_ip, dst_ip);
+    std::swap(src_port, dst_port);
+  }
+
+  u8 input[RSS_INPUT_SIZE];
+  memcpy(input, &src_ip, sizeof(u32));
+  memcpy(input + 4, &dst_ip, sizeof(u32));
+  memcpy(input + 8, &src_port, sizeof(u16));
+  memcpy(input + 10, &dst_port, sizeof(u16));
+
+  return toeplitz.hash(input);
+}
+
+void RssSimulator::access(const flow_t &flow, bytes_t bytes) {
+  const u32 bucket = hash(flow) % RSS_RETA_SIZE;
+
+  const u64 flows_before       = flows.size();
+  const u64 epoch_flows_before = epoch_flows.size();
+  flows.insert(flow);
+  epoch_flows.insert(flow);
+  const u64 new_flow       = flows.size() - flows_before;
+  const u64 new_epoch_flow = epoch_flows.size() - epoch_flows_before;
+
+  rss_queue_counts_t *epoch = epochs.data() + epochs.size() - row_size;
+  for (u64 i = 0; i < retas.size(); i++) {
+    const u64 queue = row_offsets[i] + retas[i][bucket];
+
+    totals[queue].pkts++;
+    totals[queue].bytes += bytes;
+    totals[queue].flows += new_flow;
+
+    epoch[queue].pkts++;
+    epoch[queue].bytes += bytes;
+    epoch[queue].flows += new_epoch_flow;
+  }
+}
+
+void RssSimulator::on_epoch_rollover() {
+  epochs.resize(epochs.size() + row_size);
+  epoch_flows.clear();
+}
+
+std::vector<rss_report_t> RssSimulator::get_reports() const {
+  std::vector<rss_report_t> reports;
+
+  const u64 epochs_count = row_size == 0 ? 0 : epochs.size() / row_size;
+  for (u64 i = 0; i < config.queue_counts.size(); i++) {
+    const u64 queues = config.queue_counts[i];
+
+    rss_report_t report = {
+        .queues = queues,
+        .totals = std::vector<rss_queue_counts_t>(totals.begin() + row_offsets[i], totals.begin() + row_offsets[i] + queues),
+        .epochs = {},
+    };
+    for (u64 epoch = 0; epoch < epochs_count; epoch++) {
+      const auto row = epochs.begin() + epoch * row_size + row_offsets[i];
+      report.epochs.insert(report.epochs.end(), row, row + queues);
+    }
+
+    reports.push_back(std::move(report));
+  }
+
+  return reports;
+}
+
+void RssSimulator::save(SnapshotWriter &out) const {
+  ::save(out, flows);
+  ::save(out, epoch_flows);
+  ::save(out, totals);
+  ::save(out, epochs);
+}
+
+void RssSimulator::load(SnapshotReader &in) {
+  ::load(in, flows);
+  ::load(in, epoch_flows);
+  ::load(in, totals);
+  ::load(in, epochs);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "incremental_hash_table.h"
+#include "snapshot.h"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Spreads the flow stream (every TCP/UDP packet) across NIC queues with RSS, for several queue counts at once.
+//
+// The hash is Toeplitz over the IPv4 5-tuple as NICs hash it (source and destination addresses, then source and destination ports, in
+// network byte order), with a configurable 40 byte key. The queue is picked by the low bits of the hash through an indirection table of
+// RSS_RETA_SIZE entries filled round-robin, as drivers set it up by default, so queue counts that do not divide it are unevenly loaded,
+// as they would be on the NIC. With symmetric RSS both directions of a connection land on the same queue: the endpoints are put in a
+// canonical order before hashing, which works with any key.
+//
+// The hash is byte-sliced: the key is expanded up front into a table with the contribution of every byte value at every input position,
+// so hashing a packet is 12 lookups and XORs instead of 96 shifted key windows. It is computed once per packet, and each queue count only
+// adds an indirection table lookup and its counters. Flows are tracked once as well, in sets shared by every queue count.
+
+constexpr const u64 RSS_KEY_SIZE   = 40;
+constexpr const u64 RSS_INPUT_SIZE = 12;
+constexpr const u64 RSS_RETA_SIZE  = 128;
+constexpr const u64 RSS_MAX_QUEUES = 64;
+
+typedef std::array<u8, RSS_KEY_SIZE> rss_key_t;
+
+// The key from the Microsoft RSS specification, which most drivers default to.
+constexpr const rss_key_t DEFAULT_RSS_KEY = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb,
+    0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+const std::vector<u64> DEFAULT_RSS_QUEUE_COUNTS = {2, 4, 8, 16, 32, 64};
+
+// From hex digits, optionally separated by colons.
+std::optional<rss_key_t> parse_rss_key(const std::string &hex);
+
+struct rss_config_t {
+  std::vector<u64> queue_counts;
+  rss_key_t key;
+  bool symmetric;
+
+  bool operator==(const rss_config_t &other) const = default;
+};
+
+class ToeplitzHash {
+private:
+  std::array<std::array<u32, 256>, RSS_INPUT_SIZE> table;
+
+public:
+  ToeplitzHash(const rss_key_t &key);
+
+  u32 hash(const u8 *input) const {
+    u32 result = 0;
+    for (u64 i = 0; i < RSS_INPUT_SIZE; i++) {
+      result ^= table[i][input[i]];
+    }
+    return result;
+  }
+};
+
+struct rss_queue_counts_t {
+  u64 pkts;
+  u64 bytes;
+  // Distinct flows, overall or seen in the epoch.
+  u64 flows;
+};
+
+struct rss_report_t {
+  u64 queues;
+  std::vector<rss_queue_counts_t> totals;
+  // queues entries per epoch.
+  std::vector<rss_queue_counts_t> epochs;
+};
+
+// Max over mean of the queues, 0 if they are all empty.
+double get_rss_imbalance(const rss_queue_counts_t *queues, u64 count, u64 rss_queue_counts_t::*field);
+
+class RssSimulator {
+private:
+  rss_config_t config;
+  ToeplitzHash toeplitz;
+
+  // Queue of every hash bucket, one table per queue count, and where each queue count's queues start in a row of counters.
+  std::vector<std::array<u8, RSS_RETA_SIZE>> retas;
+  std::vector<u64> row_offsets;
+  u64 row_size;
+
+  IncrementalHashSet<flow_t, flow_t::flow_hash_t> flows;
+  IncrementalHashSet<flow_t, flow_t::flow_hash_t> epoch_flows;
+
+  // A row for the whole trace, and one per epoch.
+  std::vector<rss_queue_counts_t> totals;
+  std::vector<rss_queue_counts_t> epochs;
+
+public:
+  RssSimulator();
+
+  void set_config(const rss_config_t &config);
+
+  u32 hash(const flow_t &flow) const;
+  void access(const flow_t &flow, bytes_t bytes);
+  void on_epoch_rollover();
+  std::vector<rss_report_t> get_reports() const;
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+inline void save(SnapshotWriter &out, const rss_config_t &config) {
+  save(out, config.queue_counts);
+  save(out, config.key);
+  save(out, config.symmetric);
+}
+
+inline void load(SnapshotReader &in, rss_config_t &config) {
+  load(in, config.queue_counts);
+  load(in, config.key);
+  load(in, config.symmetric);
+}
+
+inline void save(SnapshotWriter &out, const rss_report_t &report) {
+  save(out, report.queues);
+  save(out, report.totals);
+  save(out, report.epochs);
+}
+
+inline void load(SnapshotReader &in, rss_report_t &report) {
+  load(in, report.queues);
+  load(in, report.totals);
+  load(in, report.epochs);
+}
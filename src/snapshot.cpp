@@ -0,0 +1,52 @@
+#include "snapshot.h"
+#include "system.h"
+
+#include <cstring>
+#include <unistd.h>
+
+constexpr const size_t SNAPSHOT_IO_BUFFER_SIZE = 4 << 20;
+
+SnapshotWriter::SnapshotWriter(const std::filesystem::path &file) : out(fopen(file.c_str(), "wb")) {
+  if (!out) {
+    perror("fopen");
+    panic("Failed to open snapshot %s for writing", file.c_str());
+  }
+  setvbuf(out, nullptr, _IOFBF, SNAPSHOT_IO_BUFFER_SIZE);
+}
+
+SnapshotWriter::~SnapshotWriter() { close(); }
+
+void SnapshotWriter::write(const void *data, size_t size) {
+  if (fwrite(data, 1, size, out) != size) {
+    panic("Failed to write snapshot: %s", strerror(errno));
+  }
+}
+
+bool SnapshotWriter::close() {
+  if (!out) {
+    return true;
+  }
+
+  bool ok = fflush(out) == 0;
+  ok      = ok && fsync(fileno(out)) == 0;
+  ok      = (fclose(out) == 0) && ok;
+  out     = nullptr;
+
+  return ok;
+}
+
+SnapshotReader::SnapshotReader(const std::filesystem::path &file) : in(fopen(file.c_str(), "rb")) {
+  if (!in) {
+    perror("fopen");
+    panic("Failed to open snapshot %s", file.c_str());
+  }
+  setvbuf(in, nullptr, _IOFBF, SNAPSHOT_IO_BUFFER_SIZE);
+}
+
+SnapshotReader::~SnapshotReader() { fclose(in); }
+
+void SnapshotReader::read(void *data, size_t size) {
+  if (fread(data, 1, size, in) != size) {
+    panic("Truncated or corrupted snapshot");
+  }
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "incremental_hash_table.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Raw binary (de)serialization of the tracker state, used for checkpoints.
+//
+// Snapshots are only meant to be read back by the same binary that produced them, so values are dumped in native layout and endianness.
+// Types get serialized through the save()/load() overload set below, which containers recurse into; data structures with private state
+// expose save()/load() members instead.
+
+class SnapshotWriter {
+private:
+  FILE *out;
+
+public:
+  SnapshotWriter(const std::filesystem::path &file);
+  ~SnapshotWriter();
+
+  SnapshotWriter(const SnapshotWriter &)            = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  void write(const void *data, size_t size);
+
+  // Flushes to stable storage and closes the file. Returns false on any I/O error.
+  bool close();
+};
+
+class SnapshotReader {
+private:
+  FILE *in;
+
+public:
+  SnapshotReader(const std::filesystem::path &file);
+  ~SnapshotReader();
+
+  SnapshotReader(const SnapshotReader &)            = delete;
+  SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+  void read(void *data, size_t size);
+};
+
+template <typename T>
+  requires std::is_trivially_copyable_v<T>
+void save(SnapshotWriter &out, const T &value) {
+  out.write(&value, sizeof(T));
+}
+
+template <typename T>
+  requires std::is_trivially_copyable_v<T>
+void load(SnapshotReader &in, T &value) {
+  in.read(&value, sizeof(T));
+}
+
+inline void save(SnapshotWriter &out, const flow_t &flow) {
+  assert(flow.type == FlowType::FiveTuple);
+  save(out, flow.five_tuple);
+}
+
+inline void load(SnapshotReader &in, flow_t &flow) {
+  flow.type = FlowType::FiveTuple;
+  load(in, flow.five_tuple);
+}
+
+inline void save(SnapshotWriter &out, const sflow_t &sflow) {
+  save(out, sflow.src_ip);
+  save(out, sflow.dst_ip);
+  save(out, sflow.src_port);
+  save(out, sflow.dst_port);
+}
+
+inline void load(SnapshotReader &in, sflow_t &sflow) {
+  load(in, sflow.src_ip);
+  load(in, sflow.dst_ip);
+  load(in, sflow.src_port);
+  load(in, sflow.dst_port);
+}
+
+inline void save(SnapshotWriter &out, const std::string &str) {
+  save(out, static_cast<u64>(str.size()));
+  out.write(str.data(), str.size());
+}
+
+inline void load(SnapshotReader &in, std::string &str) {
+  u64 size;
+  load(in, size);
+  str.resize(size);
+  in.read(str.data(), size);
+}
+
+template <typename T> void save_array(SnapshotWriter &out, const T *data, u64 size) {
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    out.write(data, size * sizeof(T));
+  } else {
+    for (u64 i = 0; i < size; i++) {
+      save(out, data[i]);
+    }
+  }
+}
+
+template <typename T> void load_array(SnapshotReader &in, T *data, u64 size) {
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    in.read(data, size * sizeof(T));
+  } else {
+    for (u64 i = 0; i < size; i++) {
+      load(in, data[i]);
+    }
+  }
+}
+
+template <typename T, typename A> void save(SnapshotWriter &out, const std::vector<T, A> &vector) {
+  save(out, static_cast<u64>(vector.size()));
+  save_array(out, vector.data(), vector.size());
+}
+
+template <typename T, typename A> void load(SnapshotReader &in, std::vector<T, A> &vector) {
+  u64 size;
+  load(in, size);
+  vector.resize(size);
+  load_array(in, vector.data(), size);
+}
+
+template <typename K, typename H> void save(SnapshotWriter &out, const std::unordered_set<K, H> &set) {
+  save(out, static_cast<u64>(set.size()));
+  for (const K &key : set) {
+    save(out, key);
+  }
+}
+
+template <typename K, typename H> void load(SnapshotReader &in, std::unordered_set<K, H> &set) {
+  u64 size;
+  load(in, size);
+  set.clear();
+  set.reserve(size);
+  for (u64 i = 0; i < size; i++) {
+    K key;
+    load(in, key);
+    set.insert(key);
+  }
+}
+
+template <typename K, typename V, typename H> void save(SnapshotWriter &out, const std::unordered_map<K, V, H> &map) {
+  save(out, static_cast<u64>(map.size()));
+  for (const auto &[key, value] : map) {
+    save(out, key);
+    save(out, value);
+  }
+}
+
+template <typename K, typename V, typename H> void load(SnapshotReader &in, std::unordered_map<K, V, H> &map) {
+  u64 size;
+  load(in, size);
+  map.clear();
+  map.reserve(size);
+  for (u64 i = 0; i < size; i++) {
+    K key;
+    load(in, key);
+    load(in, map[key]);
+  }
+}
+
+template <typename K, typename V> void save(SnapshotWriter &out, const std::map<K, V> &map) {
+  save(out, static_cast<u64>(map.size()));
+  for (const auto &[key, value] : map) {
+    save(out, key);
+    save(out, value);
+  }
+}
+
+template <typename K, typename V> void load(SnapshotReader &in, std::map<K, V> &map) {
+  u64 size;
+  load(in, size);
+  map.clear();
+  for (u64 i = 0; i < size; i++) {
+    K key;
+    load(in, key);
+    load(in, map.emplace_hint(map.end(), key, V())->second);
+  }
+}
+
+// Same layout as the std containers (values omitted for sets), so snapshots do not depend on which one backs a table.
+template <typename K, typename V, typename H> void save(SnapshotWriter &out, const IncrementalHashTable<K, V, H> &table) {
+  save(out, static_cast<u64>(table.size()));
+  table.for_each([&](const K &key, const V &value) {
+    save(out, key);
+    if constexpr (!std::is_empty_v<V>) {
+      save(out, value);
+    }
+  });
+}
+
+template <typename K, typename V, typename H> void load(SnapshotReader &in, IncrementalHashTable<K, V, H> &table) {
+  u64 size;
+  load(in, size);
+  table.clear();
+  table.reserve(size);
+  for (u64 i = 0; i < size; i++) {
+    K key;
+    load(in, key);
+    V &value = table[key];
+    if constexpr (!std::is_empty_v<V>) {
+      load(in, value);
+    }
+  }
+}
@@ -0,0 +1,132 @@
+#include "telemetry.h"
+#include "system.h"
+
+#include <cmath>
+#include <limits>
+#include <unistd.h>
+
+namespace {
+
+struct telemetry_sample_t {
+  double elapsed_s;
+  u64 pkts;
+  u64 bytes;
+  u64 input_bytes;
+  u64 input_pcap_bytes;
+  u64 input_bytes_left;
+  u64 live_flows;
+  double flow_table_load_factor;
+  u64 rss_bytes;
+};
+
+u64 get_rss_bytes() {
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (!statm) {
+    return 0;
+  }
+
+  u64 pages, resident_pages;
+  const int matched = fscanf(statm, "%lu %lu", &pages, &resident_pages);
+  fclose(statm);
+
+  return matched == 2 ? resident_pages * sysconf(_SC_PAGESIZE) : 0;
+}
+
+telemetry_sample_t take_sample(const telemetry_counters_t &counters, double elapsed_s) {
+  return {
+      .elapsed_s              = elapsed_s,
+      .pkts                   = counters.pkts.load(std::memory_order_relaxed),
+      .bytes                  = counters.bytes.load(std::memory_order_relaxed),
+      .input_bytes            = counters.input_bytes.load(std::memory_order_relaxed),
+      .input_pcap_bytes       = counters.input_pcap_bytes.load(std::memory_order_relaxed),
+      .input_bytes_left       = counters.input_bytes_left.load(std::memory_order_relaxed),
+      .live_flows             = counters.live_flows.load(std::memory_order_relaxed),
+      .flow_table_load_factor = counters.flow_table_load_factor.load(std::memory_order_relaxed),
+      .rss_bytes              = get_rss_bytes(),
+  };
+}
+
+} // namespace
+
+Telemetry::Telemetry(std::chrono::milliseconds _interval, const std::filesystem::path &output_file)
+    : interval(_interval), out(nullptr), stop(false), start(std::chrono::steady_clock::now()) {
+  if (!output_file.empty()) {
+    out = fopen(output_file.c_str(), "w");
+    if (!out) {
+      perror("fopen");
+      panic("Failed to open telemetry output %s", output_file.c_str());
+    }
+  }
+
+  sampler = std::thread(&Telemetry::sampler_loop, this);
+}
+
+Telemetry::~Telemetry() { close(); }
+
+void Telemetry::close() {
+  if (!sampler.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stop = true;
+  }
+
+  cv.notify_one();
+  sampler.join();
+
+  if (out) {
+    fclose(out);
+    out = nullptr;
+  }
+}
+
+void Telemetry::sampler_loop() {
+  telemetry_sample_t previous = take_sample(counters, 0);
+  bool stopping               = false;
+
+  while (!stopping) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      stopping = cv.wait_for(guard, interval, [this]() { return stop; });
+    }
+
+    const double elapsed_s          = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const telemetry_sample_t sample = take_sample(counters, elapsed_s);
+    const double dt                 = sample.elapsed_s - previous.elapsed_s;
+
+    if (dt <= 0) {
+      continue;
+    }
+
+    const double mpps              = (sample.pkts - previous.pkts) / dt / MILLION;
+    const double gbps              = (sample.bytes - previous.bytes) * 8 / dt / BILLION;
+    const double input_rate        = (sample.input_bytes - previous.input_bytes) / dt;
+    const double decompression     = sample.input_bytes > 0 ? sample.input_pcap_bytes / static_cast<double>(sample.input_bytes) : 0;
+    const double eta_s             = input_rate > 0 ? sample.input_bytes_left / input_rate : std::numeric_limits<double>::quiet_NaN();
+    const double input_mib         = sample.input_bytes / static_cast<double>(1 << 20);
+    const double rss_mib           = sample.rss_bytes / static_cast<double>(1 << 20);
+    const double input_mib_per_sec = input_rate / (1 << 20);
+
+    char eta[32] = "-";
+    if (std::isfinite(eta_s)) {
+      snprintf(eta, sizeof(eta), "%.0fs", eta_s);
+    }
+
+    fprintf(stderr, "[%8.1fs] %7.3f Mpps %8.3f Gbps | input %.1f MiB (%.1f MiB/s, x%.2f) | flows %lu (load %.2f) | RSS %.1f MiB | ETA %s\n",
+            sample.elapsed_s, mpps, gbps, input_mib, input_mib_per_sec, decompression, sample.live_flows, sample.flow_table_load_factor,
+            rss_mib, eta);
+
+    if (out) {
+      fprintf(out,
+              "{\"elapsed_s\": %.3f, \"pkts\": %lu, \"bytes\": %lu, \"mpps\": %.6f, \"gbps\": %.6f, \"input_bytes\": %lu, "
+              "\"decompression_ratio\": %.6f, \"live_flows\": %lu, \"flow_table_load_factor\": %.6f, \"rss_bytes\": %lu, \"eta_s\": %.3f}\n",
+              sample.elapsed_s, sample.pkts, sample.bytes, mpps, gbps, sample.input_bytes, decompression, sample.live_flows,
+              sample.flow_table_load_factor, sample.rss_bytes, std::isfinite(eta_s) ? eta_s : -1.0);
+      fflush(out);
+    }
+
+    previous = sample;
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "types.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+// Progress counters, published by the ingest thread every now and then (it keeps counting locally in between), and sampled by the
+// telemetry thread. All accesses are relaxed: samples only need to be roughly consistent.
+struct telemetry_counters_t {
+  std::atomic<u64> pkts;
+  std::atomic<u64> bytes;
+
+  // Bytes of the trace file consumed (compressed bytes for zstd traces), and of pcap data they decompressed to. Both cumulative over passes.
+  std::atomic<u64> input_bytes;
+  std::atomic<u64> input_pcap_bytes;
+
+  // How much of the trace file the current pass still has to go through.
+  std::atomic<u64> input_bytes_left;
+
+  std::atomic<u64> live_flows;
+  std::atomic<double> flow_table_load_factor;
+
+  telemetry_counters_t()
+      : pkts(0), bytes(0), input_bytes(0), input_pcap_bytes(0), input_bytes_left(0), live_flows(0), flow_table_load_factor(0) {}
+};
+
+// Samples the counters at a fixed wall clock interval, printing one line per sample to stderr and optionally appending it as a JSON line to
+// a file.
+class Telemetry {
+private:
+  const std::chrono::milliseconds interval;
+  FILE *out;
+
+  std::mutex lock;
+  std::condition_variable cv;
+  bool stop;
+
+  const std::chrono::steady_clock::time_point start;
+  std::thread sampler;
+
+public:
+  telemetry_counters_t counters;
+
+  Telemetry(std::chrono::milliseconds _interval, const std::filesystem::path &output_file);
+  ~Telemetry();
+
+  Telemetry(const Telemetry &)            = delete;
+  Telemetry &operator=(const Telemetry &) = delete;
+
+  // Takes a last sample and stops the sampling thread.
+  void close();
+
+private:
+  void sampler_loop();
+};
@@ -1,92 +1,423 @@
 #include "traffic_stats_tracker.h"
+#include "json_writer.h"
+#include "columnar_writer.h"
+#include "profiler.h"
+#include "hw_counters.h"
+#include "probes.h"
+#include "alloc_tracker.h"
+#include "multiversion.h"
+#include "system.h"
 
-#include <nlohmann/json.hpp>
-#include <fstream>
+#include <algorithm>
 
-using json = nlohmann::json;
+constexpr const size_t JSON_OUTPUT_BUFFER_SIZE = 1 << 20;
 
-constexpr const u64 TRAFFIC_STATS_TRACKER_PROGRESS_PRINT_STEP = 1'000'000;
+namespace {
 
-void traffic_stats_tracker_t::feed_packet(const packet_t &pkt) {
-  if (report.total_pkts % TRAFFIC_STATS_TRACKER_PROGRESS_PRINT_STEP == 0) {
-    std::cerr << "[" << pkt.ts << "] Processed " << report.total_pkts << " packets..." << std::endl;
+void write_json_cdf(JsonWriter &j, std::string_view name, const CDF &cdf) {
+  const std::map<u64, double> points = cdf.get_cdf();
+
+  j.key(name);
+  j.begin_object();
+  j.key("probabilities");
+  j.begin_array();
+  for (const auto &[v, p] : points) {
+    j.value(p);
+  }
+  j.end_array();
+  j.key("values");
+  j.begin_array();
+  for (const auto &[v, p] : points) {
+    j.value(v);
   }
+  j.end_array();
+  j.end_object();
+}
 
-  report.end = pkt.ts;
-  if (report.start == 0) {
-    report.start = pkt.ts;
+void write_json_hash_table_stats(JsonWriter &j, std::string_view name, const hash_table_stats_t &stats) {
+  j.key(name);
+  j.begin_object();
+  j.field("avg_bucket_len", stats.avg_bucket_len);
+  j.field("bucket_count", stats.bucket_count);
+  j.field("bytes", stats.bytes);
+  j.field("load_factor", stats.load_factor);
+  j.field("max_bucket_len", stats.max_bucket_len);
+  j.field("rehash_ns", stats.rehash_ns);
+  j.field("rehashes", stats.rehashes);
+  j.field("size", stats.size);
+  j.end_object();
+}
+
+void write_json_tracker_table_stats(JsonWriter &j, const tracker_table_stats_t &stats, metrics_t metrics) {
+  j.begin_object();
+  if (has_metric(metrics, Metric::FlowSizes)) {
+    write_json_hash_table_stats(j, "bytes_per_flow", stats.bytes_per_flow);
+  }
+  if (has_metric(metrics, Metric::Concurrency)) {
+    write_json_hash_table_stats(j, "concurrent_flows", stats.concurrent_flows);
+  }
+  if (has_metric(metrics, Metric::FlowTimes)) {
+    write_json_hash_table_stats(j, "flow_times", stats.flow_times);
   }
+  if (has_metric(metrics, Metric::Churn)) {
+    write_json_hash_table_stats(j, "flow_tracker", stats.flow_tracker);
+  }
+  if (has_metric(metrics, Metric::Flows)) {
+    write_json_hash_table_stats(j, "flows", stats.flows);
+  }
+  if (has_metric(metrics, Metric::FlowSizes)) {
+    write_json_hash_table_stats(j, "pkts_per_flow", stats.pkts_per_flow);
+  }
+  if (has_metric(metrics, Metric::SymmFlows)) {
+    write_json_hash_table_stats(j, "symm_flows", stats.symm_flows);
+  }
+  j.end_object();
+}
 
-  report.total_pkts++;
-  report.total_bytes += pkt.total_len;
-  report.pkt_sizes_cdf.add(pkt.total_len);
+void write_columnar_cdf(ColumnarWriter &out, const std::string &name, const CDF &cdf) {
+  std::vector<u64> values;
+  std::vector<double> probabilities;
+  for (const auto &[v, p] : cdf.get_cdf()) {
+    values.push_back(v);
+    probabilities.push_back(p);
+  }
+  out.column(name + ".values", values);
+  out.column(name + ".probabilities", probabilities);
+}
 
-  if (clock.tick(pkt.ts)) {
-    concurrent_flows_per_epoch.emplace_back();
-    expired_flows_per_epoch.emplace_back();
-    new_flows_per_epoch.emplace_back();
+void write_json_flow_table(JsonWriter &j, const flow_table_report_t &table) {
+  const flow_table_geometry_t &geometry = table.geometry;
+
+  j.begin_object();
+  j.field("entries", geometry.entries);
+  j.key("epochs");
+  j.begin_object();
+  j.key("insert_failures");
+  j.begin_array();
+  for (const flow_table_epoch_t &epoch : table.epochs) {
+    j.value(epoch.insert_failures);
+  }
+  j.end_array();
+  j.key("live_evictions");
+  j.begin_array();
+  for (const flow_table_epoch_t &epoch : table.epochs) {
+    j.value(epoch.live_evictions);
+  }
+  j.end_array();
+  j.key("misses");
+  j.begin_array();
+  for (const flow_table_epoch_t &epoch : table.epochs) {
+    j.value(epoch.misses);
   }
+  j.end_array();
+  j.key("occupancy");
+  j.begin_array();
+  for (const flow_table_epoch_t &epoch : table.epochs) {
+    j.value(static_cast<double>(epoch.occupancy) / geometry.entries);
+  }
+  j.end_array();
+  j.end_object();
+  j.field("hash", FLOW_TABLE_HASH_NAMES[static_cast<size_t>(geometry.hash)]);
+  j.field("insert_failures", table.insert_failures);
+  j.field("kind", FLOW_TABLE_KIND_NAMES[static_cast<size_t>(geometry.kind)]);
+  j.field("live_evictions", table.live_evictions);
+  j.field("lookups", table.lookups);
+  j.field("misses", table.misses);
+  j.field("name", std::string_view(geometry.get_name()));
+  j.field("replacement", FLOW_TABLE_REPLACEMENT_NAMES[static_cast<size_t>(geometry.replacement)]);
+  j.field("timeout_ms", static_cast<u64>(geometry.timeout / MILLION));
+  j.field("ways", geometry.ways);
+  j.end_object();
+}
 
-  if (!pkt.flow.has_value()) {
-    return;
+void write_columnar_flow_table(ColumnarWriter &out, const flow_table_report_t &table) {
+  std::vector<u64> insert_failures;
+  std::vector<u64> live_evictions;
+  std::vector<u64> misses;
+  std::vector<double> occupancy;
+  for (const flow_table_epoch_t &epoch : table.epochs) {
+    insert_failures.push_back(epoch.insert_failures);
+    live_evictions.push_back(epoch.live_evictions);
+    misses.push_back(epoch.misses);
+    occupancy.push_back(static_cast<double>(epoch.occupancy) / table.geometry.entries);
   }
 
-  expired_flows_per_epoch.back() += flow_tracker.expire_flows(pkt.ts);
-  if (!flow_tracker.has_flow(pkt.flow.value())) {
-    flow_tracker.add_flow(pkt.flow.value(), pkt.ts);
-    new_flows_per_epoch.back()++;
+  const std::string prefix = "flow_tables." + table.geometry.get_name() + ".";
+  out.scalar(prefix + "lookups", table.lookups);
+  out.scalar(prefix + "misses", table.misses);
+  out.scalar(prefix + "insert_failures", table.insert_failures);
+  out.scalar(prefix + "live_evictions", table.live_evictions);
+  out.column(prefix + "epochs.misses", misses);
+  out.column(prefix + "epochs.insert_failures", insert_failures);
+  out.column(prefix + "epochs.live_evictions", live_evictions);
+  out.column(prefix + "epochs.occupancy", occupancy);
+}
+
+struct rss_field_t {
+  u64 rss_queue_counts_t::*field;
+  // Overall and per epoch, where the distinct flows of an epoch are its concurrent flows.
+  std::string_view total_name;
+  std::string_view epoch_name;
+};
+
+// In lexicographic order of both names.
+constexpr const std::array<rss_field_t, 3> RSS_FIELDS = {{
+    {&rss_queue_counts_t::bytes, "bytes", "bytes"},
+    {&rss_queue_counts_t::flows, "flows", "concurrent_flows"},
+    {&rss_queue_counts_t::pkts, "pkts", "pkts"},
+}};
+
+void write_json_rss(JsonWriter &j, const rss_report_t &rss) {
+  const u64 epochs = rss.epochs.size() / rss.queues;
+
+  auto write_epochs = [&](const rss_field_t &field) {
+    j.key(field.epoch_name);
+    j.begin_array();
+    for (u64 epoch = 0; epoch < epochs; epoch++) {
+      j.begin_array();
+      for (u64 queue = 0; queue < rss.queues; queue++) {
+        j.value(rss.epochs[epoch * rss.queues + queue].*field.field);
+      }
+      j.end_array();
+    }
+    j.end_array();
+  };
+
+  j.begin_object();
+  j.key("epochs");
+  j.begin_object();
+  write_epochs(RSS_FIELDS[0]);
+  write_epochs(RSS_FIELDS[1]);
+  j.key("imbalance");
+  j.begin_object();
+  for (const rss_field_t &field : RSS_FIELDS) {
+    j.key(field.epoch_name);
+    j.begin_array();
+    for (u64 epoch = 0; epoch < epochs; epoch++) {
+      j.value(get_rss_imbalance(rss.epochs.data() + epoch * rss.queues, rss.queues, field.field));
+    }
+    j.end_array();
+  }
+  j.end_object();
+  write_epochs(RSS_FIELDS[2]);
+  j.end_object();
+  j.key("imbalance");
+  j.begin_object();
+  for (const rss_field_t &field : RSS_FIELDS) {
+    j.field(field.total_name, get_rss_imbalance(rss.totals.data(), rss.queues, field.field));
+  }
+  j.end_object();
+  j.field("queues", rss.queues);
+  j.key("totals");
+  j.begin_object();
+  for (const rss_field_t &field : RSS_FIELDS) {
+    j.key(field.total_name);
+    j.begin_array();
+    for (const rss_queue_counts_t &queue : rss.totals) {
+      j.value(queue.*field.field);
+    }
+    j.end_array();
+  }
+  j.end_object();
+  j.end_object();
+}
+
+// Per epoch counts are flattened, queues values per epoch.
+void write_columnar_rss(ColumnarWriter &out, const rss_report_t &rss) {
+  const std::string prefix = "rss." + std::to_string(rss.queues) + ".";
+  const u64 epochs         = rss.epochs.size() / rss.queues;
+
+  for (const rss_field_t &field : RSS_FIELDS) {
+    std::vector<u64> totals;
+    for (const rss_queue_counts_t &queue : rss.totals) {
+      totals.push_back(queue.*field.field);
+    }
+    std::vector<u64> per_epoch;
+    std::vector<double> imbalance;
+    for (u64 epoch = 0; epoch < epochs; epoch++) {
+      for (u64 queue = 0; queue < rss.queues; queue++) {
+        per_epoch.push_back(rss.epochs[epoch * rss.queues + queue].*field.field);
+      }
+      imbalance.push_back(get_rss_imbalance(rss.epochs.data() + epoch * rss.queues, rss.queues, field.field));
+    }
+
+    const std::string total_name(field.total_name);
+    const std::string epoch_name(field.epoch_name);
+    out.scalar(prefix + "imbalance." + total_name, get_rss_imbalance(rss.totals.data(), rss.queues, field.field));
+    out.column(prefix + "totals." + total_name, totals);
+    out.column(prefix + "epochs." + epoch_name, per_epoch);
+    out.column(prefix + "epochs.imbalance." + epoch_name, imbalance);
   }
+}
 
-  report.tcpudp_pkts++;
-  flows.insert(pkt.flow.value());
-  symm_flows.insert(pkt.flow.value());
-  concurrent_flows_per_epoch.back().insert(pkt.flow.value());
-  pkts_per_flow[pkt.flow.value()]++;
-  bytes_per_flow[pkt.flow.value()] += pkt.total_len;
-
-  auto flow_times_it = flow_times.find(pkt.flow.value());
-
-  if (flow_times_it == flow_times.end()) {
-    flow_times[pkt.flow.value()] = {
-        .first = pkt.ts,
-        .last  = pkt.ts,
-        .dts   = {},
-    };
-  } else {
-    flow_ts &fts       = flow_times_it->second;
-    const time_ns_t dt = pkt.ts - fts.last;
-    fts.last           = pkt.ts;
-    fts.dts.push_back(dt);
+void write_json_hhh_prefixes(JsonWriter &j, std::string_view name, const std::vector<hhh_prefix_t> &prefixes) {
+  j.key(name);
+  j.begin_array();
+  for (const hhh_prefix_t &prefix : prefixes) {
+    j.begin_object();
+    j.field("pkts", prefix.pkts);
+    j.field("prefix", std::string_view(ipv4_to_str(prefix.prefix) + "/" + std::to_string(prefix.prefix_size)));
+    j.field("residual_pkts", prefix.residual_pkts);
+    j.end_object();
+  }
+  j.end_array();
+}
+
+// Addresses in network byte order.
+void write_columnar_hhh_prefixes(ColumnarWriter &out, const std::string &name, const std::vector<hhh_prefix_t> &prefixes) {
+  std::vector<u32> addrs;
+  std::vector<u16> prefix_sizes;
+  std::vector<u64> pkts;
+  std::vector<u64> residual_pkts;
+  for (const hhh_prefix_t &prefix : prefixes) {
+    addrs.push_back(prefix.prefix);
+    prefix_sizes.push_back(prefix.prefix_size);
+    pkts.push_back(prefix.pkts);
+    residual_pkts.push_back(prefix.residual_pkts);
   }
+
+  out.column(name + ".prefixes", addrs);
+  out.column(name + ".prefix_sizes", prefix_sizes);
+  out.column(name + ".pkts", pkts);
+  out.column(name + ".residual_pkts", residual_pkts);
+}
+
+} // namespace
+
+void pkt_sizes_metric_t::on_packet(const packet_t &pkt, report_t &report) {
+  PROFILE_SCOPE(ProfileStage::CdfUpdate);
+  report.pkt_sizes_cdf.add(pkt.total_len);
+}
+
+void flows_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  PROFILE_SCOPE(ProfileStage::FlowStats);
+  flows_rehashes.track(flows, [&]() { flows.insert(flow); });
+}
+
+void flows_metric_t::fill_report(report_t &report) const { report.total_flows = flows.size(); }
+
+void flows_metric_t::reserve_flows(u64 flows_count) { flows.reserve(flows_count); }
+
+void flows_metric_t::get_table_stats(tracker_table_stats_t &stats, bool scan_all) const {
+  stats.flows = get_hash_table_stats(flows, flows_rehashes, scan_all);
+}
+
+void flows_metric_t::save(SnapshotWriter &out) const { ::save(out, flows); }
+
+void flows_metric_t::load(SnapshotReader &in) { ::load(in, flows); }
+
+void symm_flows_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  PROFILE_SCOPE(ProfileStage::FlowStats);
+  symm_flows_rehashes.track(symm_flows, [&]() { symm_flows.insert(flow); });
+}
+
+void symm_flows_metric_t::fill_report(report_t &report) const { report.total_symm_flows = symm_flows.size(); }
+
+void symm_flows_metric_t::reserve_flows(u64 flows_count) { symm_flows.reserve(flows_count); }
+
+void symm_flows_metric_t::get_table_stats(tracker_table_stats_t &stats, bool scan_all) const {
+  stats.symm_flows = get_hash_table_stats(symm_flows, symm_flows_rehashes, scan_all);
+}
+
+void symm_flows_metric_t::save(SnapshotWriter &out) const { ::save(out, symm_flows); }
+
+void symm_flows_metric_t::load(SnapshotReader &in) { ::load(in, symm_flows); }
+
+void churn_metric_t::on_epoch_rollover() {
+  expired_flows_per_epoch.emplace_back();
+  new_flows_per_epoch.emplace_back();
 }
 
-void traffic_stats_tracker_t::generate_report() {
-  report.total_flows      = flows.size();
-  report.total_symm_flows = symm_flows.size();
+void churn_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  {
+    PROFILE_SCOPE(ProfileStage::Expiry);
+    expired_flows_per_epoch.back() += flow_tracker.expire_flows(pkt.ts);
+  }
 
-  for (const auto &flows : concurrent_flows_per_epoch) {
-    report.concurrent_flows_per_epoch.add(flows.size());
+  PROFILE_SCOPE(ProfileStage::FlowTracker);
+  if (!flow_tracker.has_flow(flow)) {
+    flow_tracker.add_flow(flow, pkt.ts);
+    new_flows_per_epoch.back()++;
   }
+  flow_tracker.record_packet(flow, pkt.ts, pkt.total_len);
+}
 
+void churn_metric_t::fill_report(report_t &report) const {
   for (size_t i = 0; i < expired_flows_per_epoch.size(); i++) {
-    report.epochs.push_back({
-        .expired_flows    = expired_flows_per_epoch[i],
-        .new_flows        = new_flows_per_epoch[i],
-        .concurrent_flows = concurrent_flows_per_epoch[i].size(),
-    });
+    report.epochs[i].expired_flows = expired_flows_per_epoch[i];
+    report.epochs[i].new_flows     = new_flows_per_epoch[i];
+  }
+}
+
+void churn_metric_t::reserve_flows(u64 flows_count) { flow_tracker.reserve(flows_count); }
+
+void churn_metric_t::get_table_stats(tracker_table_stats_t &stats, bool scan_all) const {
+  stats.flow_tracker = flow_tracker.get_table_stats(scan_all);
+}
+
+void churn_metric_t::save(SnapshotWriter &out) const {
+  ::save(out, expired_flows_per_epoch);
+  ::save(out, new_flows_per_epoch);
+  flow_tracker.save(out);
+}
+
+void churn_metric_t::load(SnapshotReader &in) {
+  ::load(in, expired_flows_per_epoch);
+  ::load(in, new_flows_per_epoch);
+  flow_tracker.load(in);
+}
+
+void concurrency_metric_t::on_epoch_rollover() {
+  concurrent_flows_per_epoch.push_back(concurrent_flows.size());
+  concurrent_flows.clear();
+}
+
+void concurrency_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  PROFILE_SCOPE(ProfileStage::FlowStats);
+  concurrent_flows_rehashes.track(concurrent_flows, [&]() { concurrent_flows.insert(flow); });
+}
+
+void concurrency_metric_t::fill_report(report_t &report) const {
+  // The last epoch never rolled over.
+  for (size_t i = 0; i < report.epochs.size(); i++) {
+    const u64 concurrent = i < concurrent_flows_per_epoch.size() ? concurrent_flows_per_epoch[i] : concurrent_flows.size();
+    report.concurrent_flows_per_epoch.add(concurrent);
+    report.epochs[i].concurrent_flows = concurrent;
   }
+}
+
+void concurrency_metric_t::reserve_flows(u64 flows_count) { concurrent_flows.reserve(flows_count); }
+
+void concurrency_metric_t::get_table_stats(tracker_table_stats_t &stats, bool scan_all) const {
+  stats.concurrent_flows = get_hash_table_stats(concurrent_flows, concurrent_flows_rehashes, scan_all);
+}
+
+void concurrency_metric_t::save(SnapshotWriter &out) const {
+  ::save(out, concurrent_flows);
+  ::save(out, concurrent_flows_per_epoch);
+}
+
+void concurrency_metric_t::load(SnapshotReader &in) {
+  ::load(in, concurrent_flows);
+  ::load(in, concurrent_flows_per_epoch);
+}
+
+void flow_sizes_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  PROFILE_SCOPE(ProfileStage::FlowStats);
+  pkts_per_flow_rehashes.track(pkts_per_flow, [&]() { pkts_per_flow[flow]++; });
+  bytes_per_flow_rehashes.track(bytes_per_flow, [&]() { bytes_per_flow[flow] += pkt.total_len; });
+}
 
+void flow_sizes_metric_t::fill_report(report_t &report) const {
   std::vector<u64> pkts_per_flow_values;
   std::vector<u64> bytes_per_flow_values;
 
-  for (const auto &[flow, pkts] : pkts_per_flow) {
+  pkts_per_flow.for_each([&](const flow_t &flow, u64 pkts) {
     report.pkts_per_flow_cdf.add(pkts);
     pkts_per_flow_values.push_back(pkts);
-  }
+  });
 
-  for (const auto &[flow, bytes] : bytes_per_flow) {
-    bytes_per_flow_values.push_back(bytes);
-  }
+  bytes_per_flow.for_each([&](const flow_t &flow, u64 bytes) { bytes_per_flow_values.push_back(bytes); });
 
   assert(pkts_per_flow_values.size() == bytes_per_flow_values.size());
 
@@ -97,93 +428,708 @@ void traffic_stats_tracker_t::generate_report() {
     report.top_k_flows_cdf.add(i + 1, pkts_per_flow_values[i]);
     report.top_k_flows_bytes_cdf.add(i + 1, bytes_per_flow_values[i]);
   }
+}
+
+void flow_sizes_metric_t::reserve_flows(u64 flows_count) {
+  pkts_per_flow.reserve(flows_count);
+  bytes_per_flow.reserve(flows_count);
+}
+
+void flow_sizes_metric_t::get_table_stats(tracker_table_stats_t &stats, bool scan_all) const {
+  stats.pkts_per_flow  = get_hash_table_stats(pkts_per_flow, pkts_per_flow_rehashes, scan_all);
+  stats.bytes_per_flow = get_hash_table_stats(bytes_per_flow, bytes_per_flow_rehashes, scan_all);
+}
+
+void flow_sizes_metric_t::save(SnapshotWriter &out) const {
+  ::save(out, pkts_per_flow);
+  ::save(out, bytes_per_flow);
+}
+
+void flow_sizes_metric_t::load(SnapshotReader &in) {
+  ::load(in, pkts_per_flow);
+  ::load(in, bytes_per_flow);
+}
+
+void flow_times_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  PROFILE_SCOPE(ProfileStage::FlowStats);
+  flow_ts *fts = flow_times.find(flow);
+
+  if (!fts) {
+    flow_times_rehashes.track(flow_times, [&]() {
+      flow_times[flow] = {
+          .first      = pkt.ts,
+          .last       = pkt.ts,
+          .dts_us_sum = 0,
+          .dts        = 0,
+      };
+    });
+  } else {
+    const time_ns_t dt = pkt.ts - fts->last;
+    fts->last          = pkt.ts;
+    fts->dts_us_sum += dt / THOUSAND;
+    fts->dts++;
+  }
+}
 
-  for (const auto &[flow, ts] : flow_times) {
+void flow_times_metric_t::fill_report(report_t &report) const {
+  flow_times.for_each([&](const flow_t &flow, const flow_ts &ts) {
     report.flow_duration_us_cdf.add((ts.last - ts.first) / THOUSAND);
 
-    if (ts.dts.empty()) {
-      continue;
-    }
-
-    time_us_t dt_sum = 0;
-    for (const auto &dt : ts.dts) {
-      dt_sum += dt / THOUSAND;
-    }
-    report.flow_dts_us_cdf.add(dt_sum / (double)ts.dts.size());
-  }
-}
-
-void traffic_stats_tracker_t::dump_report_to_json_file(const std::filesystem::path &json_output_report) const {
-  json j;
-  j["start_utc_ns"]                   = report.start;
-  j["end_utc_ns"]                     = report.end;
-  j["total_pkts"]                     = report.total_pkts;
-  j["total_bytes"]                    = report.total_bytes;
-  j["tcpudp_pkts"]                    = report.tcpudp_pkts;
-  j["pkt_bytes_avg"]                  = report.pkt_sizes_cdf.get_avg();
-  j["pkt_bytes_stdev"]                = report.pkt_sizes_cdf.get_stdev();
-  j["pkt_bytes_cdf"]                  = json();
-  j["pkt_bytes_cdf"]["values"]        = json::array();
-  j["pkt_bytes_cdf"]["probabilities"] = json::array();
-  for (const auto &[v, p] : report.pkt_sizes_cdf.get_cdf()) {
-    j["pkt_bytes_cdf"]["values"].push_back(v);
-    j["pkt_bytes_cdf"]["probabilities"].push_back(p);
-  }
-  j["total_flows"]                        = report.total_flows;
-  j["total_symm_flows"]                   = report.total_symm_flows;
-  j["pkts_per_flow_avg"]                  = report.pkts_per_flow_cdf.get_avg();
-  j["pkts_per_flow_stdev"]                = report.pkts_per_flow_cdf.get_stdev();
-  j["pkts_per_flow_cdf"]                  = json();
-  j["pkts_per_flow_cdf"]["values"]        = json::array();
-  j["pkts_per_flow_cdf"]["probabilities"] = json::array();
-  for (const auto &[v, p] : report.pkts_per_flow_cdf.get_cdf()) {
-    j["pkts_per_flow_cdf"]["values"].push_back(v);
-    j["pkts_per_flow_cdf"]["probabilities"].push_back(p);
-  }
-  j["flow_duration_us_avg"]                  = report.flow_duration_us_cdf.get_avg();
-  j["flow_duration_us_stdev"]                = report.flow_duration_us_cdf.get_stdev();
-  j["flow_duration_us_cdf"]                  = json();
-  j["flow_duration_us_cdf"]["values"]        = json::array();
-  j["flow_duration_us_cdf"]["probabilities"] = json::array();
-  for (const auto &[v, p] : report.flow_duration_us_cdf.get_cdf()) {
-    j["flow_duration_us_cdf"]["values"].push_back(v);
-    j["flow_duration_us_cdf"]["probabilities"].push_back(p);
-  }
-  j["flow_dts_us_avg"]                  = report.flow_dts_us_cdf.get_avg();
-  j["flow_dts_us_stdev"]                = report.flow_dts_us_cdf.get_stdev();
-  j["flow_dts_us_cdf"]                  = json();
-  j["flow_dts_us_cdf"]["values"]        = json::array();
-  j["flow_dts_us_cdf"]["probabilities"] = json::array();
-  for (const auto &[v, p] : report.flow_dts_us_cdf.get_cdf()) {
-    j["flow_dts_us_cdf"]["values"].push_back(v);
-    j["flow_dts_us_cdf"]["probabilities"].push_back(p);
-  }
-  j["top_k_flows_cdf"]                  = json();
-  j["top_k_flows_cdf"]["values"]        = json::array();
-  j["top_k_flows_cdf"]["probabilities"] = json::array();
-  for (const auto &[v, p] : report.top_k_flows_cdf.get_cdf()) {
-    j["top_k_flows_cdf"]["values"].push_back(v);
-    j["top_k_flows_cdf"]["probabilities"].push_back(p);
-  }
-  j["top_k_flows_bytes_cdf"]                  = json();
-  j["top_k_flows_bytes_cdf"]["values"]        = json::array();
-  j["top_k_flows_bytes_cdf"]["probabilities"] = json::array();
-  for (const auto &[v, p] : report.top_k_flows_bytes_cdf.get_cdf()) {
-    j["top_k_flows_bytes_cdf"]["values"].push_back(v);
-    j["top_k_flows_bytes_cdf"]["probabilities"].push_back(p);
-  }
-  j["epochs"] = json::array();
-  for (const auto &epoch : report.epochs) {
-    json je;
-    je["expired_flows"]    = epoch.expired_flows;
-    je["new_flows"]        = epoch.new_flows;
-    je["concurrent_flows"] = epoch.concurrent_flows;
-    j["epochs"].push_back(je);
+    if (ts.dts == 0) {
+      return;
+    }
+
+    report.flow_dts_us_cdf.add(ts.dts_us_sum / (double)ts.dts);
+  });
+}
+
+void flow_times_metric_t::reserve_flows(u64 flows_count) { flow_times.reserve(flows_count); }
+
+void flow_times_metric_t::get_table_stats(tracker_table_stats_t &stats, bool scan_all) const {
+  stats.flow_times = get_hash_table_stats(flow_times, flow_times_rehashes, scan_all);
+}
+
+void flow_times_metric_t::save(SnapshotWriter &out) const { ::save(out, flow_times); }
+
+void flow_times_metric_t::load(SnapshotReader &in) { ::load(in, flow_times); }
+
+void flow_cache_metric_t::set_enabled(bool enabled) {
+  if (!enabled) {
+    reuse_distances.reset();
+  } else if (!reuse_distances) {
+    reuse_distances = std::make_unique<ReuseDistanceTracker>();
+  }
+}
+
+void flow_cache_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  if (!reuse_distances) {
+    return;
+  }
+
+  PROFILE_SCOPE(ProfileStage::FlowCache);
+  reuse_distances->access(flow);
+}
+
+void flow_cache_metric_t::fill_report(report_t &report) const {
+  if (!reuse_distances) {
+    return;
+  }
+
+  report.flow_cache_accesses         = reuse_distances->get_accesses();
+  report.flow_cache_cold_misses      = reuse_distances->get_cold_misses();
+  report.flow_cache_miss_ratio_curve = reuse_distances->get_miss_ratio_curve();
+}
+
+void flow_cache_metric_t::save(SnapshotWriter &out) const {
+  if (reuse_distances) {
+    reuse_distances->save(out);
+  }
+}
+
+void flow_cache_metric_t::load(SnapshotReader &in) {
+  if (reuse_distances) {
+    reuse_distances->load(in);
+  }
+}
+
+void flow_tables_metric_t::set_enabled(bool enabled) {
+  if (!enabled) {
+    flow_table_simulator.reset();
+  } else if (!flow_table_simulator) {
+    flow_table_simulator = std::make_unique<FlowTableSimulator>();
+  }
+}
+
+void flow_tables_metric_t::on_packet(const packet_t &pkt, report_t &report) { now = pkt.ts; }
+
+void flow_tables_metric_t::on_epoch_rollover() {
+  if (flow_table_simulator) {
+    PROFILE_SCOPE(ProfileStage::FlowTables);
+    flow_table_simulator->on_epoch_rollover(now);
+  }
+}
+
+void flow_tables_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  if (!flow_table_simulator) {
+    return;
+  }
+
+  PROFILE_SCOPE(ProfileStage::FlowTables);
+  flow_table_simulator->access(flow, now);
+}
+
+void flow_tables_metric_t::fill_report(report_t &report) const {
+  if (flow_table_simulator) {
+    report.flow_tables = flow_table_simulator->get_reports(now);
   }
+}
+
+void flow_tables_metric_t::save(SnapshotWriter &out) const {
+  if (flow_table_simulator) {
+    ::save(out, now);
+    flow_table_simulator->save(out);
+  }
+}
+
+void flow_tables_metric_t::load(SnapshotReader &in) {
+  if (flow_table_simulator) {
+    ::load(in, now);
+    flow_table_simulator->load(in);
+  }
+}
+
+void rss_metric_t::set_enabled(bool enabled) {
+  if (!enabled) {
+    rss_simulator.reset();
+  } else if (!rss_simulator) {
+    rss_simulator = std::make_unique<RssSimulator>();
+  }
+}
+
+void rss_metric_t::on_epoch_rollover() {
+  if (rss_simulator) {
+    PROFILE_SCOPE(ProfileStage::Rss);
+    rss_simulator->on_epoch_rollover();
+  }
+}
+
+void rss_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  if (!rss_simulator) {
+    return;
+  }
+
+  PROFILE_SCOPE(ProfileStage::Rss);
+  rss_simulator->access(flow, pkt.total_len);
+}
+
+void rss_metric_t::fill_report(report_t &report) const {
+  if (rss_simulator) {
+    report.rss = rss_simulator->get_reports();
+  }
+}
+
+void rss_metric_t::save(SnapshotWriter &out) const {
+  if (rss_simulator) {
+    rss_simulator->save(out);
+  }
+}
+
+void rss_metric_t::load(SnapshotReader &in) {
+  if (rss_simulator) {
+    rss_simulator->load(in);
+  }
+}
+
+void hhh_metric_t::set_enabled(bool enabled) {
+  if (!enabled) {
+    heavy_hitters.reset();
+  } else if (!heavy_hitters) {
+    heavy_hitters = std::make_unique<HierarchicalHeavyHitters>();
+  }
+}
+
+void hhh_metric_t::on_epoch_rollover() {
+  if (heavy_hitters) {
+    PROFILE_SCOPE(ProfileStage::Hhh);
+    heavy_hitters->on_epoch_rollover();
+  }
+}
+
+void hhh_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  if (!heavy_hitters) {
+    return;
+  }
+
+  PROFILE_SCOPE(ProfileStage::Hhh);
+  heavy_hitters->access(flow);
+}
+
+void hhh_metric_t::fill_report(report_t &report) const {
+  if (!heavy_hitters) {
+    return;
+  }
+
+  report.hhh_threshold = heavy_hitters->get_threshold();
+  report.hhh           = heavy_hitters->get_report();
+  report.hhh_epochs    = heavy_hitters->get_epoch_reports();
+}
+
+void hhh_metric_t::save(SnapshotWriter &out) const {
+  if (heavy_hitters) {
+    heavy_hitters->save(out);
+  }
+}
+
+void hhh_metric_t::load(SnapshotReader &in) {
+  if (heavy_hitters) {
+    heavy_hitters->load(in);
+  }
+}
+
+void entropy_metric_t::set_enabled(bool enabled) {
+  if (!enabled) {
+    entropy_estimator.reset();
+  } else if (!entropy_estimator) {
+    entropy_estimator = std::make_unique<FlowEntropyEstimator>();
+  }
+}
+
+void entropy_metric_t::on_epoch_rollover() {
+  if (entropy_estimator) {
+    PROFILE_SCOPE(ProfileStage::Entropy);
+    entropy_estimator->on_epoch_rollover();
+  }
+}
+
+void entropy_metric_t::on_flow_packet(const flow_t &flow, const packet_t &pkt) {
+  if (!entropy_estimator) {
+    return;
+  }
+
+  PROFILE_SCOPE(ProfileStage::Entropy);
+  entropy_estimator->access(flow);
+}
+
+void entropy_metric_t::fill_report(report_t &report) const {
+  if (!entropy_estimator) {
+    return;
+  }
+
+  const std::vector<flow_entropy_t> entropies = entropy_estimator->get_epoch_reports();
+  for (size_t i = 0; i < report.epochs.size() && i < entropies.size(); i++) {
+    report.epochs[i].src_ip_entropy   = entropies[i].src_ip;
+    report.epochs[i].dst_ip_entropy   = entropies[i].dst_ip;
+    report.epochs[i].src_port_entropy = entropies[i].src_port;
+    report.epochs[i].dst_port_entropy = entropies[i].dst_port;
+  }
+}
+
+void entropy_metric_t::save(SnapshotWriter &out) const {
+  if (entropy_estimator) {
+    entropy_estimator->save(out);
+  }
+}
+
+void entropy_metric_t::load(SnapshotReader &in) {
+  if (entropy_estimator) {
+    entropy_estimator->load(in);
+  }
+}
+
+template <typename... Metrics> HOT_KERNEL void basic_traffic_stats_tracker_t<Metrics...>::feed_packet(const packet_t &pkt) {
+  ALLOC_TRACKING_SCOPE();
+  PROFILE_PACKET_SCOPE();
+  PROFILE_HW_SCOPE(HwCounterStage::Tracker);
+  PROBE_PACKET_INGEST(pkt.ts, pkt.total_len, pkt.flow.has_value());
+
+  report.end = pkt.ts;
+  if (report.start == 0) {
+    report.start = pkt.ts;
+  }
+
+  report.total_pkts++;
+  report.total_bytes += pkt.total_len;
+
+  (this->Metrics::on_packet(pkt, report), ...);
+
+  {
+    PROFILE_SCOPE(ProfileStage::EpochRollover);
+    if (clock.tick(pkt.ts)) {
+      if (collect_table_stats) {
+        report.table_stats_per_epoch.push_back(get_table_stats(false));
+      }
+      (this->Metrics::on_epoch_rollover(), ...);
+      epochs++;
+      PROBE_EPOCH_ROLLOVER(pkt.ts, epochs - 1);
+    }
+  }
+
+  if (!pkt.flow.has_value()) {
+    return;
+  }
+
+  report.tcpudp_pkts++;
+
+  // The per-flow tables are accounted as FlowStats, the churn policy splits its own work into Expiry and FlowTracker.
+  (this->Metrics::on_flow_packet(pkt.flow.value(), pkt), ...);
+}
+
+template <typename... Metrics> tracker_table_stats_t basic_traffic_stats_tracker_t<Metrics...>::get_table_stats(bool scan_all) const {
+  tracker_table_stats_t stats{};
+  (this->Metrics::get_table_stats(stats, scan_all), ...);
+  return stats;
+}
+
+template <typename... Metrics> void basic_traffic_stats_tracker_t<Metrics...>::generate_report() {
+  if (collect_table_stats) {
+    // The last epoch never rolled over.
+    report.table_stats_per_epoch.push_back(get_table_stats(false));
+    report.final_table_stats = get_table_stats(true);
+  }
+
+  report.epochs.assign(epochs, epoch_t{});
+  (this->Metrics::fill_report(report), ...);
+}
+
+void report_t::save(SnapshotWriter &out) const {
+  ::save(out, start);
+  ::save(out, end);
+  ::save(out, total_pkts);
+  ::save(out, total_bytes);
+  ::save(out, tcpudp_pkts);
+  pkt_sizes_cdf.save(out);
+  ::save(out, total_flows);
+  ::save(out, total_symm_flows);
+  concurrent_flows_per_epoch.save(out);
+  pkts_per_flow_cdf.save(out);
+  top_k_flows_cdf.save(out);
+  top_k_flows_bytes_cdf.save(out);
+  flow_duration_us_cdf.save(out);
+  flow_dts_us_cdf.save(out);
+  ::save(out, epochs);
+  ::save(out, flow_cache_accesses);
+  ::save(out, flow_cache_cold_misses);
+  ::save(out, flow_cache_miss_ratio_curve);
+  ::save(out, flow_tables);
+  ::save(out, rss);
+  ::save(out, hhh_threshold);
+  ::save(out, hhh);
+  ::save(out, hhh_epochs);
+  ::save(out, table_stats_per_epoch);
+}
+
+void report_t::load(SnapshotReader &in) {
+  ::load(in, start);
+  ::load(in, end);
+  ::load(in, total_pkts);
+  ::load(in, total_bytes);
+  ::load(in, tcpudp_pkts);
+  pkt_sizes_cdf.load(in);
+  ::load(in, total_flows);
+  ::load(in, total_symm_flows);
+  concurrent_flows_per_epoch.load(in);
+  pkts_per_flow_cdf.load(in);
+  top_k_flows_cdf.load(in);
+  top_k_flows_bytes_cdf.load(in);
+  flow_duration_us_cdf.load(in);
+  flow_dts_us_cdf.load(in);
+  ::load(in, epochs);
+  ::load(in, flow_cache_accesses);
+  ::load(in, flow_cache_cold_misses);
+  ::load(in, flow_cache_miss_ratio_curve);
+  ::load(in, flow_tables);
+  ::load(in, rss);
+  ::load(in, hhh_threshold);
+  ::load(in, hhh);
+  ::load(in, hhh_epochs);
+  ::load(in, table_stats_per_epoch);
+}
+
+template <typename... Metrics> void basic_traffic_stats_tracker_t<Metrics...>::save(SnapshotWriter &out) const {
+  clock.save(out);
+  ::save(out, epochs);
+  (this->Metrics::save(out), ...);
+  report.save(out);
+}
 
+template <typename... Metrics> void basic_traffic_stats_tracker_t<Metrics...>::load(SnapshotReader &in) {
+  clock.load(in);
+  ::load(in, epochs);
+  (this->Metrics::load(in), ...);
+  report.load(in);
+}
+
+// Every tracker of traffic_stats_tracker_instantiations_t.
+template struct basic_traffic_stats_tracker_t<pkt_sizes_metric_t>;
+template struct basic_traffic_stats_tracker_t<churn_metric_t>;
+template struct basic_traffic_stats_tracker_t<pkt_sizes_metric_t, flows_metric_t, symm_flows_metric_t>;
+template struct basic_traffic_stats_tracker_t<pkt_sizes_metric_t, churn_metric_t>;
+template struct basic_traffic_stats_tracker_t<churn_metric_t, concurrency_metric_t>;
+template struct basic_traffic_stats_tracker_t<flows_metric_t, flow_sizes_metric_t>;
+template struct basic_traffic_stats_tracker_t<flows_metric_t, flow_times_metric_t>;
+template struct basic_traffic_stats_tracker_t<pkt_sizes_metric_t, flows_metric_t, symm_flows_metric_t, churn_metric_t, concurrency_metric_t,
+                                              flow_sizes_metric_t, flow_times_metric_t>;
+template struct basic_traffic_stats_tracker_t<pkt_sizes_metric_t, flows_metric_t, symm_flows_metric_t, churn_metric_t, concurrency_metric_t,
+                                              flow_sizes_metric_t, flow_times_metric_t, flow_cache_metric_t, flow_tables_metric_t,
+                                              rss_metric_t, hhh_metric_t, entropy_metric_t>;
+
+void dump_report_to_json_file(const report_t &report, bool table_stats, const std::filesystem::path &json_output_report) {
   fprintf(stderr, "\n");
   fprintf(stderr, "Dumping report to %s\n", json_output_report.c_str());
 
-  std::ofstream out(json_output_report);
-  out << j.dump(2) << std::endl;
-}
\ No newline at end of file
+  FILE *out = fopen(json_output_report.c_str(), "w");
+  if (!out) {
+    perror("fopen");
+    panic("Failed to open %s for writing", json_output_report.c_str());
+  }
+
+  std::vector<char> out_buffer(JSON_OUTPUT_BUFFER_SIZE);
+  setvbuf(out, out_buffer.data(), _IOFBF, out_buffer.size());
+
+  const bool churn       = has_metric(report.metrics, Metric::Churn);
+  const bool concurrency = has_metric(report.metrics, Metric::Concurrency);
+  const bool entropy     = has_metric(report.metrics, Metric::Entropy);
+  const bool flow_cache  = has_metric(report.metrics, Metric::FlowCache);
+  const bool flow_tables = has_metric(report.metrics, Metric::FlowTables);
+  const bool flow_sizes  = has_metric(report.metrics, Metric::FlowSizes);
+  const bool flow_times  = has_metric(report.metrics, Metric::FlowTimes);
+  const bool hhh         = has_metric(report.metrics, Metric::Hhh);
+  const bool pkt_sizes   = has_metric(report.metrics, Metric::PktSizes);
+  const bool rss         = has_metric(report.metrics, Metric::Rss);
+
+  // Keys are emitted in lexicographic order, matching the layout of the previous nlohmann::json based dump.
+  JsonWriter j(out);
+  j.begin_object();
+  j.field("end_utc_ns", report.end);
+  if (churn || concurrency || entropy) {
+    j.key("epochs");
+    j.begin_array();
+    for (const epoch_t &epoch : report.epochs) {
+      j.begin_object();
+      if (concurrency) {
+        j.field("concurrent_flows", epoch.concurrent_flows);
+      }
+      if (entropy) {
+        j.field("dst_ip_entropy", epoch.dst_ip_entropy);
+        j.field("dst_port_entropy", epoch.dst_port_entropy);
+      }
+      if (churn) {
+        j.field("expired_flows", epoch.expired_flows);
+        j.field("new_flows", epoch.new_flows);
+      }
+      if (entropy) {
+        j.field("src_ip_entropy", epoch.src_ip_entropy);
+        j.field("src_port_entropy", epoch.src_port_entropy);
+      }
+      j.end_object();
+    }
+    j.end_array();
+  }
+  if (flow_cache) {
+    j.key("flow_cache");
+    j.begin_object();
+    j.field("accesses", report.flow_cache_accesses);
+    j.key("capacities");
+    j.begin_array();
+    for (const miss_ratio_point_t &point : report.flow_cache_miss_ratio_curve) {
+      j.value(point.capacity);
+    }
+    j.end_array();
+    j.field("cold_misses", report.flow_cache_cold_misses);
+    j.key("miss_ratios");
+    j.begin_array();
+    for (const miss_ratio_point_t &point : report.flow_cache_miss_ratio_curve) {
+      j.value(point.miss_ratio);
+    }
+    j.end_array();
+    j.end_object();
+  }
+  if (flow_times) {
+    j.field("flow_dts_us_avg", report.flow_dts_us_cdf.get_avg());
+    write_json_cdf(j, "flow_dts_us_cdf", report.flow_dts_us_cdf);
+    j.field("flow_dts_us_stdev", report.flow_dts_us_cdf.get_stdev());
+    j.field("flow_duration_us_avg", report.flow_duration_us_cdf.get_avg());
+    write_json_cdf(j, "flow_duration_us_cdf", report.flow_duration_us_cdf);
+    j.field("flow_duration_us_stdev", report.flow_duration_us_cdf.get_stdev());
+  }
+  if (flow_tables) {
+    j.key("flow_tables");
+    j.begin_array();
+    for (const flow_table_report_t &table : report.flow_tables) {
+      write_json_flow_table(j, table);
+    }
+    j.end_array();
+  }
+  if (table_stats) {
+    j.key("hash_tables");
+    j.begin_object();
+    j.key("epochs");
+    j.begin_array();
+    for (const tracker_table_stats_t &stats : report.table_stats_per_epoch) {
+      write_json_tracker_table_stats(j, stats, report.metrics);
+    }
+    j.end_array();
+    j.key("final");
+    write_json_tracker_table_stats(j, report.final_table_stats, report.metrics);
+    j.end_object();
+  }
+  if (hhh) {
+    j.key("hhh");
+    j.begin_object();
+    write_json_hhh_prefixes(j, "dst", report.hhh.dst);
+    j.key("epochs");
+    j.begin_array();
+    for (const hhh_report_t &epoch : report.hhh_epochs) {
+      j.begin_object();
+      write_json_hhh_prefixes(j, "dst", epoch.dst);
+      j.field("pkts", epoch.pkts);
+      write_json_hhh_prefixes(j, "src", epoch.src);
+      j.end_object();
+    }
+    j.end_array();
+    j.field("pkts", report.hhh.pkts);
+    write_json_hhh_prefixes(j, "src", report.hhh.src);
+    j.field("threshold", report.hhh_threshold);
+    j.end_object();
+  }
+  if (pkt_sizes) {
+    j.field("pkt_bytes_avg", report.pkt_sizes_cdf.get_avg());
+    write_json_cdf(j, "pkt_bytes_cdf", report.pkt_sizes_cdf);
+    j.field("pkt_bytes_stdev", report.pkt_sizes_cdf.get_stdev());
+  }
+  if (flow_sizes) {
+    j.field("pkts_per_flow_avg", report.pkts_per_flow_cdf.get_avg());
+    write_json_cdf(j, "pkts_per_flow_cdf", report.pkts_per_flow_cdf);
+    j.field("pkts_per_flow_stdev", report.pkts_per_flow_cdf.get_stdev());
+  }
+  if (rss) {
+    j.key("rss");
+    j.begin_array();
+    for (const rss_report_t &queues : report.rss) {
+      write_json_rss(j, queues);
+    }
+    j.end_array();
+  }
+  j.field("start_utc_ns", report.start);
+  j.field("tcpudp_pkts", report.tcpudp_pkts);
+  if (flow_sizes) {
+    write_json_cdf(j, "top_k_flows_bytes_cdf", report.top_k_flows_bytes_cdf);
+    write_json_cdf(j, "top_k_flows_cdf", report.top_k_flows_cdf);
+  }
+  j.field("total_bytes", report.total_bytes);
+  if (has_metric(report.metrics, Metric::Flows)) {
+    j.field("total_flows", report.total_flows);
+  }
+  j.field("total_pkts", report.total_pkts);
+  if (has_metric(report.metrics, Metric::SymmFlows)) {
+    j.field("total_symm_flows", report.total_symm_flows);
+  }
+  j.end_object();
+  j.finish();
+
+  fclose(out);
+}
+
+void dump_report_to_bin_file(const report_t &report, const std::filesystem::path &bin_output_report) {
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Dumping binary report to %s\n", bin_output_report.c_str());
+
+  ColumnarWriter out(bin_output_report);
+
+  out.scalar("start_utc_ns", report.start);
+  out.scalar("end_utc_ns", report.end);
+  out.scalar("total_pkts", report.total_pkts);
+  out.scalar("total_bytes", report.total_bytes);
+  out.scalar("tcpudp_pkts", report.tcpudp_pkts);
+  if (has_metric(report.metrics, Metric::PktSizes)) {
+    out.scalar("pkt_bytes_avg", report.pkt_sizes_cdf.get_avg());
+    out.scalar("pkt_bytes_stdev", report.pkt_sizes_cdf.get_stdev());
+    write_columnar_cdf(out, "pkt_bytes_cdf", report.pkt_sizes_cdf);
+  }
+  if (has_metric(report.metrics, Metric::Flows)) {
+    out.scalar("total_flows", report.total_flows);
+  }
+  if (has_metric(report.metrics, Metric::SymmFlows)) {
+    out.scalar("total_symm_flows", report.total_symm_flows);
+  }
+  if (has_metric(report.metrics, Metric::FlowSizes)) {
+    out.scalar("pkts_per_flow_avg", report.pkts_per_flow_cdf.get_avg());
+    out.scalar("pkts_per_flow_stdev", report.pkts_per_flow_cdf.get_stdev());
+    write_columnar_cdf(out, "pkts_per_flow_cdf", report.pkts_per_flow_cdf);
+  }
+  if (has_metric(report.metrics, Metric::FlowTimes)) {
+    out.scalar("flow_duration_us_avg", report.flow_duration_us_cdf.get_avg());
+    out.scalar("flow_duration_us_stdev", report.flow_duration_us_cdf.get_stdev());
+    write_columnar_cdf(out, "flow_duration_us_cdf", report.flow_duration_us_cdf);
+    out.scalar("flow_dts_us_avg", report.flow_dts_us_cdf.get_avg());
+    out.scalar("flow_dts_us_stdev", report.flow_dts_us_cdf.get_stdev());
+    write_columnar_cdf(out, "flow_dts_us_cdf", report.flow_dts_us_cdf);
+  }
+  if (has_metric(report.metrics, Metric::FlowSizes)) {
+    write_columnar_cdf(out, "top_k_flows_cdf", report.top_k_flows_cdf);
+    write_columnar_cdf(out, "top_k_flows_bytes_cdf", report.top_k_flows_bytes_cdf);
+  }
+  if (has_metric(report.metrics, Metric::FlowTables)) {
+    for (const flow_table_report_t &table : report.flow_tables) {
+      write_columnar_flow_table(out, table);
+    }
+  }
+  if (has_metric(report.metrics, Metric::Rss)) {
+    for (const rss_report_t &queues : report.rss) {
+      write_columnar_rss(out, queues);
+    }
+  }
+  if (has_metric(report.metrics, Metric::Hhh)) {
+    std::vector<u64> epoch_pkts;
+    std::vector<u64> epoch_src_counts;
+    std::vector<u64> epoch_dst_counts;
+    std::vector<hhh_prefix_t> epoch_src;
+    std::vector<hhh_prefix_t> epoch_dst;
+    for (const hhh_report_t &epoch : report.hhh_epochs) {
+      epoch_pkts.push_back(epoch.pkts);
+      epoch_src_counts.push_back(epoch.src.size());
+      epoch_dst_counts.push_back(epoch.dst.size());
+      epoch_src.insert(epoch_src.end(), epoch.src.begin(), epoch.src.end());
+      epoch_dst.insert(epoch_dst.end(), epoch.dst.begin(), epoch.dst.end());
+    }
+
+    out.scalar("hhh.threshold", report.hhh_threshold);
+    out.scalar("hhh.pkts", report.hhh.pkts);
+    write_columnar_hhh_prefixes(out, "hhh.src", report.hhh.src);
+    write_columnar_hhh_prefixes(out, "hhh.dst", report.hhh.dst);
+    out.column("hhh.epochs.pkts", epoch_pkts);
+    out.column("hhh.epochs.src.counts", epoch_src_counts);
+    out.column("hhh.epochs.dst.counts", epoch_dst_counts);
+    write_columnar_hhh_prefixes(out, "hhh.epochs.src", epoch_src);
+    write_columnar_hhh_prefixes(out, "hhh.epochs.dst", epoch_dst);
+  }
+  if (has_metric(report.metrics, Metric::FlowCache)) {
+    std::vector<u64> capacities;
+    std::vector<double> miss_ratios;
+    for (const miss_ratio_point_t &point : report.flow_cache_miss_ratio_curve) {
+      capacities.push_back(point.capacity);
+      miss_ratios.push_back(point.miss_ratio);
+    }
+    out.scalar("flow_cache.accesses", report.flow_cache_accesses);
+    out.scalar("flow_cache.cold_misses", report.flow_cache_cold_misses);
+    out.column("flow_cache.capacities", capacities);
+    out.column("flow_cache.miss_ratios", miss_ratios);
+  }
+
+  std::vector<u64> epoch_expired_flows;
+  std::vector<u64> epoch_new_flows;
+  std::vector<u64> epoch_concurrent_flows;
+  epoch_expired_flows.reserve(report.epochs.size());
+  epoch_new_flows.reserve(report.epochs.size());
+  epoch_concurrent_flows.reserve(report.epochs.size());
+  for (const epoch_t &epoch : report.epochs) {
+    epoch_expired_flows.push_back(epoch.expired_flows);
+    epoch_new_flows.push_back(epoch.new_flows);
+    epoch_concurrent_flows.push_back(epoch.concurrent_flows);
+  }
+  if (has_metric(report.metrics, Metric::Churn)) {
+    out.column("epochs.expired_flows", epoch_expired_flows);
+    out.column("epochs.new_flows", epoch_new_flows);
+  }
+  if (has_metric(report.metrics, Metric::Concurrency)) {
+    out.column("epochs.concurrent_flows", epoch_concurrent_flows);
+  }
+  if (has_metric(report.metrics, Metric::Entropy)) {
+    std::vector<double> epoch_src_ip_entropy;
+    std::vector<double> epoch_dst_ip_entropy;
+    std::vector<double> epoch_src_port_entropy;
+    std::vector<double> epoch_dst_port_entropy;
+    for (const epoch_t &epoch : report.epochs) {
+      epoch_src_ip_entropy.push_back(epoch.src_ip_entropy);
+      epoch_dst_ip_entropy.push_back(epoch.dst_ip_entropy);
+      epoch_src_port_entropy.push_back(epoch.src_port_entropy);
+      epoch_dst_port_entropy.push_back(epoch.dst_port_entropy);
+    }
+    out.column("epochs.src_ip_entropy", epoch_src_ip_entropy);
+    out.column("epochs.dst_ip_entropy", epoch_dst_ip_entropy);
+    out.column("epochs.src_port_entropy", epoch_src_port_entropy);
+    out.column("epochs.dst_port_entropy", epoch_dst_port_entropy);
+  }
+
+  out.close();
+}
@@ -5,22 +5,54 @@
 #include "clock.h"
 #include "cdf.h"
 #include "flow_tracker.h"
+#include "snapshot.h"
+#include "hash_table_stats.h"
+#include "incremental_hash_table.h"
+#include "metrics.h"
+#include "reuse_distance.h"
+#include "flow_table_sim.h"
+#include "rss_sim.h"
+#include "heavy_hitters.h"
+#include "entropy_sketch.h"
 
 #include <filesystem>
+#include <memory>
+#include <tuple>
+#include <type_traits>
 #include <vector>
-#include <unordered_set>
-#include <unordered_map>
 
+// Inter-packet gaps are only ever averaged, so they are summed as they come instead of being kept (each one truncated to microseconds,
+// as the report always did).
 struct flow_ts {
   time_ns_t first;
   time_ns_t last;
-  std::vector<time_ns_t> dts;
+  time_us_t dts_us_sum;
+  u64 dts;
 };
 
+// Per epoch counters are reserved up front for this many epochs (18 hours of 1s epochs), past that they grow as usual.
+constexpr const u64 TRACKER_RESERVED_EPOCHS = 1 << 16;
+
 struct epoch_t {
   u64 expired_flows;
   u64 new_flows;
   u64 concurrent_flows;
+  // In bits.
+  double src_ip_entropy;
+  double dst_ip_entropy;
+  double src_port_entropy;
+  double dst_port_entropy;
+};
+
+// One entry per table of the tracker, including the FlowTracker's. Tables of metrics the tracker does not compute are left zeroed.
+struct tracker_table_stats_t {
+  hash_table_stats_t bytes_per_flow;
+  hash_table_stats_t concurrent_flows;
+  hash_table_stats_t flow_times;
+  hash_table_stats_t flow_tracker;
+  hash_table_stats_t flows;
+  hash_table_stats_t pkts_per_flow;
+  hash_table_stats_t symm_flows;
 };
 
 struct report_t {
@@ -39,32 +71,317 @@ struct report_t {
   CDF flow_duration_us_cdf;
   CDF flow_dts_us_cdf;
   std::vector<epoch_t> epochs;
+  u64 flow_cache_accesses;
+  u64 flow_cache_cold_misses;
+  std::vector<miss_ratio_point_t> flow_cache_miss_ratio_curve;
+  std::vector<flow_table_report_t> flow_tables;
+  std::vector<rss_report_t> rss;
+  double hhh_threshold;
+  hhh_report_t hhh;
+  std::vector<hhh_report_t> hhh_epochs;
+
+  // Only collected with --table-stats: at the end of every epoch (sampling the buckets of big tables), and fully scanned at the end.
+  std::vector<tracker_table_stats_t> table_stats_per_epoch;
+  tracker_table_stats_t final_table_stats;
+
+  // The ones computed, or the ones asked for with --metrics.
+  metrics_t metrics;
+
+  report_t()
+      : start(0), end(0), total_pkts(0), total_bytes(0), tcpudp_pkts(0), total_flows(0), total_symm_flows(0), flow_cache_accesses(0),
+        flow_cache_cold_misses(0), hhh_threshold(0), hhh{}, final_table_stats{}, metrics(ALL_METRICS) {}
 
-  report_t() : start(0), end(0), total_pkts(0), tcpudp_pkts(0), total_flows(0), total_symm_flows(0) {}
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
 };
 
-struct traffic_stats_tracker_t {
-  simulator_clock_t clock;
+// The tracker is assembled from one policy class per metric (see metrics.h), each holding the state of its metric and hooking into the
+// packet loop. basic_traffic_stats_tracker_t only calls the hooks of the policies it is instantiated with, so a left out metric has no
+// tables and costs no per-packet branch. Policies override the hooks they need:
+//
+//   on_packet          every packet, before the epoch rollover check
+//   on_epoch_rollover  when the clock rolls over to a new epoch
+//   on_flow_packet     TCP/UDP packets
+//   fill_report        when generating the report, with report.epochs already sized
+//
+// plus reserve_flows, get_table_stats, save and load for their own state. Opt-in policies also override set_enabled: they hold their
+// state behind a pointer, only allocated once switched on, and their hooks return right away while it is null (a branch per TCP/UDP
+// packet and per epoch).
+struct metric_policy_t {
+  void set_enabled(bool enabled) {}
+  void on_packet(const packet_t &pkt, report_t &report) {}
+  void on_epoch_rollover() {}
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt) {}
+  void fill_report(report_t &report) const {}
+  void reserve_flows(u64 flows_count) {}
+  void get_table_stats(tracker_table_stats_t &stats, bool scan_all) const {}
+  void save(SnapshotWriter &out) const {}
+  void load(SnapshotReader &in) {}
+};
+
+struct pkt_sizes_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::PktSizes;
+
+  void on_packet(const packet_t &pkt, report_t &report);
+};
 
-  std::unordered_set<flow_t, flow_t::flow_hash_t> flows;
-  std::unordered_set<sflow_t, sflow_t::flow_hash_t> symm_flows;
-  std::vector<std::unordered_set<flow_t, flow_t::flow_hash_t>> concurrent_flows_per_epoch;
+struct flows_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::Flows;
+
+  IncrementalHashSet<flow_t, flow_t::flow_hash_t> flows;
+  rehash_tracker_t flows_rehashes;
+
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void reserve_flows(u64 flows_count);
+  void get_table_stats(tracker_table_stats_t &stats, bool scan_all) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+struct symm_flows_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::SymmFlows;
+
+  IncrementalHashSet<sflow_t, sflow_t::flow_hash_t> symm_flows;
+  rehash_tracker_t symm_flows_rehashes;
+
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void reserve_flows(u64 flows_count);
+  void get_table_stats(tracker_table_stats_t &stats, bool scan_all) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+// Flows are created on their first packet and expire a fixed time later (see DoubleChain), new and expired ones are counted per epoch.
+struct churn_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::Churn;
+
+  FlowTracker flow_tracker;
   std::vector<u64> expired_flows_per_epoch;
   std::vector<u64> new_flows_per_epoch;
-  FlowTracker flow_tracker;
-  std::unordered_map<flow_t, u64, sflow_t::flow_hash_t> pkts_per_flow;
-  std::unordered_map<flow_t, u64, sflow_t::flow_hash_t> bytes_per_flow;
-  std::unordered_map<flow_t, flow_ts, sflow_t::flow_hash_t> flow_times;
-
-  report_t report;
 
-  traffic_stats_tracker_t(time_ns_t _epoch_duration) : clock(_epoch_duration), flow_tracker(100'000'000) {
-    concurrent_flows_per_epoch.emplace_back();
+  churn_metric_t() : flow_tracker(100'000'000) {
+    expired_flows_per_epoch.reserve(TRACKER_RESERVED_EPOCHS);
+    new_flows_per_epoch.reserve(TRACKER_RESERVED_EPOCHS);
     expired_flows_per_epoch.emplace_back();
     new_flows_per_epoch.emplace_back();
   }
 
+  void on_epoch_rollover();
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void reserve_flows(u64 flows_count);
+  void get_table_stats(tracker_table_stats_t &stats, bool scan_all) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+struct concurrency_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::Concurrency;
+
+  // Flows seen in the current epoch, cleared (keeping its memory) on rollover, once its size is appended to the per epoch counts.
+  IncrementalHashSet<flow_t, flow_t::flow_hash_t> concurrent_flows;
+  std::vector<u64> concurrent_flows_per_epoch;
+  rehash_tracker_t concurrent_flows_rehashes;
+
+  concurrency_metric_t() { concurrent_flows_per_epoch.reserve(TRACKER_RESERVED_EPOCHS); }
+
+  void on_epoch_rollover();
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void reserve_flows(u64 flows_count);
+  void get_table_stats(tracker_table_stats_t &stats, bool scan_all) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+struct flow_sizes_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::FlowSizes;
+
+  IncrementalHashTable<flow_t, u64, sflow_t::flow_hash_t> pkts_per_flow;
+  IncrementalHashTable<flow_t, u64, sflow_t::flow_hash_t> bytes_per_flow;
+  rehash_tracker_t pkts_per_flow_rehashes;
+  rehash_tracker_t bytes_per_flow_rehashes;
+
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void reserve_flows(u64 flows_count);
+  void get_table_stats(tracker_table_stats_t &stats, bool scan_all) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+struct flow_times_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::FlowTimes;
+
+  IncrementalHashTable<flow_t, flow_ts, sflow_t::flow_hash_t> flow_times;
+  rehash_tracker_t flow_times_rehashes;
+
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void reserve_flows(u64 flows_count);
+  void get_table_stats(tracker_table_stats_t &stats, bool scan_all) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+struct flow_cache_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::FlowCache;
+
+  std::unique_ptr<ReuseDistanceTracker> reuse_distances;
+
+  void set_enabled(bool enabled);
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+// The geometries have to be set once enabled, before feeding packets (or loading a snapshot).
+struct flow_tables_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::FlowTables;
+
+  std::unique_ptr<FlowTableSimulator> flow_table_simulator;
+  // Of the last packet, TCP/UDP or not, for the epochs of the simulator to end at the right time.
+  time_ns_t now;
+
+  flow_tables_metric_t() : now(0) {}
+
+  void set_enabled(bool enabled);
+  void on_packet(const packet_t &pkt, report_t &report);
+  void on_epoch_rollover();
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+// The config has to be set once enabled, before feeding packets (or loading a snapshot).
+struct rss_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::Rss;
+
+  std::unique_ptr<RssSimulator> rss_simulator;
+
+  void set_enabled(bool enabled);
+  void on_epoch_rollover();
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+// The threshold has to be set once enabled, before feeding packets (or loading a snapshot).
+struct hhh_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::Hhh;
+
+  std::unique_ptr<HierarchicalHeavyHitters> heavy_hitters;
+
+  void set_enabled(bool enabled);
+  void on_epoch_rollover();
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+struct entropy_metric_t : metric_policy_t {
+  static constexpr const Metric METRIC = Metric::Entropy;
+
+  std::unique_ptr<FlowEntropyEstimator> entropy_estimator;
+
+  void set_enabled(bool enabled);
+  void on_epoch_rollover();
+  void on_flow_packet(const flow_t &flow, const packet_t &pkt);
+  void fill_report(report_t &report) const;
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+// Only the fields of report.metrics are written.
+void dump_report_to_json_file(const report_t &report, bool table_stats, const std::filesystem::path &json_output_report);
+void dump_report_to_bin_file(const report_t &report, const std::filesystem::path &bin_output_report);
+
+template <typename... Metrics> struct basic_traffic_stats_tracker_t : Metrics... {
+  static constexpr const metrics_t METRICS = (metric_bit(Metrics::METRIC) | ... | 0);
+
+  static constexpr bool has(Metric metric) { return has_metric(METRICS, metric); }
+
+  simulator_clock_t clock;
+  u64 epochs;
+  bool collect_table_stats;
+
+  report_t report;
+
+  basic_traffic_stats_tracker_t(time_ns_t _epoch_duration) : clock(_epoch_duration), epochs(1), collect_table_stats(false) {
+    set_metrics(ALL_METRICS & METRICS);
+  }
+
+  // The ones to report, switching on the opt-in ones among them.
+  void set_metrics(metrics_t metrics) {
+    report.metrics = metrics;
+    (this->Metrics::set_enabled(has_metric(metrics, Metrics::METRIC)), ...);
+  }
+
+  // Pre-sizes every flow table for that many flows, so that feed_packet does not allocate until the trace holds more than that.
+  void reserve_flows(u64 flows_count) { (this->Metrics::reserve_flows(flows_count), ...); }
+
   void feed_packet(const packet_t &pkt);
+  tracker_table_stats_t get_table_stats(bool scan_all) const;
   void generate_report();
-  void dump_report_to_json_file(const std::filesystem::path &json_output_report) const;
-};
\ No newline at end of file
+
+  void dump_report_to_json_file(const std::filesystem::path &json_output_report) const {
+    ::dump_report_to_json_file(report, collect_table_stats, json_output_report);
+  }
+
+  void dump_report_to_bin_file(const std::filesystem::path &bin_output_report) const {
+    ::dump_report_to_bin_file(report, bin_output_report);
+  }
+
+  void save(SnapshotWriter &out) const;
+  void load(SnapshotReader &in);
+};
+
+// Every metric but the opt-in ones.
+using traffic_stats_tracker_t = basic_traffic_stats_tracker_t<pkt_sizes_metric_t, flows_metric_t, symm_flows_metric_t, churn_metric_t,
+                                                              concurrency_metric_t, flow_sizes_metric_t, flow_times_metric_t>;
+
+// Every metric, with the opt-in ones switched on by set_metrics. One instantiation serves every combination of them, so those left off
+// still cost their null check.
+using analysis_traffic_stats_tracker_t =
+    basic_traffic_stats_tracker_t<pkt_sizes_metric_t, flows_metric_t, symm_flows_metric_t, churn_metric_t, concurrency_metric_t,
+                                  flow_sizes_metric_t, flow_times_metric_t, flow_cache_metric_t, flow_tables_metric_t, rss_metric_t,
+                                  hhh_metric_t, entropy_metric_t>;
+
+// The instantiated subsets, cheapest first (see traffic_stats_tracker.cpp). Policies always come in the order of traffic_stats_tracker_t.
+using traffic_stats_tracker_instantiations_t =
+    std::tuple<basic_traffic_stats_tracker_t<pkt_sizes_metric_t>, basic_traffic_stats_tracker_t<churn_metric_t>,
+               basic_traffic_stats_tracker_t<pkt_sizes_metric_t, flows_metric_t, symm_flows_metric_t>,
+               basic_traffic_stats_tracker_t<pkt_sizes_metric_t, churn_metric_t>,
+               basic_traffic_stats_tracker_t<churn_metric_t, concurrency_metric_t>,
+               basic_traffic_stats_tracker_t<flows_metric_t, flow_sizes_metric_t>,
+               basic_traffic_stats_tracker_t<flows_metric_t, flow_times_metric_t>, traffic_stats_tracker_t,
+               analysis_traffic_stats_tracker_t>;
+
+// Calls f(std::type_identity<Tracker>()) with the cheapest instantiated tracker that computes every one of the metrics. The report
+// should then be restricted to them (report.metrics), as the tracker may compute more.
+template <typename F> void with_traffic_stats_tracker(metrics_t metrics, F &&f) {
+  bool found = false;
+  [&]<typename... Trackers>(std::tuple<Trackers...> *) {
+    ((!found && (metrics & ~Trackers::METRICS) == 0 ? (found = true, f(std::type_identity<Trackers>()), 0) : 0), ...);
+  }(static_cast<traffic_stats_tracker_instantiations_t *>(nullptr));
+}
+
+inline void save(SnapshotWriter &out, const flow_ts &fts) {
+  save(out, fts.first);
+  save(out, fts.last);
+  save(out, fts.dts_us_sum);
+  save(out, fts.dts);
+}
+
+inline void load(SnapshotReader &in, flow_ts &fts) {
+  load(in, fts.first);
+  load(in, fts.last);
+  load(in, fts.dts_us_sum);
+  load(in, fts.dts);
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include <CLI/CLI.hpp>
+
+#include "traffic_generator.h"
+#include "pcap_writer.h"
+#include "system.h"
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <sstream>
+
+constexpr const u64 DEFAULT_FLOWS              = 100'000;
+constexpr const u64 DEFAULT_PKTS               = 10'000'000;
+constexpr const double DEFAULT_ZIPF_SKEW       = 1.0;
+constexpr const char DEFAULT_SIZE_MIX[]        = "64:7,576:4,1500:1"; // Simple IMIX.
+constexpr const double DEFAULT_FLOW_RATE       = 10'000;
+constexpr const double DEFAULT_DURATION_MEAN_S = 1.0;
+constexpr const double DEFAULT_PARETO_SHAPE    = 1.5;
+constexpr const double DEFAULT_TCP_RATIO       = 0.8;
+constexpr const int DEFAULT_ZSTD_LEVEL         = 3;
+
+namespace {
+
+// "size:weight,size:weight,...", sizes being wire lengths with CRC.
+std::optional<std::vector<packet_size_share_t>> parse_size_mix(const std::string &str) {
+  std::vector<packet_size_share_t> mix;
+  std::stringstream ss(str);
+  std::string item;
+
+  while (std::getline(ss, item, ',')) {
+    packet_size_share_t share;
+    char separator;
+    std::istringstream item_ss(item);
+    if (!(item_ss >> share.size >> separator >> share.weight) || separator != ':' || !item_ss.eof()) {
+      return std::nullopt;
+    }
+    mix.push_back(share);
+  }
+
+  if (mix.empty()) {
+    return std::nullopt;
+  }
+
+  return mix;
+}
+
+std::optional<DurationDistribution> parse_duration_distribution(const std::string &str) {
+  if (str == "const") {
+    return DurationDistribution::Constant;
+  }
+  if (str == "exp") {
+    return DurationDistribution::Exponential;
+  }
+  if (str == "pareto") {
+    return DurationDistribution::Pareto;
+  }
+  return std::nullopt;
+}
+
+} // namespace
+
+struct args_t {
+  std::filesystem::path output;
+  u64 flows;
+  u64 pkts;
+  double zipf_skew;
+  std::string size_mix;
+  double flow_rate;
+  std::string duration_dist;
+  double duration_mean_s;
+  double pareto_shape;
+  double ipv6_ratio;
+  double vlan_ratio;
+  double tcp_ratio;
+  bytes_t snaplen;
+  u64 seed;
+  int zstd_level;
+
+  args_t()
+      : flows(DEFAULT_FLOWS), pkts(DEFAULT_PKTS), zipf_skew(DEFAULT_ZIPF_SKEW), size_mix(DEFAULT_SIZE_MIX), flow_rate(DEFAULT_FLOW_RATE),
+        duration_dist("exp"), duration_mean_s(DEFAULT_DURATION_MEAN_S), pareto_shape(DEFAULT_PARETO_SHAPE), ipv6_ratio(0), vlan_ratio(0),
+        tcp_ratio(DEFAULT_TCP_RATIO), snaplen(0), seed(0), zstd_level(DEFAULT_ZSTD_LEVEL) {}
+};
+
+int main(int argc, char **argv) {
+  args_t args;
+
+  CLI::App app{"Synthetic pcap generator"};
+  app.add_option("out", args.output, "Output pcap file (zstd compressed if it ends in .zst).")->required();
+  app.add_option("--flows", args.flows, "Number of flows (default: 100000).");
+  app.add_option("--pkts", args.pkts, "Target number of packets; every flow gets at least one, so it may be exceeded (default: 10M).");
+  app.add_option("--zipf", args.zipf_skew, "Zipf skew of the packets per flow, 0 for uniform (default: 1.0).");
+  app.add_option("--sizes", args.size_mix, "Packet size mix, as size:weight pairs with sizes including CRC (default: 64:7,576:4,1500:1).");
+  app.add_option("--flow-rate", args.flow_rate, "Mean new flows per second, arriving as a Poisson process (default: 10000).");
+  app.add_option("--duration-dist", args.duration_dist, "Flow duration distribution: const, exp or pareto (default: exp).");
+  app.add_option("--duration-mean", args.duration_mean_s, "Mean flow duration in seconds (default: 1.0).");
+  app.add_option("--pareto-shape", args.pareto_shape, "Shape of the Pareto duration distribution, above 1 (default: 1.5).");
+  app.add_option("--ipv6", args.ipv6_ratio, "Fraction of IPv6 flows (default: 0).");
+  app.add_option("--vlan", args.vlan_ratio, "Fraction of VLAN tagged flows (default: 0).");
+  app.add_option("--tcp", args.tcp_ratio, "Fraction of TCP flows, the rest being UDP (default: 0.8).");
+  app.add_option("--snaplen", args.snaplen, "Bytes captured per packet, 0 for headers only (default: 0).");
+  app.add_option("--seed", args.seed, "Random seed (default: 0).");
+  app.add_option("--zstd-level", args.zstd_level, "Compression level for .zst outputs (default: 3).");
+
+  CLI11_PARSE(app, argc, argv);
+
+  const std::optional<std::vector<packet_size_share_t>> size_mix = parse_size_mix(args.size_mix);
+  if (!size_mix) {
+    fprintf(stderr, "Invalid packet size mix %s\n", args.size_mix.c_str());
+    exit(1);
+  }
+
+  const std::optional<DurationDistribution> duration_dist = parse_duration_distribution(args.duration_dist);
+  if (!duration_dist) {
+    fprintf(stderr, "Unknown flow duration distribution %s\n", args.duration_dist.c_str());
+    exit(1);
+  }
+
+  const synth_config_t config = {
+      .flows           = args.flows,
+      .pkts            = args.pkts,
+      .zipf_skew       = args.zipf_skew,
+      .size_mix        = *size_mix,
+      .flow_rate       = args.flow_rate,
+      .duration_dist   = *duration_dist,
+      .duration_mean_s = args.duration_mean_s,
+      .pareto_shape    = args.pareto_shape,
+      .ipv6_ratio      = args.ipv6_ratio,
+      .vlan_ratio      = args.vlan_ratio,
+      .tcp_ratio       = args.tcp_ratio,
+      .snaplen         = args.snaplen,
+      .seed            = args.seed,
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+
+  TrafficGenerator generator(config);
+  PcapWriter out(args.output, std::max(args.snaplen, SYNTH_MAX_HDRS_LEN), args.zstd_level);
+  generator.run(out);
+  out.close();
+
+  const double elapsed_s     = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const synth_stats_t &stats = generator.get_stats();
+
+  fprintf(stderr, "Generated %s\n", args.output.c_str());
+  fprintf(stderr, "  Flows:    %lu (%lu IPv6, %lu VLAN)\n", stats.flows, stats.ipv6_flows, stats.vlan_flows);
+  fprintf(stderr, "  Packets:  %lu\n", stats.pkts);
+  fprintf(stderr, "  Bytes:    %lu\n", stats.bytes);
+  fprintf(stderr, "  Duration: %.3f s\n", static_cast<double>(stats.last_ts - stats.first_ts) / BILLION);
+  fprintf(stderr, "  Took:     %.2f s (%.2f Mpps)\n", elapsed_s, static_cast<double>(stats.pkts) / elapsed_s / MILLION);
+
+  return 0;
+}
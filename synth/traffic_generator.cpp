@@ -0,0 +1,273 @@
+#include "traffic_generator.h"
+#include "system.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+constexpr const u8 SYNTH_TTL           = 64;
+constexpr const u8 SYNTH_TCP_DATA_OFF  = (sizeof(tcp_hdr_t) / 4) << 4;
+constexpr const u8 SYNTH_TCP_FLAG_FIN  = 0x01;
+constexpr const u8 SYNTH_TCP_FLAG_SYN  = 0x02;
+constexpr const u8 SYNTH_TCP_FLAG_ACK  = 0x10;
+constexpr const u16 SYNTH_VLAN_ID_MASK = 0x0fff;
+
+TrafficGenerator::TrafficGenerator(const synth_config_t &_config)
+    : config(_config), rng(_config.seed), pkt_buffer(std::max(config.snaplen, SYNTH_MAX_HDRS_LEN), 0) {
+  assert_or_panic(config.flows > 0, "At least one flow is needed");
+  assert_or_panic(config.flow_rate > 0, "The flow arrival rate must be positive");
+  assert_or_panic(!config.size_mix.empty(), "Empty packet size mix");
+  assert_or_panic(config.duration_dist != DurationDistribution::Pareto || config.pareto_shape > 1,
+                  "The Pareto shape must be above 1 for the mean to exist");
+
+  double total_weight = 0;
+  for (const packet_size_share_t &share : config.size_mix) {
+    assert_or_panic(share.size >= MIN_PKT_SIZE_BYTES, "Packet size %u below the Ethernet minimum of %u", share.size, MIN_PKT_SIZE_BYTES);
+    assert_or_panic(share.weight >= 0, "Negative weight for packet size %u", share.size);
+    total_weight += share.weight;
+    size_cdf.push_back(total_weight);
+  }
+  assert_or_panic(total_weight > 0, "The packet size mix weights add up to 0");
+  for (double &cumulative : size_cdf) {
+    cumulative /= total_weight;
+  }
+
+  assign_pkts_per_flow();
+}
+
+// The flow of rank r gets a share of the packets proportional to 1/r^skew, and at least one packet.
+void TrafficGenerator::assign_pkts_per_flow() {
+  pkts_per_flow.resize(config.flows);
+
+  double harmonic = 0;
+  for (u64 rank = 1; rank <= config.flows; rank++) {
+    harmonic += std::pow(static_cast<double>(rank), -config.zipf_skew);
+  }
+
+  for (u64 rank = 1; rank <= config.flows; rank++) {
+    const double share = std::pow(static_cast<double>(rank), -config.zipf_skew) / harmonic;
+    const double pkts  = std::round(share * static_cast<double>(config.pkts));
+    pkts_per_flow[rank - 1] = static_cast<u32>(std::clamp(pkts, 1.0, static_cast<double>(UINT32_MAX)));
+  }
+
+  // Fisher-Yates, with our own generator to stay independent of the standard library implementation.
+  for (u64 i = config.flows - 1; i > 0; i--) {
+    std::swap(pkts_per_flow[i], pkts_per_flow[rng.below(i + 1)]);
+  }
+}
+
+double TrafficGenerator::sample_duration_ns() {
+  const double mean_ns = config.duration_mean_s * BILLION;
+
+  switch (config.duration_dist) {
+  case DurationDistribution::Constant:
+    return mean_ns;
+  case DurationDistribution::Exponential:
+    return rng.exponential(mean_ns);
+  case DurationDistribution::Pareto: {
+    const double scale = mean_ns * (config.pareto_shape - 1) / config.pareto_shape;
+    return scale / std::pow(1 - rng.uniform(), 1 / config.pareto_shape);
+  }
+  }
+
+  return mean_ns;
+}
+
+bytes_t TrafficGenerator::sample_pkt_size() {
+  const double u = rng.uniform();
+  for (size_t i = 0; i < size_cdf.size() - 1; i++) {
+    if (u < size_cdf[i]) {
+      return config.size_mix[i].size;
+    }
+  }
+  return config.size_mix.back().size;
+}
+
+void TrafficGenerator::start_flow(time_ns_t ts, u32 pkts) {
+  u32 slot;
+  if (!free_slots.empty()) {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  } else {
+    slot = flows.size();
+    flows.emplace_back();
+  }
+
+  synth_flow_t &flow = flows[slot];
+  memset(flow.hdrs, 0, sizeof(flow.hdrs));
+
+  flow.ipv6      = rng.uniform() < config.ipv6_ratio;
+  flow.tcp       = rng.uniform() < config.tcp_ratio;
+  const bool vlan = rng.uniform() < config.vlan_ratio;
+
+  u8 *cursor = flow.hdrs;
+
+  ether_hdr_t *ether_hdr = reinterpret_cast<ether_hdr_t *>(cursor);
+  const u64 macs         = rng.next();
+  memcpy(ether_hdr->daddr.addr_bytes, &macs, sizeof(ether_hdr->daddr.addr_bytes));
+  memcpy(ether_hdr->saddr.addr_bytes, reinterpret_cast<const u8 *>(&macs) + 2, sizeof(ether_hdr->saddr.addr_bytes));
+  ether_hdr->daddr.addr_bytes[0] &= 0xfe; // Unicast.
+  ether_hdr->saddr.addr_bytes[0] &= 0xfe;
+  cursor += sizeof(ether_hdr_t);
+
+  const u16 l3_ether_type = flow.ipv6 ? ETHERTYPE_IPV6 : ETHERTYPE_IP;
+  if (vlan) {
+    // The VLAN header overlaps the Ethernet type field, with the encapsulated type following its TCI.
+    ether_hdr->ether_type = htons(ETHERTYPE_VLAN);
+    const u16 tci         = htons(1 + rng.below(SYNTH_VLAN_ID_MASK - 1));
+    const u16 inner_type  = htons(l3_ether_type);
+    memcpy(cursor, &tci, sizeof(tci));
+    memcpy(cursor + sizeof(tci), &inner_type, sizeof(inner_type));
+    cursor += sizeof(vlan_hdr_t);
+  } else {
+    ether_hdr->ether_type = htons(l3_ether_type);
+  }
+
+  flow.l3_offset = cursor - flow.hdrs;
+  const u8 proto = flow.tcp ? IPPROTO_TCP : IPPROTO_UDP;
+
+  if (flow.ipv6) {
+    ipv6_hdr_t *ip_hdr  = reinterpret_cast<ipv6_hdr_t *>(cursor);
+    ip_hdr->vtc_flow    = htonl(6u << 28);
+    ip_hdr->proto       = proto;
+    ip_hdr->hop_limits  = SYNTH_TTL;
+    const u64 addrs[4]  = {rng.next(), rng.next(), rng.next(), rng.next()};
+    memcpy(ip_hdr->src_addr, &addrs[0], sizeof(ip_hdr->src_addr));
+    memcpy(ip_hdr->dst_addr, &addrs[2], sizeof(ip_hdr->dst_addr));
+    cursor += sizeof(ipv6_hdr_t);
+    stats.ipv6_flows++;
+  } else {
+    ipv4_hdr_t *ip_hdr    = reinterpret_cast<ipv4_hdr_t *>(cursor);
+    ip_hdr->version       = 4;
+    ip_hdr->ihl           = sizeof(ipv4_hdr_t) / 4;
+    ip_hdr->time_to_live  = SYNTH_TTL;
+    ip_hdr->next_proto_id = proto;
+    const u64 addrs       = rng.next();
+    memcpy(&ip_hdr->src_addr, &addrs, sizeof(ip_hdr->src_addr));
+    memcpy(&ip_hdr->dst_addr, reinterpret_cast<const u8 *>(&addrs) + sizeof(u32), sizeof(ip_hdr->dst_addr));
+    cursor += sizeof(ipv4_hdr_t);
+  }
+
+  flow.l4_offset  = cursor - flow.hdrs;
+  const u64 ports = rng.next();
+
+  if (flow.tcp) {
+    tcp_hdr_t *tcp_hdr = reinterpret_cast<tcp_hdr_t *>(cursor);
+    tcp_hdr->src_port  = ports;
+    tcp_hdr->dst_port  = ports >> 16;
+    tcp_hdr->sent_seq  = ports >> 32;
+    tcp_hdr->data_off  = SYNTH_TCP_DATA_OFF;
+    tcp_hdr->rx_win    = htons(UINT16_MAX);
+    cursor += sizeof(tcp_hdr_t);
+  } else {
+    udp_hdr_t *udp_hdr = reinterpret_cast<udp_hdr_t *>(cursor);
+    udp_hdr->src_port  = ports;
+    udp_hdr->dst_port  = ports >> 16;
+    cursor += sizeof(udp_hdr_t);
+  }
+
+  flow.hdrs_len    = cursor - flow.hdrs;
+  flow.pkts_left   = pkts;
+  flow.pkts_sent   = 0;
+  flow.gap_mean_ns = pkts > 1 ? sample_duration_ns() / (pkts - 1) : 0;
+
+  stats.flows++;
+  stats.vlan_flows += vlan;
+
+  pending.emplace_back(ts, slot);
+  std::push_heap(pending.begin(), pending.end(), std::greater<pending_pkt_t>());
+}
+
+void TrafficGenerator::emit_pkt(PcapWriter &out, time_ns_t ts, synth_flow_t &flow) {
+  const bytes_t frame_len = std::max(sample_pkt_size() - CRC_SIZE_BYTES, static_cast<bytes_t>(flow.hdrs_len));
+  const bytes_t caplen    = config.snaplen == 0 ? flow.hdrs_len : std::min(frame_len, config.snaplen);
+
+  u8 *pkt = pkt_buffer.data();
+  memcpy(pkt, flow.hdrs, flow.hdrs_len);
+
+  if (flow.ipv6) {
+    reinterpret_cast<ipv6_hdr_t *>(pkt + flow.l3_offset)->payload_len = htons(frame_len - flow.l4_offset);
+  } else {
+    ipv4_hdr_t *ip_hdr   = reinterpret_cast<ipv4_hdr_t *>(pkt + flow.l3_offset);
+    ip_hdr->total_length = htons(frame_len - flow.l3_offset);
+    ip_hdr->packet_id    = htons(flow.pkts_sent);
+  }
+
+  if (flow.tcp) {
+    u8 flags = SYNTH_TCP_FLAG_ACK;
+    if (flow.pkts_sent == 0) {
+      flags = SYNTH_TCP_FLAG_SYN;
+    } else if (flow.pkts_left == 1) {
+      flags |= SYNTH_TCP_FLAG_FIN;
+    }
+    reinterpret_cast<tcp_hdr_t *>(pkt + flow.l4_offset)->tcp_flags = flags;
+  } else {
+    reinterpret_cast<udp_hdr_t *>(pkt + flow.l4_offset)->len = htons(frame_len - flow.l4_offset);
+  }
+
+  out.write(ts, pkt, caplen, frame_len);
+
+  flow.pkts_left--;
+  flow.pkts_sent++;
+
+  if (stats.pkts == 0) {
+    stats.first_ts = ts;
+  }
+  stats.last_ts = ts;
+  stats.pkts++;
+  stats.bytes += frame_len + CRC_SIZE_BYTES;
+}
+
+void TrafficGenerator::reschedule_earliest(time_ns_t ts) {
+  const pending_pkt_t moved = {ts, pending.front().second};
+  const size_t size         = pending.size();
+
+  size_t hole = 0;
+  while (true) {
+    size_t child = 2 * hole + 1;
+    if (child >= size) {
+      break;
+    }
+    if (child + 1 < size && pending[child + 1] < pending[child]) {
+      child++;
+    }
+    if (!(pending[child] < moved)) {
+      break;
+    }
+    pending[hole] = pending[child];
+    hole          = child;
+  }
+
+  pending[hole] = moved;
+}
+
+void TrafficGenerator::run(PcapWriter &out) {
+  const double arrival_gap_mean_ns = BILLION / config.flow_rate;
+
+  u64 next_flow        = 0;
+  time_ns_t arrival_ts = SYNTH_START_TS;
+
+  while (next_flow < config.flows || !pending.empty()) {
+    // Flows are started as soon as their arrival is due, so that their first packet goes out in timestamp order.
+    if (next_flow < config.flows && (pending.empty() || arrival_ts <= pending.front().first)) {
+      start_flow(arrival_ts, pkts_per_flow[next_flow++]);
+      arrival_ts += std::llround(rng.exponential(arrival_gap_mean_ns));
+      continue;
+    }
+
+    const auto [ts, slot] = pending.front();
+
+    synth_flow_t &flow = flows[slot];
+    emit_pkt(out, ts, flow);
+
+    if (flow.pkts_left > 0) {
+      reschedule_earliest(ts + std::llround(rng.exponential(flow.gap_mean_ns)));
+    } else {
+      std::pop_heap(pending.begin(), pending.end(), std::greater<pending_pkt_t>());
+      pending.pop_back();
+      free_slots.push_back(slot);
+    }
+  }
+}
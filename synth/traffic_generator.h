@@ -0,0 +1,146 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "pcap_writer.h"
+
+#include <cmath>
+#include <vector>
+
+// Synthetic traffic for reproducible benchmarks.
+//
+// Flows arrive as a Poisson process and each one gets its packet count from a Zipf law over flow ranks (ranks are shuffled, so big flows
+// are not bunched up at the start of the trace). Packets of a flow are spread over a duration drawn from the configured distribution, with
+// exponential gaps, and their sizes are drawn independently from the packet size mix. Everything is driven by a single seeded generator,
+// so the same configuration always produces the very same trace.
+
+constexpr const time_ns_t SYNTH_START_TS = 1'700'000'000 * BILLION;
+
+// Ethernet + VLAN + IPv6 + TCP.
+constexpr const bytes_t SYNTH_MAX_HDRS_LEN = sizeof(ether_hdr_t) + sizeof(vlan_hdr_t) + sizeof(ipv6_hdr_t) + sizeof(tcp_hdr_t);
+
+enum class DurationDistribution {
+  Constant,
+  Exponential,
+  Pareto,
+};
+
+struct packet_size_share_t {
+  bytes_t size; // On the wire, CRC included.
+  double weight;
+};
+
+struct synth_config_t {
+  u64 flows;
+  u64 pkts;
+  double zipf_skew;
+  std::vector<packet_size_share_t> size_mix;
+  double flow_rate; // New flows per second.
+  DurationDistribution duration_dist;
+  double duration_mean_s;
+  double pareto_shape;
+  double ipv6_ratio;
+  double vlan_ratio;
+  double tcp_ratio;
+  bytes_t snaplen; // 0 captures headers only.
+  u64 seed;
+};
+
+struct synth_stats_t {
+  u64 flows;
+  u64 ipv6_flows;
+  u64 vlan_flows;
+  u64 pkts;
+  u64 bytes;
+  time_ns_t first_ts;
+  time_ns_t last_ts;
+
+  synth_stats_t() : flows(0), ipv6_flows(0), vlan_flows(0), pkts(0), bytes(0), first_ts(0), last_ts(0) {}
+};
+
+// xoshiro256**, seeded through splitmix64. Much cheaper than std::mt19937_64, and its output does not depend on the standard library.
+class synth_rng_t {
+private:
+  u64 s[4];
+
+public:
+  synth_rng_t(u64 seed) {
+    for (u64 &word : s) {
+      seed += 0x9e3779b97f4a7c15ULL;
+      u64 z = seed;
+      z     = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z     = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      word  = z ^ (z >> 31);
+    }
+  }
+
+  u64 next() {
+    const u64 result = rotl(s[1] * 5, 7) * 9;
+    const u64 t      = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+  // In [0, 1).
+  double uniform() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+  // In [0, bound). The modulo bias is irrelevant for the bounds we use.
+  u64 below(u64 bound) { return next() % bound; }
+
+  double exponential(double mean) { return -std::log1p(-uniform()) * mean; }
+
+private:
+  static u64 rotl(u64 x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+class TrafficGenerator {
+private:
+  struct synth_flow_t {
+    u8 hdrs[SYNTH_MAX_HDRS_LEN];
+    u8 hdrs_len;
+    u8 l3_offset;
+    u8 l4_offset;
+    bool ipv6;
+    bool tcp;
+    u32 pkts_left;
+    u32 pkts_sent;
+    double gap_mean_ns;
+  };
+
+  // (next packet timestamp, flow slot).
+  using pending_pkt_t = std::pair<time_ns_t, u32>;
+
+  const synth_config_t config;
+  synth_rng_t rng;
+
+  std::vector<u32> pkts_per_flow;
+  std::vector<double> size_cdf;
+
+  std::vector<synth_flow_t> flows;
+  std::vector<u32> free_slots;
+  // Min-heap, kept by hand so that rescheduling the earliest flow is a single sift down instead of a pop and a push.
+  std::vector<pending_pkt_t> pending;
+
+  std::vector<u8> pkt_buffer;
+  synth_stats_t stats;
+
+public:
+  TrafficGenerator(const synth_config_t &config);
+
+  void run(PcapWriter &out);
+
+  const synth_stats_t &get_stats() const { return stats; }
+
+private:
+  void assign_pkts_per_flow();
+  void start_flow(time_ns_t ts, u32 pkts);
+  void emit_pkt(PcapWriter &out, time_ns_t ts, synth_flow_t &flow);
+  void reschedule_earliest(time_ns_t ts);
+  double sample_duration_ns();
+  bytes_t sample_pkt_size();
+};
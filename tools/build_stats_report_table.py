@@ -16,6 +16,8 @@ PLOTS_DIR = PROJECT_DIR / "plots"
 
 def build_table(name: str, report: StatsReport):
     assert len(report.epochs) > 0, "Report must contain at least one epoch"
+    assert report.epochs[0].new_flows is not None, "The report has no churn, run pcap-stats with the churn metric"
+    assert report.epochs[0].concurrent_flows is not None, "The report has no concurrent flows, run pcap-stats with the concurrency metric"
 
     avg_bytes_per_pkt = report.total_bytes / report.total_pkts
     total_bytes_on_the_write = report.total_pkts * 20 + report.total_bytes
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+
+# End-to-end performance regression harness.
+#
+# Generates (and caches) a synthetic trace with pcap-synth, runs pcap-stats over it in several modes and records throughput, wall time,
+# peak RSS and per-stage time into a results JSON. Given a baseline results file, it fails if any metric got worse than the threshold.
+
+import hashlib
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+from argparse import ArgumentParser
+from dataclasses import asdict, dataclass, field
+from pathlib import Path
+from statistics import median
+from typing import Optional
+
+from prettytable import PrettyTable
+
+CURRENT_DIR = Path(os.path.abspath(os.path.dirname(__file__)))
+PROJECT_DIR = CURRENT_DIR.parent
+
+PCAP_STATS_BIN = PROJECT_DIR / "build" / "bin" / "pcap-stats"
+PCAP_SYNTH_BIN = PROJECT_DIR / "build" / "bin" / "pcap-synth"
+
+DEFAULT_WORK_DIR = PROJECT_DIR / "build" / "perf"
+DEFAULT_SYNTH_ARGS = "--flows 200000 --pkts 5000000 --zipf 1.0 --flow-rate 20000 --seed 1"
+DEFAULT_MODES = ["plain", "zst", "threads", "multi-rate", "metrics"]
+DEFAULT_RATES_MBPS = [1_000, 10_000, 100_000]
+# The common --metrics subsets, each dispatched to its own tracker instantiation (see traffic_stats_tracker.h).
+METRIC_SUBSETS = ["pkt_sizes", "churn", "pkt_sizes,flows,symm_flows", "churn,concurrency", "flows,flow_sizes", "flows,flow_times"]
+DEFAULT_REPETITIONS = 3
+DEFAULT_THRESHOLD_PERCENT = 5.0
+
+RESULTS_VERSION = 1
+
+# Metric name -> whether higher is better.
+COMPARED_METRICS = {
+    "mpps": True,
+    "gbps": True,
+    "wall_s": False,
+    "peak_rss_mb": False,
+}
+
+
+@dataclass
+class RunResult:
+    pkts: int
+    bytes: int
+    wall_s: float
+    mpps: float
+    gbps: float
+    peak_rss_mb: float
+    stages_s: dict[str, float] = field(default_factory=dict)
+
+
+def log(msg: str):
+    print(msg, file=sys.stderr, flush=True)
+
+
+def generate_traces(synth_bin: Path, work_dir: Path, synth_args: str) -> tuple[Path, Path]:
+    # Traces are keyed by the generator arguments, so changing them never reuses a stale trace.
+    key = hashlib.sha1(synth_args.encode()).hexdigest()[:12]
+    plain = work_dir / f"synth-{key}.pcap"
+    zst = work_dir / f"synth-{key}.pcap.zst"
+
+    for trace in [plain, zst]:
+        if trace.exists():
+            continue
+        log(f"Generating {trace.name} ({synth_args})")
+        subprocess.run([str(synth_bin), str(trace), *synth_args.split()], check=True, stdout=subprocess.DEVNULL)
+
+    return plain, zst
+
+
+def run_once(cmd: list[str], report: Path, profile: Optional[Path]) -> RunResult:
+    # stderr goes to a file rather than a pipe: nothing reads a pipe while we wait, so a chatty child would block on a full one.
+    with tempfile.TemporaryFile() as stderr_file:
+        start = time.perf_counter()
+        process = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=stderr_file)
+        # wait4 gives us the rusage of this very child, unlike RUSAGE_CHILDREN which aggregates all of them.
+        _, status, rusage = os.wait4(process.pid, 0)
+        wall_s = time.perf_counter() - start
+        # Popen must not reap it again.
+        process.returncode = os.waitstatus_to_exitcode(status)
+
+        if process.returncode != 0:
+            stderr_file.seek(0)
+            log(stderr_file.read().decode(errors="replace"))
+            raise RuntimeError(f"Command failed: {' '.join(cmd)}")
+
+    with open(report) as f:
+        report_data = json.load(f)
+
+    stages_s = {}
+    if profile:
+        with open(profile) as f:
+            profile_data = json.load(f)
+        stages_s = {name: stage["wall_s"] for name, stage in profile_data["stages"].items()}
+
+    pkts = report_data["total_pkts"]
+    total_bytes = report_data["total_bytes"]
+
+    return RunResult(
+        pkts=pkts,
+        bytes=total_bytes,
+        wall_s=wall_s,
+        mpps=pkts / wall_s / 1e6,
+        gbps=total_bytes * 8 / wall_s / 1e9,
+        peak_rss_mb=rusage.ru_maxrss / 1024,  # Linux reports it in KiB.
+        stages_s=stages_s,
+    )
+
+
+def run_config(
+    name: str,
+    pcap_stats_bin: Path,
+    trace: Path,
+    extra_args: list[str],
+    work_dir: Path,
+    repetitions: int,
+    profile: bool,
+) -> RunResult:
+    report = work_dir / f"{name}.report.json"
+    profile_out = work_dir / f"{name}.profile.json" if profile else None
+
+    cmd = [str(pcap_stats_bin), str(trace), "--out", str(report), "--telemetry-interval", "0", *extra_args]
+    if profile_out:
+        cmd += ["--profile-out", str(profile_out)]
+
+    results = []
+    for i in range(repetitions):
+        result = run_once(cmd, report, profile_out)
+        log(f"  {name} [{i + 1}/{repetitions}]: {result.wall_s:.3f} s, {result.mpps:.3f} Mpps, {result.peak_rss_mb:.1f} MB")
+        results.append(result)
+
+    # The median run by wall time, so that one noisy repetition does not skew any of the metrics.
+    results.sort(key=lambda r: r.wall_s)
+    return results[len(results) // 2]
+
+
+def build_configs(modes: list[str], plain: Path, zst: Path, rates: list[int], work_dir: Path) -> list[tuple[str, Path, list[str]]]:
+    configs = []
+    for mode in modes:
+        if mode == "plain":
+            configs.append(("plain", plain, []))
+        elif mode == "zst":
+            configs.append(("zst", zst, []))
+        elif mode == "threads":
+            # Everything that runs next to ingest: the flow record writer and the telemetry sampler.
+            flows_out = work_dir / "threads.flows.pstat.zst"
+            configs.append(("threads", plain, ["--flows-out", str(flows_out), "--telemetry-interval", "1000"]))
+        elif mode == "multi-rate":
+            for rate in rates:
+                configs.append((f"rate-{rate}Mbps", plain, ["--mbps", str(rate)]))
+        elif mode == "metrics":
+            for metrics in METRIC_SUBSETS:
+                configs.append((f"metrics-{metrics.replace(',', '+')}", plain, ["--metrics", metrics]))
+        else:
+            raise ValueError(f"Unknown mode {mode}")
+    return configs
+
+
+def compare(results: dict, baseline: dict, threshold_percent: float) -> bool:
+    table = PrettyTable()
+    table.field_names = ["Run", "Metric", "Baseline", "Current", "Change", ""]
+    table.align = "r"
+    table.align["Run"] = "l"
+    table.align["Metric"] = "l"
+
+    ok = True
+    for name, run in results["runs"].items():
+        if name not in baseline["runs"]:
+            continue
+
+        base_run = baseline["runs"][name]
+        for metric, higher_is_better in COMPARED_METRICS.items():
+            before = base_run[metric]
+            after = run[metric]
+            if before == 0:
+                continue
+
+            change = (after - before) / before * 100
+            regression = -change if higher_is_better else change
+            failed = regression > threshold_percent
+            ok = ok and not failed
+
+            table.add_row([name, metric, f"{before:.3f}", f"{after:.3f}", f"{change:+.2f}%", "REGRESSION" if failed else ""])
+
+    print(table)
+    return ok
+
+
+def main():
+    parser = ArgumentParser(description="Runs pcap-stats end to end over synthetic traces and checks for performance regressions.")
+    parser.add_argument("--pcap-stats", type=Path, default=PCAP_STATS_BIN, help="pcap-stats binary")
+    parser.add_argument("--pcap-synth", type=Path, default=PCAP_SYNTH_BIN, help="pcap-synth binary")
+    parser.add_argument("--work-dir", type=Path, default=DEFAULT_WORK_DIR, help="Where traces and intermediate files go")
+    parser.add_argument("--synth-args", default=DEFAULT_SYNTH_ARGS, help="Arguments for pcap-synth")
+    parser.add_argument("--modes", default=",".join(DEFAULT_MODES), help="Comma separated subset of: " + ", ".join(DEFAULT_MODES))
+    parser.add_argument("--rates", default=",".join(map(str, DEFAULT_RATES_MBPS)), help="Replay rates (Mbps) for multi-rate")
+    parser.add_argument("--repetitions", type=int, default=DEFAULT_REPETITIONS, help="Runs per configuration, the median is kept")
+    parser.add_argument("--no-profile", action="store_true", help="Skip per-stage times (for builds without ENABLE_PROFILING)")
+    parser.add_argument("--out", type=Path, required=True, help="Results JSON")
+    parser.add_argument("--baseline", type=Path, help="Results JSON to compare against")
+    parser.add_argument("--threshold", type=float, default=DEFAULT_THRESHOLD_PERCENT, help="Max tolerated regression, in percent")
+    args = parser.parse_args()
+
+    args.work_dir.mkdir(parents=True, exist_ok=True)
+
+    plain, zst = generate_traces(args.pcap_synth, args.work_dir, args.synth_args)
+    rates = [int(rate) for rate in args.rates.split(",")]
+    configs = build_configs(args.modes.split(","), plain, zst, rates, args.work_dir)
+
+    runs = {}
+    for name, trace, extra_args in configs:
+        log(f"Running {name}")
+        result = run_config(name, args.pcap_stats, trace, extra_args, args.work_dir, args.repetitions, not args.no_profile)
+        runs[name] = asdict(result)
+
+    results = {
+        "runs": runs,
+        "synth_args": args.synth_args,
+        "version": RESULTS_VERSION,
+    }
+
+    with open(args.out, "w") as f:
+        json.dump(results, f, indent=2, sort_keys=True)
+    log(f"Results written to {args.out}")
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+        if baseline.get("synth_args") != args.synth_args:
+            log("Warning: the baseline was measured on a different trace")
+
+        if not compare(results, baseline, args.threshold):
+            log(f"Performance regressed by more than {args.threshold}%")
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
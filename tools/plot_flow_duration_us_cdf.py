@@ -39,7 +39,7 @@ def main():
 
     report_file = args.report
     data = parse_report(report_file)
-    plot_flow_duration_us_cdf(report_file.stem, data.flow_duration_us_cdf)
+    plot_flow_duration_us_cdf(report_file.stem, require(data, "flow_duration_us_cdf", "flow_times"))
 
 
 if __name__ == "__main__":
@@ -48,7 +48,7 @@ def main():
 
     report_file = args.report
     data = parse_report(report_file)
-    plot_pkt_bytes_cdf(report_file.stem, data.pkt_bytes_cdf)
+    plot_pkt_bytes_cdf(report_file.stem, require(data, "pkt_bytes_cdf", "pkt_sizes"))
 
 
 if __name__ == "__main__":
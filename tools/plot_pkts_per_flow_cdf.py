@@ -42,7 +42,7 @@ def main():
 
     report_file = args.report
     data = parse_report(report_file)
-    plot_pkts_per_flow_cdf(report_file.stem, data.pkts_per_flow_cdf)
+    plot_pkts_per_flow_cdf(report_file.stem, require(data, "pkts_per_flow_cdf", "flow_sizes"))
 
 
 if __name__ == "__main__":
@@ -48,7 +48,7 @@ def main():
 
     report_file = args.report
     data = parse_report(report_file)
-    plot_top_k_flows_cdf(report_file.stem, data.top_k_flows_cdf)
+    plot_top_k_flows_cdf(report_file.stem, require(data, "top_k_flows_cdf", "flow_sizes"))
 
 
 if __name__ == "__main__":
@@ -1,17 +1,35 @@
+import mmap
+import numpy as np
+
 from pathlib import Path
 from msgspec import Struct
 from msgspec.json import decode
 
+COLUMNAR_MAGIC = b"PSTATCOL"
+ZSTD_MAGIC = b"\x28\xb5\x2f\xfd"
+COLUMN_DTYPES = {
+    0: np.dtype("<u8"),
+    1: np.dtype("<i8"),
+    2: np.dtype("<f8"),
+    3: np.dtype("<u4"),
+    4: np.dtype("<u2"),
+}
+
 
 class CDF(Struct):
     values: list[int]
     probabilities: list[float]
 
 
+# The fields of the metrics a report was produced without (see --metrics) are missing from it, and None here.
 class Epoch(Struct):
-    expired_flows: int
-    new_flows: int
-    concurrent_flows: int
+    expired_flows: int | None = None
+    new_flows: int | None = None
+    concurrent_flows: int | None = None
+    src_ip_entropy: float | None = None
+    dst_ip_entropy: float | None = None
+    src_port_entropy: float | None = None
+    dst_port_entropy: float | None = None
 
 
 class StatsReport(Struct):
@@ -20,28 +38,137 @@ class StatsReport(Struct):
     total_pkts: int
     total_bytes: int
     tcpudp_pkts: int
-    pkt_bytes_avg: float
-    pkt_bytes_stdev: float
-    pkt_bytes_cdf: CDF
-    total_flows: int
-    total_symm_flows: int
-    pkts_per_flow_avg: float
-    pkts_per_flow_stdev: float
-    pkts_per_flow_cdf: CDF
-    top_k_flows_cdf: CDF
-    top_k_flows_bytes_cdf: CDF
-    flow_duration_us_avg: float
-    flow_duration_us_stdev: float
-    flow_duration_us_cdf: CDF
-    flow_dts_us_avg: float
-    flow_dts_us_stdev: float
-    flow_dts_us_cdf: CDF
-    epochs: list[Epoch]
+    pkt_bytes_avg: float | None = None
+    pkt_bytes_stdev: float | None = None
+    pkt_bytes_cdf: CDF | None = None
+    total_flows: int | None = None
+    total_symm_flows: int | None = None
+    pkts_per_flow_avg: float | None = None
+    pkts_per_flow_stdev: float | None = None
+    pkts_per_flow_cdf: CDF | None = None
+    top_k_flows_cdf: CDF | None = None
+    top_k_flows_bytes_cdf: CDF | None = None
+    flow_duration_us_avg: float | None = None
+    flow_duration_us_stdev: float | None = None
+    flow_duration_us_cdf: CDF | None = None
+    flow_dts_us_avg: float | None = None
+    flow_dts_us_stdev: float | None = None
+    flow_dts_us_cdf: CDF | None = None
+    epochs: list[Epoch] = []
+
+
+def require(report: StatsReport, field: str, metric: str):
+    """
+    Returns the given field of the report, failing with the metric it needs when the report was produced without it.
+    """
+    value = getattr(report, field)
+    assert value is not None, f"The report has no {field}, run pcap-stats with the {metric} metric"
+    return value
+
+
+def _align(offset: int) -> int:
+    return (offset + 7) & ~7
+
+
+def load_columns(file: Path) -> dict[str, np.ndarray]:
+    """
+    Loads a binary columnar file (see src/columnar_writer.h for the layout).
+
+    Uncompressed files are mmapped and the returned arrays are zero-copy views over the mapping. Columns that appear more than once
+    (e.g. one per block of records) are concatenated in file order.
+    """
+    with open(file, "rb") as f:
+        if f.read(4) == ZSTD_MAGIC:
+            import zstandard
+
+            f.seek(0)
+            buffer = zstandard.ZstdDecompressor().stream_reader(f).read()
+        else:
+            buffer = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+    assert buffer[:8] == COLUMNAR_MAGIC, f"{file} is not a columnar file"
+
+    chunks: dict[str, list[np.ndarray]] = {}
+    offset = 16
+
+    while offset < len(buffer):
+        count = int(np.frombuffer(buffer, dtype="<u8", count=1, offset=offset)[0])
+        name_len = int(np.frombuffer(buffer, dtype="<u4", count=1, offset=offset + 8)[0])
+        dtype = COLUMN_DTYPES[buffer[offset + 12]]
+        offset += 16
+
+        name = bytes(buffer[offset : offset + name_len]).decode()
+        offset = _align(offset + name_len)
+
+        chunks.setdefault(name, []).append(np.frombuffer(buffer, dtype=dtype, count=count, offset=offset))
+        offset = _align(offset + count * dtype.itemsize)
+
+    return {name: parts[0] if len(parts) == 1 else np.concatenate(parts) for name, parts in chunks.items()}
+
+
+def _parse_bin_report(file: Path) -> StatsReport:
+    columns = load_columns(file)
+
+    def scalar(name: str):
+        column = columns.get(name)
+        return None if column is None else column[0].item()
+
+    def cdf(name: str) -> CDF | None:
+        if f"{name}.values" not in columns:
+            return None
+        return CDF(values=columns[f"{name}.values"], probabilities=columns[f"{name}.probabilities"])
+
+    epoch_fields = {
+        "expired_flows": int,
+        "new_flows": int,
+        "concurrent_flows": int,
+        "src_ip_entropy": float,
+        "dst_ip_entropy": float,
+        "src_port_entropy": float,
+        "dst_port_entropy": float,
+    }
+    epoch_columns = {name: columns[f"epochs.{name}"] for name in epoch_fields if f"epochs.{name}" in columns}
+    num_epochs = max((len(column) for column in epoch_columns.values()), default=0)
+    epochs = [
+        Epoch(**{name: epoch_fields[name](column[i]) for name, column in epoch_columns.items()}) for i in range(num_epochs)
+    ]
+
+    return StatsReport(
+        start_utc_ns=scalar("start_utc_ns"),
+        end_utc_ns=scalar("end_utc_ns"),
+        total_pkts=scalar("total_pkts"),
+        total_bytes=scalar("total_bytes"),
+        tcpudp_pkts=scalar("tcpudp_pkts"),
+        pkt_bytes_avg=scalar("pkt_bytes_avg"),
+        pkt_bytes_stdev=scalar("pkt_bytes_stdev"),
+        pkt_bytes_cdf=cdf("pkt_bytes_cdf"),
+        total_flows=scalar("total_flows"),
+        total_symm_flows=scalar("total_symm_flows"),
+        pkts_per_flow_avg=scalar("pkts_per_flow_avg"),
+        pkts_per_flow_stdev=scalar("pkts_per_flow_stdev"),
+        pkts_per_flow_cdf=cdf("pkts_per_flow_cdf"),
+        top_k_flows_cdf=cdf("top_k_flows_cdf"),
+        top_k_flows_bytes_cdf=cdf("top_k_flows_bytes_cdf"),
+        flow_duration_us_avg=scalar("flow_duration_us_avg"),
+        flow_duration_us_stdev=scalar("flow_duration_us_stdev"),
+        flow_duration_us_cdf=cdf("flow_duration_us_cdf"),
+        flow_dts_us_avg=scalar("flow_dts_us_avg"),
+        flow_dts_us_stdev=scalar("flow_dts_us_stdev"),
+        flow_dts_us_cdf=cdf("flow_dts_us_cdf"),
+        epochs=epochs,
+    )
 
 
 def parse_report(file: Path) -> StatsReport:
     print(f"Parsing report: {file}")
     assert file.exists()
+
+    with open(file, "rb") as f:
+        magic = f.read(8)
+
+    if magic == COLUMNAR_MAGIC or magic[:4] == ZSTD_MAGIC:
+        return _parse_bin_report(file)
+
     with open(file, "rb") as f:
         report = decode(f.read(), type=StatsReport)
         return report
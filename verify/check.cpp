@@ -0,0 +1,69 @@
+#include "check.h"
+
+#include <cstdarg>
+#include <list>
+#include <unordered_map>
+
+void check_t::result(bool passed, const std::string &description, const std::vector<std::string> &details) {
+  printf("[%s] %s %s%s%s\n", passed ? "PASS" : "FAIL", name.data(), trace.filename().c_str(), description.empty() ? "" : " ",
+         description.c_str());
+
+  for (size_t i = 0; i < std::min(details.size(), MAX_PRINTED_DETAILS); i++) {
+    printf("    %s\n", details[i].c_str());
+  }
+  if (details.size() > MAX_PRINTED_DETAILS) {
+    printf("    ... and %lu more\n", details.size() - MAX_PRINTED_DETAILS);
+  }
+  fflush(stdout);
+
+  ok = ok && passed;
+}
+
+void check_t::skip(const std::string &reason) {
+  printf("[SKIP] %s %s (%s)\n", name.data(), trace.filename().c_str(), reason.c_str());
+  fflush(stdout);
+}
+
+std::vector<std::pair<std::string_view, check_fn_t>> &get_checks() {
+  static std::vector<std::pair<std::string_view, check_fn_t>> checks;
+  return checks;
+}
+
+std::string format(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  va_list size_args;
+  va_copy(size_args, args);
+  const int size = vsnprintf(nullptr, 0, fmt, size_args);
+  va_end(size_args);
+
+  std::string str(size, '\0');
+  vsnprintf(str.data(), str.size() + 1, fmt, args);
+  va_end(args);
+
+  return str;
+}
+
+u64 simulate_lru_misses(const std::vector<flow_t> &accesses, u64 capacity) {
+  std::list<flow_t> lru;
+  std::unordered_map<flow_t, std::list<flow_t>::iterator, flow_t::flow_hash_t> cached;
+
+  u64 misses = 0;
+  for (const flow_t &flow : accesses) {
+    auto it = cached.find(flow);
+    if (it != cached.end()) {
+      lru.splice(lru.begin(), lru, it->second);
+      continue;
+    }
+
+    misses++;
+    if (cached.size() == capacity) {
+      cached.erase(lru.back());
+      lru.pop_back();
+    }
+    lru.push_front(flow);
+    cached[flow] = lru.begin();
+  }
+
+  return misses;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "profiler.h"
+#include "traffic_stats_tracker.h"
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Checks that pcap-stats-verify runs on every trace besides diffing the engines, for what the report diff does not cover: analyses with
+// their own simulated or exact counterpart, approximate ones with an error bound, and properties of the ingest path.
+//
+// Checks register themselves with VERIFY_CHECK(name, fn), next to the others of the same feature, and report every outcome through the
+// check_t they are handed. It prints one "[PASS] <name> <trace> <description>" line (or FAIL, or SKIP) per outcome, followed by the details
+// of what went wrong, and folds it into the verdict of the whole run.
+
+constexpr const size_t MAX_PRINTED_DETAILS = 20;
+
+class check_t {
+private:
+  bool ok;
+
+public:
+  const std::string_view name;
+  const std::filesystem::path &trace;
+  const time_ns_t epoch_duration;
+  // What the reference implementation reports for the trace.
+  const report_t &reference;
+
+  check_t(std::string_view _name, const std::filesystem::path &_trace, time_ns_t _epoch_duration, const report_t &_reference)
+      : ok(true), name(_name), trace(_trace), epoch_duration(_epoch_duration), reference(_reference) {}
+
+  void result(bool passed, const std::string &description, const std::vector<std::string> &details = {});
+
+  // For checks this build cannot run, which neither pass nor fail.
+  void skip(const std::string &reason);
+
+  bool passed() const { return ok; }
+};
+
+using check_fn_t = void (*)(check_t &);
+
+std::vector<std::pair<std::string_view, check_fn_t>> &get_checks();
+
+struct check_registrar_t {
+  check_registrar_t(std::string_view name, check_fn_t fn) { get_checks().emplace_back(name, fn); }
+};
+
+#define VERIFY_CHECK(name, fn) static const check_registrar_t PROFILE_CONCAT(check_registrar_, fn)(name, fn)
+
+// printf() into a string, for descriptions and details.
+std::string format(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Misses of an LRU cache of that many flows, simulated the straightforward way.
+u64 simulate_lru_misses(const std::vector<flow_t> &accesses, u64 capacity);
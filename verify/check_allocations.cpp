@@ -0,0 +1,42 @@
+#include "check.h"
+#include "pcap_reader.h"
+#include "alloc_tracker.h"
+
+#include <memory>
+
+namespace {
+
+// With the tables pre-sized for every flow in the trace, the second half of it must not allocate at all: the first half is the warm-up,
+// where the remaining lazily grown state (the packet size CDF, the zstd stream) settles.
+void check_steady_state_allocations(check_t &check) {
+  if constexpr (!ALLOC_TRACKING) {
+    check.skip("allocations are only counted when configured with -DENABLE_ALLOC_TRACKING=ON");
+    return;
+  }
+
+  pcap_reader_t reader(check.trace);
+  auto tracker = std::make_unique<traffic_stats_tracker_t>(check.epoch_duration);
+  tracker->reserve_flows(check.reference.total_flows);
+
+  u64 pkts                = 0;
+  u64 warmup_allocations  = 0;
+  u64 steady_allocations  = 0;
+  const u64 warmup_pkts   = check.reference.total_pkts / 2;
+  const u64 allocs_before = get_tracked_allocations();
+
+  packet_t packet;
+  while (reader.read_next_packet(packet)) {
+    tracker->feed_packet(packet);
+    if (++pkts == warmup_pkts) {
+      warmup_allocations = get_tracked_allocations() - allocs_before;
+    }
+  }
+  steady_allocations = get_tracked_allocations() - allocs_before - warmup_allocations;
+
+  check.result(steady_allocations == 0, format("(%lu during warm-up, %lu in %lu steady state packets)", warmup_allocations,
+                                               steady_allocations, pkts - warmup_pkts));
+}
+
+} // namespace
+
+VERIFY_CHECK("steady-state-allocations", check_steady_state_allocations);
@@ -0,0 +1,84 @@
+#include "check.h"
+#include "pcap_reader.h"
+#include "entropy_sketch.h"
+
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+// The error bound documented in entropy_sketch.h.
+constexpr const double ENTROPY_TOLERANCE_BITS = 0.3;
+
+// In bits.
+double exact_entropy(const std::unordered_map<u32, u64> &counts) {
+  u64 total = 0;
+  for (const auto &[key, count] : counts) {
+    total += count;
+  }
+
+  double entropy = 0;
+  for (const auto &[key, count] : counts) {
+    const double p = static_cast<double>(count) / static_cast<double>(total);
+    entropy -= p * std::log2(p);
+  }
+  return entropy;
+}
+
+// Sketched entropies of every epoch must be within ENTROPY_TOLERANCE_BITS of the exact ones.
+void check_entropy_estimates(check_t &check) {
+  constexpr const std::array<std::string_view, 4> fields = {"src_ip", "dst_ip", "src_port", "dst_port"};
+
+  FlowEntropyEstimator estimator;
+  // Value counts by epoch, then field.
+  std::vector<std::array<std::unordered_map<u32, u64>, fields.size()>> counts(1);
+
+  pcap_reader_t reader(check.trace);
+  packet_t packet;
+  bool clock_on   = false;
+  time_ns_t alarm = 0;
+  while (reader.read_next_packet(packet)) {
+    // Epochs end at the first packet at least epoch_duration after the one that started them.
+    if (!clock_on) {
+      clock_on = true;
+      alarm    = packet.ts + check.epoch_duration;
+    } else if (packet.ts >= alarm) {
+      alarm = packet.ts + check.epoch_duration;
+      estimator.on_epoch_rollover();
+      counts.emplace_back();
+    }
+
+    if (packet.flow.has_value()) {
+      const flow_t &flow = packet.flow.value();
+      estimator.access(flow);
+      counts.back()[0][flow.five_tuple.src_ip]++;
+      counts.back()[1][flow.five_tuple.dst_ip]++;
+      counts.back()[2][flow.five_tuple.src_port]++;
+      counts.back()[3][flow.five_tuple.dst_port]++;
+    }
+  }
+
+  const std::vector<flow_entropy_t> estimates = estimator.get_epoch_reports();
+
+  double max_error = 0;
+  std::vector<std::string> mismatches;
+  for (u64 epoch = 0; epoch < counts.size(); epoch++) {
+    const std::array<double, fields.size()> estimated = {estimates[epoch].src_ip, estimates[epoch].dst_ip, estimates[epoch].src_port,
+                                                         estimates[epoch].dst_port};
+    for (u64 field = 0; field < fields.size(); field++) {
+      const double exact = exact_entropy(counts[epoch][field]);
+      const double error = std::abs(estimated[field] - exact);
+      max_error          = std::max(max_error, error);
+      if (error > ENTROPY_TOLERANCE_BITS) {
+        mismatches.push_back(format("epochs[%lu].%s_entropy: expected %f, got %f", epoch, fields[field].data(), exact, estimated[field]));
+      }
+    }
+  }
+
+  check.result(mismatches.empty(), format("(%lu epochs, max error %.3f bits)", counts.size(), max_error), mismatches);
+}
+
+} // namespace
+
+VERIFY_CHECK("entropy", check_entropy_estimates);
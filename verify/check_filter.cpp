@@ -0,0 +1,70 @@
+#include "check.h"
+#include "pcap_reader.h"
+
+namespace {
+
+// All within what the --filter fast path evaluates on the flow key.
+const std::vector<std::string> FAST_PATH_FILTERS = {
+    "tcp",
+    "udp and src net 128.0.0.0/1",
+    "ip and dst net 64.0.0.0/2 and tcp",
+    "src net 0.0.0.0/1 && dst net 128.0.0.0/1",
+};
+
+// Numbers the fast path would read differently from libpcap (octal and hex), which have to fall back to BPF.
+const std::vector<std::string> BPF_ONLY_FILTERS = {
+    "port 010",
+    "dst port 0x50",
+    "src net 128.0.0.0/01",
+};
+
+struct filtered_pkts_t {
+  u64 pkts;
+  u64 bytes;
+  time_ns_t ts_sum;
+
+  bool operator==(const filtered_pkts_t &other) const = default;
+};
+
+filtered_pkts_t read_filtered(const std::filesystem::path &trace, const std::string &filter, bool fast_path) {
+  pcap_reader_t reader(trace);
+  reader.set_filter(filter, fast_path);
+
+  filtered_pkts_t filtered = {};
+  packet_t packet;
+  while (reader.read_next_packet(packet)) {
+    filtered.pkts++;
+    filtered.bytes += packet.total_len;
+    filtered.ts_sum += packet.ts;
+  }
+
+  return filtered;
+}
+
+// The --filter fast path must let through exactly the packets BPF does.
+void check_filter_fast_path(check_t &check) {
+  for (const std::string &filter : FAST_PATH_FILTERS) {
+    const filtered_pkts_t expected = read_filtered(check.trace, filter, false);
+    const filtered_pkts_t actual   = read_filtered(check.trace, filter, true);
+
+    std::vector<std::string> details;
+    if (actual != expected) {
+      details.push_back(format("expected %lu pkts and %lu bytes, got %lu pkts and %lu bytes", expected.pkts, expected.bytes, actual.pkts,
+                               actual.bytes));
+    }
+
+    check.result(parse_fast_filter(filter).has_value() && actual == expected, format("\"%s\" (%lu pkts)", filter.c_str(), expected.pkts),
+                 details);
+  }
+}
+
+void check_filter_bpf_fallback(check_t &check) {
+  for (const std::string &filter : BPF_ONLY_FILTERS) {
+    check.result(!parse_fast_filter(filter).has_value(), format("\"%s\"", filter.c_str()));
+  }
+}
+
+} // namespace
+
+VERIFY_CHECK("filter-fast-path", check_filter_fast_path);
+VERIFY_CHECK("filter-bpf-fallback", check_filter_bpf_fallback);
@@ -0,0 +1,47 @@
+#include "check.h"
+#include "pcap_reader.h"
+#include "reuse_distance.h"
+
+namespace {
+
+constexpr const size_t FLOW_CACHE_CHECKED_CAPACITIES = 8;
+
+// The reuse distance miss ratio curve must match LRU caches simulated at a few of its capacities, the smallest and largest included.
+void check_flow_cache_curve(check_t &check) {
+  std::vector<flow_t> accesses;
+  ReuseDistanceTracker reuse_distances;
+
+  pcap_reader_t reader(check.trace);
+  packet_t packet;
+  while (reader.read_next_packet(packet)) {
+    if (packet.flow.has_value()) {
+      accesses.push_back(packet.flow.value());
+      reuse_distances.access(packet.flow.value());
+    }
+  }
+
+  const std::vector<miss_ratio_point_t> curve = reuse_distances.get_miss_ratio_curve();
+  const size_t step                           = std::max<size_t>(1, curve.size() / FLOW_CACHE_CHECKED_CAPACITIES);
+
+  std::vector<size_t> checked;
+  for (size_t i = 0; i < curve.size(); i += step) {
+    checked.push_back(i);
+  }
+  if (!curve.empty() && checked.back() != curve.size() - 1) {
+    checked.push_back(curve.size() - 1);
+  }
+
+  std::vector<std::string> details;
+  for (size_t i : checked) {
+    const double expected = static_cast<double>(simulate_lru_misses(accesses, curve[i].capacity)) / accesses.size();
+    if (curve[i].miss_ratio != expected) {
+      details.push_back(format("capacity %lu: expected a miss ratio of %f, got %f", curve[i].capacity, expected, curve[i].miss_ratio));
+    }
+  }
+
+  check.result(!curve.empty() && details.empty(), format("(%lu capacities, %lu accesses)", curve.size(), accesses.size()), details);
+}
+
+} // namespace
+
+VERIFY_CHECK("flow-cache-curve", check_flow_cache_curve);
@@ -0,0 +1,46 @@
+#include "check.h"
+#include "pcap_reader.h"
+#include "flow_table_sim.h"
+
+namespace {
+
+// Fully associative (a single set) LRU tables, which are plain LRU caches.
+const std::vector<std::string> LRU_FLOW_TABLES = {
+    "set:1:1:lru:crc32:0",
+    "set:16:16:lru:crc32,murmur:0",
+    "set:64:64:lru:murmur:0",
+};
+
+// Fully associative LRU flow tables must miss exactly as often as simulated LRU caches.
+void check_flow_table_lru(check_t &check) {
+  FlowTableSimulator simulator;
+  simulator.set_geometries(parse_flow_table_geometries(LRU_FLOW_TABLES).value());
+
+  std::vector<flow_t> accesses;
+  pcap_reader_t reader(check.trace);
+  packet_t packet;
+  time_ns_t now = 0;
+  while (reader.read_next_packet(packet)) {
+    now = packet.ts;
+    if (packet.flow.has_value()) {
+      accesses.push_back(packet.flow.value());
+      simulator.access(packet.flow.value(), now);
+    }
+  }
+
+  for (const flow_table_report_t &table : simulator.get_reports(now)) {
+    const u64 expected = simulate_lru_misses(accesses, table.geometry.entries);
+    const bool passed  = table.misses == expected && table.lookups == accesses.size();
+
+    std::vector<std::string> details;
+    if (!passed) {
+      details.push_back(format("expected %lu misses in %lu lookups, got %lu in %lu", expected, accesses.size(), table.misses, table.lookups));
+    }
+
+    check.result(passed, format("%s (%lu misses)", table.geometry.get_name().c_str(), expected), details);
+  }
+}
+
+} // namespace
+
+VERIFY_CHECK("flow-table-lru", check_flow_table_lru);
@@ -0,0 +1,93 @@
+#include "check.h"
+#include "pcap_reader.h"
+#include "heavy_hitters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+constexpr const double HHH_CHECKED_THRESHOLD = 0.05;
+// Standard deviations of sampling error a heavy hitter has to clear the threshold by to be certainly reported.
+constexpr const double HHH_SAMPLING_MARGIN = 5;
+
+// Heavy hitters of exact counts, by the same bottom up extraction.
+std::vector<hhh_prefix_t> exact_heavy_hitters(const std::vector<u32> &addrs, double threshold) {
+  std::vector<hhh_prefix_t> heavy;
+  std::vector<bool> covered;
+  for (bits_t prefix_size : HHH_PREFIX_SIZES) {
+    std::unordered_map<u32, u64> counts;
+    for (u32 addr : addrs) {
+      counts[ipv4_mask_prefix(addr, prefix_size)]++;
+    }
+
+    std::unordered_map<u32, u64> below;
+    for (u64 i = 0; i < heavy.size(); i++) {
+      if (!covered[i]) {
+        below[ipv4_mask_prefix(heavy[i].prefix, prefix_size)] += heavy[i].pkts;
+      }
+    }
+
+    const u64 found = heavy.size();
+    for (const auto &[prefix, count] : counts) {
+      const u64 residual = count - std::min(count, below[prefix]);
+      if (residual > 0 && residual >= threshold * addrs.size()) {
+        heavy.push_back({.prefix = prefix, .prefix_size = prefix_size, .pkts = count, .residual_pkts = residual});
+        covered.push_back(false);
+      }
+    }
+
+    for (u64 i = 0; i < found; i++) {
+      for (u64 j = found; j < heavy.size(); j++) {
+        covered[i] = covered[i] || ipv4_mask_prefix(heavy[i].prefix, prefix_size) == heavy[j].prefix;
+      }
+    }
+  }
+  return heavy;
+}
+
+// Sampled heavy hitters must include every exact one clearing the threshold by more than the sampling error.
+void check_hhh_recall(check_t &check) {
+  HierarchicalHeavyHitters heavy_hitters;
+  heavy_hitters.set_threshold(HHH_CHECKED_THRESHOLD);
+
+  std::vector<u32> src_addrs;
+  std::vector<u32> dst_addrs;
+  pcap_reader_t reader(check.trace);
+  packet_t packet;
+  while (reader.read_next_packet(packet)) {
+    if (packet.flow.has_value()) {
+      heavy_hitters.access(packet.flow.value());
+      src_addrs.push_back(packet.flow.value().five_tuple.src_ip);
+      dst_addrs.push_back(packet.flow.value().five_tuple.dst_ip);
+    }
+  }
+
+  const hhh_report_t report = heavy_hitters.get_report();
+  const double margin       = HHH_SAMPLING_MARGIN * std::sqrt(static_cast<double>(src_addrs.size() * HHH_SUMMARIES));
+
+  u64 checked = 0;
+  std::vector<std::string> missed;
+  for (const auto &[addrs, sampled] : {std::pair{&src_addrs, &report.src}, std::pair{&dst_addrs, &report.dst}}) {
+    // Residuals are not comparable when the heavy hitters below differ, so only the ones without any are checked.
+    for (const hhh_prefix_t &exact : exact_heavy_hitters(*addrs, HHH_CHECKED_THRESHOLD)) {
+      if (exact.pkts != exact.residual_pkts || exact.pkts < HHH_CHECKED_THRESHOLD * addrs->size() + margin) {
+        continue;
+      }
+      checked++;
+      const bool found = std::any_of(sampled->begin(), sampled->end(), [&](const hhh_prefix_t &prefix) {
+        return prefix.prefix == exact.prefix && prefix.prefix_size == exact.prefix_size;
+      });
+      if (!found) {
+        missed.push_back(format("missed %s/%u (%lu pkts)", ipv4_to_str(exact.prefix).c_str(), exact.prefix_size, exact.pkts));
+      }
+    }
+  }
+
+  check.result(missed.empty(), format("(%lu heavy hitters)", checked), missed);
+}
+
+} // namespace
+
+VERIFY_CHECK("hhh-recall", check_hhh_recall);
@@ -0,0 +1,44 @@
+#include "check.h"
+#include "pcap_reader.h"
+#include "rss_sim.h"
+
+namespace {
+
+// With symmetric RSS both directions of every flow must hash the same, and every packet be on exactly one queue of each queue count.
+void check_rss_symmetric(check_t &check) {
+  RssSimulator simulator;
+  simulator.set_config({.queue_counts = DEFAULT_RSS_QUEUE_COUNTS, .key = DEFAULT_RSS_KEY, .symmetric = true});
+
+  u64 pkts       = 0;
+  u64 asymmetric = 0;
+  pcap_reader_t reader(check.trace);
+  packet_t packet;
+  while (reader.read_next_packet(packet)) {
+    if (packet.flow.has_value()) {
+      const flow_t &flow = packet.flow.value();
+      asymmetric += simulator.hash(flow) != simulator.hash(flow.invert());
+      simulator.access(flow, packet.total_len);
+      pkts++;
+    }
+  }
+
+  std::vector<std::string> details;
+  if (asymmetric > 0) {
+    details.push_back(format("%lu pkts hashed differently than their reverse flow", asymmetric));
+  }
+  for (const rss_report_t &rss : simulator.get_reports()) {
+    u64 queued = 0;
+    for (const rss_queue_counts_t &queue : rss.totals) {
+      queued += queue.pkts;
+    }
+    if (queued != pkts) {
+      details.push_back(format("%lu of %lu pkts queued over %lu queues", queued, pkts, rss.queues));
+    }
+  }
+
+  check.result(details.empty(), format("(%lu pkts)", pkts), details);
+}
+
+} // namespace
+
+VERIFY_CHECK("rss-symmetric", check_rss_symmetric);
@@ -0,0 +1,105 @@
+#include "engines.h"
+#include "pcap_reader.h"
+#include "snapshot.h"
+#include "system.h"
+
+#include <memory>
+#include <unistd.h>
+
+namespace {
+
+// What pcap-stats does for a single pass over the trace, without replay rate.
+template <typename Tracker> report_t run_tracker(const std::filesystem::path &trace, time_ns_t epoch_duration) {
+  pcap_reader_t reader(trace);
+  auto tracker = std::make_unique<Tracker>(epoch_duration);
+
+  packet_t packet;
+  while (reader.read_next_packet(packet)) {
+    tracker->feed_packet(packet);
+  }
+
+  tracker->generate_report();
+  return tracker->report;
+}
+
+// Same, but halfway through the tracker is snapshotted and replaced by one restored from the snapshot, as --resume would.
+report_t run_tracker_with_checkpoint(const std::filesystem::path &trace, time_ns_t epoch_duration) {
+  u64 total_pkts = 0;
+  {
+    pcap_reader_t reader(trace);
+    packet_t packet;
+    while (reader.read_next_packet(packet)) {
+      total_pkts++;
+    }
+  }
+
+  const std::filesystem::path snapshot =
+      std::filesystem::temp_directory_path() / ("pcap-stats-verify-" + std::to_string(getpid()) + ".snapshot");
+
+  pcap_reader_t reader(trace);
+  auto tracker = std::make_unique<traffic_stats_tracker_t>(epoch_duration);
+
+  u64 pkts = 0;
+  packet_t packet;
+  while (reader.read_next_packet(packet)) {
+    tracker->feed_packet(packet);
+
+    if (++pkts == total_pkts / 2) {
+      {
+        SnapshotWriter out(snapshot);
+        tracker->save(out);
+        assert_or_panic(out.close(), "Failed to write snapshot %s", snapshot.c_str());
+      }
+
+      // The FlowTracker is sized for the worst case, so only one tracker is kept around at a time.
+      tracker.reset();
+      tracker = std::make_unique<traffic_stats_tracker_t>(epoch_duration);
+
+      SnapshotReader in(snapshot);
+      tracker->load(in);
+      std::filesystem::remove(snapshot);
+    }
+  }
+
+  tracker->generate_report();
+  return tracker->report;
+}
+
+} // namespace
+
+const std::vector<engine_t> &get_engines() {
+  static const std::vector<engine_t> engines = {
+      {
+          .name    = "tracker",
+          .metrics = ALL_METRICS,
+          .run     = run_tracker<traffic_stats_tracker_t>,
+      },
+      {
+          .name    = "tracker-checkpoint",
+          .metrics = ALL_METRICS,
+          .run     = run_tracker_with_checkpoint,
+      },
+      {
+          .name    = "tracker-pkt-sizes",
+          .metrics = metric_bit(Metric::PktSizes),
+          .run     = run_tracker<basic_traffic_stats_tracker_t<pkt_sizes_metric_t>>,
+      },
+      {
+          .name    = "tracker-churn",
+          .metrics = metric_bit(Metric::Churn),
+          .run     = run_tracker<basic_traffic_stats_tracker_t<churn_metric_t>>,
+      },
+      {
+          .name    = "tracker-churn-concurrency",
+          .metrics = metric_bit(Metric::Churn) | metric_bit(Metric::Concurrency),
+          .run     = run_tracker<basic_traffic_stats_tracker_t<churn_metric_t, concurrency_metric_t>>,
+      },
+      {
+          .name    = "tracker-flows-flow-times",
+          .metrics = metric_bit(Metric::Flows) | metric_bit(Metric::FlowTimes),
+          .run     = run_tracker<basic_traffic_stats_tracker_t<flows_metric_t, flow_times_metric_t>>,
+      },
+  };
+
+  return engines;
+}
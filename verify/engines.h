@@ -0,0 +1,19 @@
+#pragma once
+
+#include "types.h"
+#include "traffic_stats_tracker.h"
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+// An implementation of the report that is checked against the reference, which it must reproduce bit for bit. Engines may compute only
+// some of the metrics, the others are not compared.
+struct engine_t {
+  std::string name;
+  metrics_t metrics;
+  std::function<report_t(const std::filesystem::path &trace, time_ns_t epoch_duration)> run;
+};
+
+const std::vector<engine_t> &get_engines();
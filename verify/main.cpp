@@ -0,0 +1,179 @@
+#include <CLI/CLI.hpp>
+
+#include "check.h"
+#include "engines.h"
+#include "reference.h"
+#include "report_diff.h"
+#include "traffic_generator.h"
+
+#include <filesystem>
+#include <unistd.h>
+
+constexpr const time_ns_t DEFAULT_EPOCH_DURATION_NS = 1'000'000'000;
+
+namespace {
+
+struct generated_trace_t {
+  std::string name;
+  synth_config_t config;
+};
+
+// Small traces covering different corners: a bit of everything, heavy churn (zstd compressed), and a few long lived elephants.
+std::vector<generated_trace_t> get_generated_traces() {
+  return {
+      {
+          .name = "mixed.pcap",
+          .config =
+              {
+                  .flows           = 20'000,
+                  .pkts            = 500'000,
+                  .zipf_skew       = 1.0,
+                  .size_mix        = {{64, 7}, {576, 4}, {1500, 1}},
+                  .flow_rate       = 5'000,
+                  .duration_dist   = DurationDistribution::Exponential,
+                  .duration_mean_s = 1.0,
+                  .pareto_shape    = 0,
+                  .ipv6_ratio      = 0.1,
+                  .vlan_ratio      = 0.2,
+                  .tcp_ratio       = 0.8,
+                  .snaplen         = 0,
+                  .seed            = 1,
+              },
+      },
+      {
+          .name = "churn.pcap.zst",
+          .config =
+              {
+                  .flows           = 50'000,
+                  .pkts            = 200'000,
+                  .zipf_skew       = 0.5,
+                  .size_mix        = {{64, 1}, {1500, 1}},
+                  .flow_rate       = 50'000,
+                  .duration_dist   = DurationDistribution::Constant,
+                  .duration_mean_s = 0.5,
+                  .pareto_shape    = 0,
+                  .ipv6_ratio      = 0,
+                  .vlan_ratio      = 0,
+                  .tcp_ratio       = 0.5,
+                  .snaplen         = 0,
+                  .seed            = 2,
+              },
+      },
+      {
+          .name = "elephants.pcap",
+          .config =
+              {
+                  .flows           = 1'000,
+                  .pkts            = 500'000,
+                  .zipf_skew       = 1.5,
+                  .size_mix        = {{64, 1}, {1500, 4}},
+                  .flow_rate       = 200,
+                  .duration_dist   = DurationDistribution::Pareto,
+                  .duration_mean_s = 3.0,
+                  .pareto_shape    = 1.2,
+                  .ipv6_ratio      = 0,
+                  .vlan_ratio      = 0.5,
+                  .tcp_ratio       = 1.0,
+                  .snaplen         = 128,
+                  .seed            = 3,
+              },
+      },
+  };
+}
+
+std::vector<std::filesystem::path> generate_traces(const std::filesystem::path &dir) {
+  std::vector<std::filesystem::path> traces;
+
+  for (const generated_trace_t &trace : get_generated_traces()) {
+    const std::filesystem::path file = dir / trace.name;
+    fprintf(stderr, "Generating %s\n", file.c_str());
+
+    TrafficGenerator generator(trace.config);
+    PcapWriter out(file, std::max(trace.config.snaplen, SYNTH_MAX_HDRS_LEN));
+    generator.run(out);
+    out.close();
+
+    traces.push_back(file);
+  }
+
+  return traces;
+}
+
+// The engines, each passing if its report does not differ from the reference, then the registered checks.
+bool verify_trace(const std::filesystem::path &trace, const std::string &filter, time_ns_t epoch_duration) {
+  const report_t reference = run_reference(trace, epoch_duration);
+
+  bool ok = true;
+  for (const engine_t &engine : get_engines()) {
+    if (engine.name.find(filter) == std::string::npos) {
+      continue;
+    }
+
+    report_t engine_reference = reference;
+    engine_reference.metrics  = engine.metrics;
+
+    const report_metrics_t expected                 = flatten_report(engine_reference);
+    const report_metrics_t actual                   = flatten_report(engine.run(trace, epoch_duration));
+    const std::vector<metric_mismatch_t> mismatches = diff_reports(expected, actual);
+
+    std::vector<std::string> details;
+    for (const metric_mismatch_t &mismatch : mismatches) {
+      details.push_back(format("%s: expected %s, got %s", mismatch.name.c_str(), mismatch.expected.c_str(), mismatch.actual.c_str()));
+    }
+
+    check_t check(engine.name, trace, epoch_duration, reference);
+    check.result(mismatches.empty(), "", details);
+    ok = ok && check.passed();
+  }
+
+  for (const auto &[name, fn] : get_checks()) {
+    if (name.find(filter) == std::string_view::npos) {
+      continue;
+    }
+
+    check_t check(name, trace, epoch_duration, reference);
+    fn(check);
+    ok = ok && check.passed();
+  }
+
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::filesystem::path> traces;
+  std::string filter;
+  time_ns_t epoch_duration = DEFAULT_EPOCH_DURATION_NS;
+  bool keep                = false;
+
+  CLI::App app{"Checks the report engines against the reference implementation"};
+  app.add_option("traces", traces, "Traces to check (default: a few generated ones).");
+  app.add_option("--filter", filter, "Only run engines and checks whose name contains this string.");
+  app.add_option("--epoch", epoch_duration, "Epoch duration in nanoseconds (default: 1s).");
+  app.add_flag("--keep", keep, "Keep the generated traces.");
+
+  CLI11_PARSE(app, argc, argv);
+
+  std::filesystem::path generated_dir;
+  if (traces.empty()) {
+    generated_dir = std::filesystem::temp_directory_path() / ("pcap-stats-verify-" + std::to_string(getpid()));
+    std::filesystem::create_directories(generated_dir);
+    traces = generate_traces(generated_dir);
+  }
+
+  bool ok = true;
+  for (const std::filesystem::path &trace : traces) {
+    ok = verify_trace(trace, filter, epoch_duration) && ok;
+  }
+
+  if (!generated_dir.empty()) {
+    if (keep) {
+      fprintf(stderr, "Generated traces kept in %s\n", generated_dir.c_str());
+    } else {
+      std::filesystem::remove_all(generated_dir);
+    }
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+#include "reference.h"
+#include "system.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <zstd.h>
+
+namespace {
+
+FILE *decompress_to_tmpfile(const std::filesystem::path &file) {
+  FILE *in = fopen(file.c_str(), "rb");
+  if (!in) {
+    perror("fopen");
+    panic("Failed to open %s", file.c_str());
+  }
+
+  FILE *out = tmpfile();
+  assert_or_panic(out, "Failed to create a temporary file: %s", strerror(errno));
+
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  std::vector<u8> in_buff(ZSTD_DStreamInSize());
+  std::vector<u8> out_buff(ZSTD_DStreamOutSize());
+
+  size_t read;
+  while ((read = fread(in_buff.data(), 1, in_buff.size(), in)) > 0) {
+    ZSTD_inBuffer input = {in_buff.data(), read, 0};
+    while (input.pos < input.size) {
+      ZSTD_outBuffer output = {out_buff.data(), out_buff.size(), 0};
+      const size_t ret      = ZSTD_decompressStream(dctx, &output, &input);
+      assert_or_panic(!ZSTD_isError(ret), "Decompression failed: %s", ZSTD_getErrorName(ret));
+      assert_or_panic(fwrite(out_buff.data(), 1, output.pos, out) == output.pos, "Failed to write temporary file");
+    }
+  }
+
+  ZSTD_freeDCtx(dctx);
+  fclose(in);
+  rewind(out);
+
+  return out;
+}
+
+} // namespace
+
+ReferenceReader::ReferenceReader(const std::filesystem::path &file) : pd(nullptr), assume_ip(false) {
+  FILE *in = nullptr;
+  if (file.extension() == ".zst") {
+    in = decompress_to_tmpfile(file);
+  } else {
+    in = fopen(file.c_str(), "rb");
+    if (!in) {
+      perror("fopen");
+      panic("Failed to open %s", file.c_str());
+    }
+  }
+
+  char errbuf[PCAP_ERRBUF_SIZE];
+  pd = pcap_fopen_offline(in, errbuf);
+  if (!pd) {
+    fclose(in);
+    panic("Failed to open pcap file: %s", errbuf);
+  }
+
+  switch (pcap_datalink(pd)) {
+  case DLT_EN10MB:
+    break;
+  case DLT_RAW:
+    assume_ip = true;
+    break;
+  default:
+    panic("Unknown header type (%d)", pcap_datalink(pd));
+  }
+}
+
+ReferenceReader::~ReferenceReader() { pcap_close(pd); }
+
+bool ReferenceReader::read_next_packet(packet_t &packet) {
+  const u8 *data;
+  struct pcap_pkthdr *header;
+
+  if (pcap_next_ex(pd, &header, &data) != 1) {
+    return false;
+  }
+
+  packet.pkt       = data;
+  packet.hdrs_len  = 0;
+  packet.total_len = header->len + CRC_SIZE_BYTES;
+  packet.ts        = header->ts.tv_sec * BILLION + header->ts.tv_usec * THOUSAND;
+  packet.flow.reset();
+
+  if (assume_ip) {
+    packet.total_len += sizeof(ether_hdr_t);
+  } else {
+    u16 ether_type = ntohs(reinterpret_cast<const ether_hdr_t *>(data)->ether_type);
+    data += sizeof(ether_hdr_t);
+
+    if (ether_type == ETHERTYPE_VLAN) {
+      // TCI, then the encapsulated type.
+      u16 inner_type;
+      memcpy(&inner_type, data + sizeof(u16), sizeof(inner_type));
+      ether_type = ntohs(inner_type);
+      data += sizeof(u16) + sizeof(u16);
+    }
+
+    if (ether_type != ETHERTYPE_IP) {
+      return true;
+    }
+  }
+
+  ipv4_hdr_t ip_hdr;
+  memcpy(&ip_hdr, data, sizeof(ip_hdr));
+  data += sizeof(ipv4_hdr_t);
+
+  if (ip_hdr.version != 4 || (ip_hdr.next_proto_id != IPPROTO_TCP && ip_hdr.next_proto_id != IPPROTO_UDP)) {
+    return true;
+  }
+
+  // Both TCP and UDP start with the source and destination ports.
+  u16 ports[2];
+  memcpy(ports, data, sizeof(ports));
+
+  flow_t flow;
+  flow.five_tuple.src_ip   = ip_hdr.src_addr;
+  flow.five_tuple.dst_ip   = ip_hdr.dst_addr;
+  flow.five_tuple.src_port = ports[0];
+  flow.five_tuple.dst_port = ports[1];
+  packet.flow              = flow;
+
+  return true;
+}
+
+ReferenceTracker::ReferenceTracker(time_ns_t _epoch_duration) : epoch_duration(_epoch_duration), clock_on(false), alarm(0) {
+  concurrent_flows_per_epoch.emplace_back();
+  expired_flows_per_epoch.push_back(0);
+  new_flows_per_epoch.push_back(0);
+}
+
+void ReferenceTracker::feed_packet(const packet_t &packet) {
+  report.end = packet.ts;
+  if (report.start == 0) {
+    report.start = packet.ts;
+  }
+
+  report.total_pkts++;
+  report.total_bytes += packet.total_len;
+  report.pkt_sizes_cdf.add(packet.total_len);
+
+  // Epochs end at the first packet at least epoch_duration after the one that started them.
+  if (!clock_on) {
+    clock_on = true;
+    alarm    = packet.ts + epoch_duration;
+  } else if (packet.ts >= alarm) {
+    alarm = packet.ts + epoch_duration;
+    concurrent_flows_per_epoch.emplace_back();
+    expired_flows_per_epoch.push_back(0);
+    new_flows_per_epoch.push_back(0);
+  }
+
+  if (!packet.flow.has_value()) {
+    return;
+  }
+
+  const flow_t &flow = packet.flow.value();
+
+  while (!live_flows_by_age.empty() && live_flows_by_age.front().first < packet.ts - REFERENCE_EXPIRATION_TIME_NS) {
+    live_flows.erase(live_flows_by_age.front().second);
+    live_flows_by_age.pop_front();
+    expired_flows_per_epoch.back()++;
+  }
+
+  if (live_flows.insert(flow).second) {
+    live_flows_by_age.emplace_back(packet.ts, flow);
+    new_flows_per_epoch.back()++;
+  }
+
+  report.tcpudp_pkts++;
+  flows.insert(flow);
+  symm_flows.insert(sflow_t(flow));
+  concurrent_flows_per_epoch.back().insert(flow);
+  pkts_per_flow[flow]++;
+  bytes_per_flow[flow] += packet.total_len;
+
+  auto it = flow_times.find(flow);
+  if (it == flow_times.end()) {
+    flow_times[flow] = {.first = packet.ts, .last = packet.ts, .dts = {}};
+  } else {
+    it->second.dts.push_back(packet.ts - it->second.last);
+    it->second.last = packet.ts;
+  }
+}
+
+void ReferenceTracker::generate_report() {
+  report.total_flows      = flows.size();
+  report.total_symm_flows = symm_flows.size();
+
+  for (size_t i = 0; i < concurrent_flows_per_epoch.size(); i++) {
+    report.concurrent_flows_per_epoch.add(concurrent_flows_per_epoch[i].size());
+    report.epochs.push_back({
+        .expired_flows    = expired_flows_per_epoch[i],
+        .new_flows        = new_flows_per_epoch[i],
+        .concurrent_flows = concurrent_flows_per_epoch[i].size(),
+        .src_ip_entropy   = 0,
+        .dst_ip_entropy   = 0,
+        .src_port_entropy = 0,
+        .dst_port_entropy = 0,
+    });
+  }
+
+  std::vector<u64> pkts;
+  std::vector<u64> bytes;
+  for (const auto &[flow, count] : pkts_per_flow) {
+    report.pkts_per_flow_cdf.add(count);
+    pkts.push_back(count);
+  }
+  for (const auto &[flow, count] : bytes_per_flow) {
+    bytes.push_back(count);
+  }
+
+  std::sort(pkts.begin(), pkts.end(), std::greater<u64>());
+  std::sort(bytes.begin(), bytes.end(), std::greater<u64>());
+  for (size_t i = 0; i < pkts.size(); i++) {
+    report.top_k_flows_cdf.add(i + 1, pkts[i]);
+    report.top_k_flows_bytes_cdf.add(i + 1, bytes[i]);
+  }
+
+  for (const auto &[flow, times] : flow_times) {
+    report.flow_duration_us_cdf.add((times.last - times.first) / THOUSAND);
+
+    if (times.dts.empty()) {
+      continue;
+    }
+
+    // Every gap is truncated to microseconds before averaging, as the report always did.
+    time_us_t dt_sum = 0;
+    for (const time_ns_t dt : times.dts) {
+      dt_sum += dt / THOUSAND;
+    }
+    report.flow_dts_us_cdf.add(dt_sum / static_cast<double>(times.dts.size()));
+  }
+}
+
+report_t run_reference(const std::filesystem::path &trace, time_ns_t epoch_duration) {
+  ReferenceReader reader(trace);
+  ReferenceTracker tracker(epoch_duration);
+
+  packet_t packet;
+  while (reader.read_next_packet(packet)) {
+    tracker.feed_packet(packet);
+  }
+
+  tracker.generate_report();
+  return tracker.report;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "types.h"
+#include "net.h"
+#include "traffic_stats_tracker.h"
+
+#include <deque>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <pcap.h>
+
+// Frozen reference implementation of the report, against which the optimized engines are checked.
+//
+// This is deliberately the most straightforward take on the semantics of traffic_stats_tracker_t and pcap_reader_t: std containers, a
+// FIFO of live flows instead of the DoubleChain, and plain libpcap reads (zstd traces are decompressed to a temporary file first). It must
+// not be optimized, nor follow changes to the engines: if an engine changes the report on purpose, the reference is what documents the
+// previous behavior.
+
+constexpr const time_ns_t REFERENCE_EXPIRATION_TIME_NS = 1'000'000'000;
+
+class ReferenceReader {
+private:
+  pcap_t *pd;
+  bool assume_ip;
+
+public:
+  ReferenceReader(const std::filesystem::path &file);
+  ~ReferenceReader();
+
+  ReferenceReader(const ReferenceReader &)            = delete;
+  ReferenceReader &operator=(const ReferenceReader &) = delete;
+
+  bool read_next_packet(packet_t &packet);
+};
+
+class ReferenceTracker {
+private:
+  struct flow_times_t {
+    time_ns_t first;
+    time_ns_t last;
+    std::vector<time_ns_t> dts;
+  };
+
+  const time_ns_t epoch_duration;
+  bool clock_on;
+  time_ns_t alarm;
+
+  std::unordered_set<flow_t, flow_t::flow_hash_t> flows;
+  std::unordered_set<sflow_t, sflow_t::flow_hash_t> symm_flows;
+  std::vector<std::unordered_set<flow_t, flow_t::flow_hash_t>> concurrent_flows_per_epoch;
+  std::vector<u64> expired_flows_per_epoch;
+  std::vector<u64> new_flows_per_epoch;
+
+  // Flows expire a fixed time after they were created, oldest first.
+  std::unordered_set<flow_t, flow_t::flow_hash_t> live_flows;
+  std::deque<std::pair<time_ns_t, flow_t>> live_flows_by_age;
+
+  std::unordered_map<flow_t, u64, flow_t::flow_hash_t> pkts_per_flow;
+  std::unordered_map<flow_t, u64, flow_t::flow_hash_t> bytes_per_flow;
+  std::unordered_map<flow_t, flow_times_t, flow_t::flow_hash_t> flow_times;
+
+public:
+  report_t report;
+
+  ReferenceTracker(time_ns_t epoch_duration);
+
+  void feed_packet(const packet_t &packet);
+  void generate_report();
+};
+
+// Reads the whole trace with the reference reader and tracker.
+report_t run_reference(const std::filesystem::path &trace, time_ns_t epoch_duration);
@@ -0,0 +1,114 @@
+#include "report_diff.h"
+
+#include <cmath>
+#include <set>
+
+namespace {
+
+void flatten_cdf(report_metrics_t &metrics, const std::string &name, const CDF &cdf) {
+  metrics.values[name + ".avg"]   = cdf.get_avg();
+  metrics.values[name + ".stdev"] = cdf.get_stdev();
+  for (const auto &[value, probability] : cdf.get_cdf()) {
+    metrics.values[name + ".cdf@" + std::to_string(value)] = probability;
+  }
+}
+
+bool equals(u64 expected, u64 actual) { return expected == actual; }
+
+// Averages of empty CDFs are NaN on both sides.
+bool equals(double expected, double actual) { return expected == actual || (std::isnan(expected) && std::isnan(actual)); }
+
+std::string format_metric(u64 value) { return std::to_string(value); }
+
+std::string format_metric(double value) {
+  char str[32];
+  snprintf(str, sizeof(str), "%.17g", value);
+  return str;
+}
+
+template <typename T>
+void diff_metrics(const std::map<std::string, T> &expected, const std::map<std::string, T> &actual,
+                  std::vector<metric_mismatch_t> &mismatches) {
+  std::set<std::string> names;
+  for (const auto &[name, value] : expected) {
+    names.insert(name);
+  }
+  for (const auto &[name, value] : actual) {
+    names.insert(name);
+  }
+
+  for (const std::string &name : names) {
+    const auto expected_it = expected.find(name);
+    const auto actual_it   = actual.find(name);
+
+    if (expected_it == expected.end() || actual_it == actual.end()) {
+      mismatches.push_back({
+          .name     = name,
+          .expected = expected_it == expected.end() ? "(missing)" : format_metric(expected_it->second),
+          .actual   = actual_it == actual.end() ? "(missing)" : format_metric(actual_it->second),
+      });
+      continue;
+    }
+
+    if (!equals(expected_it->second, actual_it->second)) {
+      mismatches.push_back({.name = name, .expected = format_metric(expected_it->second), .actual = format_metric(actual_it->second)});
+    }
+  }
+}
+
+} // namespace
+
+// Only the metrics the report was computed with are included, so that subset engines can be compared against the full reference.
+report_metrics_t flatten_report(const report_t &report) {
+  report_metrics_t metrics;
+
+  metrics.counts["start_utc_ns"] = report.start;
+  metrics.counts["end_utc_ns"]   = report.end;
+  metrics.counts["total_pkts"]   = report.total_pkts;
+  metrics.counts["total_bytes"]  = report.total_bytes;
+  metrics.counts["tcpudp_pkts"]  = report.tcpudp_pkts;
+  metrics.counts["epochs"]       = report.epochs.size();
+
+  if (has_metric(report.metrics, Metric::Flows)) {
+    metrics.counts["total_flows"] = report.total_flows;
+  }
+  if (has_metric(report.metrics, Metric::SymmFlows)) {
+    metrics.counts["total_symm_flows"] = report.total_symm_flows;
+  }
+
+  for (size_t i = 0; i < report.epochs.size(); i++) {
+    const std::string prefix = "epochs[" + std::to_string(i) + "].";
+    if (has_metric(report.metrics, Metric::Concurrency)) {
+      metrics.counts[prefix + "concurrent_flows"] = report.epochs[i].concurrent_flows;
+    }
+    if (has_metric(report.metrics, Metric::Churn)) {
+      metrics.counts[prefix + "expired_flows"] = report.epochs[i].expired_flows;
+      metrics.counts[prefix + "new_flows"]     = report.epochs[i].new_flows;
+    }
+  }
+
+  if (has_metric(report.metrics, Metric::PktSizes)) {
+    flatten_cdf(metrics, "pkt_bytes", report.pkt_sizes_cdf);
+  }
+  if (has_metric(report.metrics, Metric::Concurrency)) {
+    flatten_cdf(metrics, "concurrent_flows_per_epoch", report.concurrent_flows_per_epoch);
+  }
+  if (has_metric(report.metrics, Metric::FlowSizes)) {
+    flatten_cdf(metrics, "pkts_per_flow", report.pkts_per_flow_cdf);
+    flatten_cdf(metrics, "top_k_flows", report.top_k_flows_cdf);
+    flatten_cdf(metrics, "top_k_flows_bytes", report.top_k_flows_bytes_cdf);
+  }
+  if (has_metric(report.metrics, Metric::FlowTimes)) {
+    flatten_cdf(metrics, "flow_duration_us", report.flow_duration_us_cdf);
+    flatten_cdf(metrics, "flow_dts_us", report.flow_dts_us_cdf);
+  }
+
+  return metrics;
+}
+
+std::vector<metric_mismatch_t> diff_reports(const report_metrics_t &expected, const report_metrics_t &actual) {
+  std::vector<metric_mismatch_t> mismatches;
+  diff_metrics(expected.counts, actual.counts, mismatches);
+  diff_metrics(expected.values, actual.values, mismatches);
+  return mismatches;
+}
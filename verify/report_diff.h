@@ -0,0 +1,26 @@
+#pragma once
+
+#include "types.h"
+#include "traffic_stats_tracker.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Reports flattened into named metrics, e.g. "total_flows", "epochs[3].new_flows", "pkt_bytes.avg" or "pkt_bytes.cdf@1500" (the CDF
+// probability at that value). Integers are kept apart so that timestamps and counters compare exactly.
+struct report_metrics_t {
+  std::map<std::string, u64> counts;
+  std::map<std::string, double> values;
+};
+
+report_metrics_t flatten_report(const report_t &report);
+
+struct metric_mismatch_t {
+  std::string name;
+  std::string expected;
+  std::string actual;
+};
+
+// Metrics are compared exactly: approximate ones are checked against their own error bounds, outside of the report diff.
+std::vector<metric_mismatch_t> diff_reports(const report_metrics_t &expected, const report_metrics_t &actual);